@@ -0,0 +1,435 @@
+#include "buildplan.h"
+#include "prefetch.h"
+#include "trace.h"
+#include "tinyxml2.h"
+#include "enkits/TaskScheduler.h"
+#include "./wav12/s4adpcm.h"
+
+extern "C" {
+#include "wave_reader.h"
+}
+
+#include <assert.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <memory>
+
+using namespace tinyxml2;
+
+#define TEST(x) { if (!(x)) { assert(false); return false; }}
+
+static uint8_t ParseOneHex(char c)
+{
+    c = char(tolower(c));
+    if (c >= 'a' && c <= 'f') return 10 + (c - 'a');
+    return c - '0';
+}
+
+bool BuildPlan::ParseHex(const char* in, uint8_t* r, uint8_t* g, uint8_t* b)
+{
+    if (!in || strlen(in) != 6)
+        return false;
+    for (int i = 0; i < 6; ++i) {
+        if (!isxdigit((unsigned char)in[i]))
+            return false;
+    }
+    *r = ParseOneHex(in[0]) * 16 + ParseOneHex(in[1]);
+    *g = ParseOneHex(in[2]) * 16 + ParseOneHex(in[3]);
+    *b = ParseOneHex(in[4]) * 16 + ParseOneHex(in[5]);
+    return true;
+}
+
+void BuildPlan::error(const char* format, ...)
+{
+    char buf[512];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    errors.push_back(buf);
+}
+
+// Runs f(i) for i in [0, n): on the scheduler if there is one.
+template<typename F>
+static void ForEach(enki::TaskScheduler* scheduler, int n, F f)
+{
+    if (!scheduler || n <= 1) {
+        for (int i = 0; i < n; ++i)
+            f(i);
+        return;
+    }
+    enki::TaskSet task(uint32_t(n), [&](enki::TaskSetPartition range, uint32_t) {
+        for (uint32_t i = range.start; i < range.end; ++i)
+            f(int(i));
+    });
+    scheduler->AddTaskSetToPipe(&task);
+    scheduler->WaitforTask(&task);
+}
+
+bool BuildPlan::load(const std::vector<std::string>& files, const BuildOptions& options, enki::TaskScheduler* scheduler)
+{
+    Trace::Scope scope("plan");
+    const int n = int(files.size());
+    std::unique_ptr<XMLDocument[]> docs(new XMLDocument[n]);
+    ForEach(scheduler, n, [&](int i) {
+        Trace::Scope scope("xml", files[i]);
+        docs[i].LoadFile(files[i].c_str());
+    });
+    // In order: the order of the files is the order of the image.
+    for (int i = 0; i < n; ++i)
+        add(docs[i], files[i], options);
+    probe(scheduler);
+    return errors.empty();
+}
+
+void BuildPlan::add(const XMLDocument& doc, const std::string& name, const BuildOptions& options)
+{
+    const char* xml = name.c_str();
+    if (doc.Error()) {
+        error("%s: XML error: %s", xml, doc.ErrorStr());
+        return;
+    }
+    const XMLElement* root = doc.RootElement();
+    if (!root) {
+        error("%s: no root element", xml);
+        return;
+    }
+
+    if (strcmp(root->Name(), "Config") == 0) {
+        if (root->Attribute("name")) {
+            imageName += "_";
+            imageName += root->Attribute("name");
+        }
+        else {
+            imageName += "_config";
+        }
+
+        nPalette = 0;
+        for (const XMLElement* palElement = root->FirstChildElement("Palette");
+            palElement;
+            palElement = palElement->NextSiblingElement("Palette"))
+        {
+            if (nPalette == MemPalette::NUM_PALETTES) {
+                error("%s: more than %d palettes", xml, MemPalette::NUM_PALETTES);
+                return;
+            }
+            MemPalette& pal = palette[nPalette];
+            int font = 0;
+            palElement->QueryIntAttribute("font", &font);
+            pal.soundFont = font;
+            const char* bc = palElement->Attribute("bc");
+            const char* ic = palElement->Attribute("ic");
+            if (!ParseHex(bc, &pal.bladeColor.r, &pal.bladeColor.g, &pal.bladeColor.b))
+                error("%s: palette %d bc='%s' is not a color (rrggbb)", xml, nPalette, bc ? bc : "");
+            if (!ParseHex(ic, &pal.impactColor.r, &pal.impactColor.g, &pal.impactColor.b))
+                error("%s: palette %d ic='%s' is not a color (rrggbb)", xml, nPalette, ic ? ic : "");
+            ++nPalette;
+        }
+        if (nPalette != MemPalette::NUM_PALETTES)
+            error("%s: %d palettes, and there must be %d", xml, nPalette, MemPalette::NUM_PALETTES);
+        return;
+    }
+
+    for (const XMLElement* dirElement = root->FirstChildElement();
+        dirElement;
+        dirElement = dirElement->NextSiblingElement())
+    {
+        const char* p = dirElement->Attribute("path");
+        if (!p) {
+            error("%s:%d: <%s> has no path", xml, dirElement->GetLineNum(), dirElement->Name());
+            continue;
+        }
+        std::string stdDirName = p;
+        DirJob dir;
+        dir.name = stdDirName;
+        if (dirElement->Attribute("name")) {
+            dir.name = dirElement->Attribute("name");
+        }
+        const char* post = dirElement->Attribute("post");
+        if (post) {
+            dir.postPath = post;
+            dir.postPath.append("/");
+        }
+        for (const DirJob& other : dirs) {
+            if (other.name.compare(0, MemUnit::NAME_LEN, dir.name, 0, MemUnit::NAME_LEN) == 0)
+                error("%s:%d: dir '%s' has the same name in the image as '%s'", xml, dirElement->GetLineNum(), dir.name.c_str(), other.name.c_str());
+        }
+
+        if (!imageName.empty()) {
+            imageName += "_";
+        }
+        imageName += dir.name;
+
+        for (const XMLElement* fileElement = dirElement->FirstChildElement();
+            fileElement;
+            fileElement = fileElement->NextSiblingElement())
+        {
+            const int line = fileElement->GetLineNum();
+            const char* fp = fileElement->Attribute("path");
+            if (!fp) {
+                error("%s:%d: <%s> has no path", xml, line, fileElement->Name());
+                continue;
+            }
+            FileJob job;
+            job.fname = fp;
+            const char* extension = strrchr(fp, '.');
+            job.name.assign(fp, extension ? extension : fp + strlen(fp));
+
+            job.fullPath = options.inputPath;
+            job.fullPath += stdDirName;
+            job.fullPath += '/';
+            job.fullPath += job.fname;
+
+            fileElement->QueryBoolAttribute("looping", &job.looping);
+            fileElement->QueryBoolAttribute("optional", &job.optional);
+            fileElement->QueryIntAttribute("priority", &job.priority);
+
+            job.compress = options.compress;
+            fileElement->QueryIntAttribute("maxerr", &job.compress.maxError);
+            fileElement->QueryIntAttribute("shape", &job.compress.noiseShape);
+            if (abs(job.compress.noiseShape) > S4ADPCM::MAX_NOISE_SHAPE) {
+                error("%s:%d: noise shape of %s must be in [%d, %d]", xml, line, job.fname.c_str(), -S4ADPCM::MAX_NOISE_SHAPE, S4ADPCM::MAX_NOISE_SHAPE);
+            }
+
+            job.pre = options.pre;
+            fileElement->QueryIntAttribute("trim", &job.pre.trimLevel);
+            fileElement->QueryBoolAttribute("dc", &job.pre.removeDC);
+            fileElement->QueryIntAttribute("fade", &job.pre.fadeMSec);
+            if (job.pre.fadeMSec < 0 || job.pre.fadeMSec > PreprocessOptions::MAX_FADE_MSEC) {
+                error("%s:%d: fade of %s must be in [0, %d] msec", xml, line, job.fname.c_str(), PreprocessOptions::MAX_FADE_MSEC);
+            }
+
+            // Names are cut to NAME_LEN in the image; two the same can't both be found.
+            for (const FileJob& other : dir.files) {
+                if (other.name.compare(0, MemUnit::NAME_LEN, job.name, 0, MemUnit::NAME_LEN) == 0)
+                    error("%s:%d: '%s' has the same name in the image as '%s'", xml, line, job.fname.c_str(), other.fname.c_str());
+            }
+            dir.files.push_back(std::move(job));
+        }
+        dirs.push_back(std::move(dir));
+    }
+}
+
+// True if 'a' and 'b' encode to the same bytes, and fit the budget the same way.
+static bool SameEncoding(const FileJob& a, const FileJob& b)
+{
+    return a.fullPath == b.fullPath && a.looping == b.looping
+        && a.optional == b.optional && a.priority == b.priority
+        && a.compress.tryADPCM == b.compress.tryADPCM && a.compress.maxError == b.compress.maxError
+        && a.compress.metric == b.compress.metric && a.compress.noiseShape == b.compress.noiseShape
+        && a.pre.trimLevel == b.pre.trimLevel && a.pre.removeDC == b.pre.removeDC
+        && a.pre.fadeMSec == b.pre.fadeMSec;
+}
+
+void BuildPlan::probe(enki::TaskScheduler* scheduler)
+{
+    // Each path is read once, however many dirs use it. A file that is
+    // used again the same way is compressed once, too.
+    std::vector<FileJob*> jobs;
+    std::map<std::string, std::vector<FileJob*>> byPath;
+    for (DirJob& dir : dirs) {
+        for (FileJob& job : dir.files) {
+            std::vector<FileJob*>& uses = byPath[job.fullPath];
+            for (const FileJob* first : uses) {
+                if (SameEncoding(*first, job)) {
+                    job.same = first;
+                    break;
+                }
+            }
+            if (uses.empty())
+                jobs.push_back(&job);
+            if (!job.same)
+                uses.push_back(&job);
+        }
+    }
+    // The errors are per file, and added in order after, so they don't
+    // depend on the threads.
+    std::vector<std::string> fileErrors(jobs.size());
+    ForEach(scheduler, int(jobs.size()), [&](int i) {
+        FileJob& job = *jobs[i];
+        PcmFile header = PcmFile::ReadHeader(job.fullPath);
+        char buf[512] = { 0 };
+        if (header.error != WR_NO_ERROR) {
+            snprintf(buf, sizeof(buf), "Failed to open: %s", job.fullPath.c_str());
+        }
+        else if (header.format != 1 || header.nChannels != 1 || header.bits != 16 || !(header.rate == 22050 || header.rate == 44100)) {
+            snprintf(buf, sizeof(buf), "Input '%s' must be 22050/44100 Hz 16 bit Mono, freq=%d channels=%d bits=%d",
+                job.fullPath.c_str(), header.rate, header.nChannels, header.bits);
+        }
+        else if (header.nSamples == 0) {
+            snprintf(buf, sizeof(buf), "Input '%s' has no samples", job.fullPath.c_str());
+        }
+        else {
+            job.nSamples = header.rate == 44100 ? header.nSamples / 2 : header.nSamples;
+        }
+        fileErrors[i] = buf;
+    });
+    for (const std::string& e : fileErrors) {
+        if (!e.empty())
+            errors.push_back(e);
+    }
+    for (DirJob& dir : dirs) {
+        for (FileJob& job : dir.files)
+            job.nSamples = byPath[job.fullPath].front()->nSamples;
+    }
+}
+
+std::vector<FileJob*> BuildPlan::schedule()
+{
+    std::vector<FileJob*> order;
+    for (DirJob& dir : dirs) {
+        for (FileJob& job : dir.files) {
+            if (!job.same)
+                order.push_back(&job);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [](const FileJob* a, const FileJob* b) {
+        return a->nSamples > b->nSamples;
+    });
+    return order;
+}
+
+void BuildPlan::copySame()
+{
+    for (DirJob& dir : dirs) {
+        for (FileJob& job : dir.files) {
+            if (!job.same)
+                continue;
+            const EncodedStream& from = job.same->es;
+            job.es = EncodedStream();
+            job.es.nSamples = from.nSamples;
+            job.es.nCompressed = from.nCompressed;
+            job.es.table = from.table;
+            job.es.predictor = from.predictor;
+            job.es.aveError2 = from.aveError2;
+            job.es.codec = from.codec;
+            if (from.compressed) {
+                job.es.compressed.reset(new uint8_t[from.nCompressed]);
+                memcpy(job.es.compressed.get(), from.compressed.get(), from.nCompressed);
+            }
+            job.fit = job.same->fit;
+        }
+    }
+}
+
+bool BuildPlan::Test()
+{
+    uint8_t r = 0, g = 0, b = 0;
+    TEST(ParseHex("FF8001", &r, &g, &b));
+    TEST(r == 0xff && g == 0x80 && b == 0x01);
+    TEST(!ParseHex(0, &r, &g, &b));
+    TEST(!ParseHex("ff800", &r, &g, &b));
+    TEST(!ParseHex("ff80012", &r, &g, &b));
+    TEST(!ParseHex("ff80g1", &r, &g, &b));
+
+    // The WAVs are in a temp dir, which is removed however the test returns.
+    TempDir tmp;
+    TEST(tmp.ok());
+    const char* names[3] = { "testPa.wav", "testPb.wav", "testPc.wav" };
+    const int sizes[3] = { 100, 300, 200 };
+    int16_t samples[300] = { 0 };
+    for (int i = 0; i < 3; ++i) {
+        WavWriter writer;
+        TEST(writer.open(tmp.path(names[i]).c_str()));
+        writer.put(samples, sizes[i]);
+        TEST(writer.close());
+    }
+
+    std::string palettes;
+    for (int i = 0; i < MemPalette::NUM_PALETTES; ++i)
+        palettes += "<Palette font='1' bc='00ff00' ic='0000FF'/>";
+    const std::string config = "<Config name='cfg'>" + palettes + "</Config>";
+    const char* font =
+        "<Font>"
+        "  <Dir path='.' name='dir0'>"
+        "    <File path='testPa.wav'/>"
+        "    <File path='testPb.wav' looping='true' shape='2'/>"
+        "  </Dir>"
+        "  <Dir path='.' name='dir1'>"
+        "    <File path='testPc.wav'/>"
+        "  </Dir>"
+        "</Font>";
+
+    BuildOptions options;
+    options.inputPath = tmp.dir();
+    {
+        // A good plan: the files from their headers, and largest first.
+        XMLDocument c, f;
+        c.Parse(config.c_str());
+        f.Parse(font);
+        BuildPlan plan;
+        plan.add(c, "config", options);
+        plan.add(f, "font", options);
+        plan.probe(0);
+        TEST(plan.errors.empty());
+        TEST(plan.imageName == "_cfg_dir0_dir1");
+        TEST(plan.nPalette == MemPalette::NUM_PALETTES);
+        TEST(plan.palette[7].bladeColor.g == 0xff && plan.palette[7].impactColor.b == 0xff);
+        TEST(plan.dirs.size() == 2 && plan.dirs[0].files.size() == 2);
+        TEST(plan.dirs[0].files[1].name == "testPb");
+        TEST(plan.dirs[0].files[1].looping && plan.dirs[0].files[1].compress.noiseShape == 2);
+
+        std::vector<FileJob*> order = plan.schedule();
+        TEST(order.size() == 3);
+        TEST(order[0]->name == "testPb" && order[1]->name == "testPc" && order[2]->name == "testPa");
+        TEST(order[0]->nSamples == 300);
+    }
+    {
+        // Every problem is reported, not just the first.
+        std::string bad = "<Config>" + palettes.substr(0, palettes.size() / 2) +
+            "<Palette bc='00ff0'/></Config>";
+        XMLDocument c, f;
+        c.Parse(bad.c_str());
+        f.Parse(
+            "<Font>"
+            "  <Dir name='nopath'><File path='a.wav'/></Dir>"
+            "  <Dir path='.'>"
+            "    <File/>"
+            "    <File path='testPa.wav' shape='9' fade='60001'/>"
+            "    <File path='testPa.wav'/>"
+            "    <File path='testPx.wav'/>"
+            "  </Dir>"
+            "</Font>");
+        BuildPlan plan;
+        plan.add(c, "config", options);
+        TEST(plan.errors.size() == 3);     // bc, ic, and the count
+        plan.add(f, "font", options);
+        TEST(plan.errors.size() == 8);     // no dir path, no file path, shape, fade, same name
+        plan.probe(0);
+        TEST(plan.errors.size() == 9);     // the missing file
+    }
+    {
+        // A file used again the same way is compressed once, and copied.
+        XMLDocument f;
+        f.Parse(
+            "<Font>"
+            "  <Dir path='.' name='a'><File path='testPa.wav'/><File path='testPb.wav'/></Dir>"
+            "  <Dir path='.' name='b'><File path='testPa.wav'/><File path='testPb.wav' shape='1'/></Dir>"
+            "</Font>");
+        BuildPlan plan;
+        plan.add(f, "font", options);
+        plan.probe(0);
+        TEST(plan.errors.empty());
+        const FileJob& a = plan.dirs[1].files[0];
+        TEST(a.same == &plan.dirs[0].files[0] && a.nSamples == 100);
+        TEST(plan.dirs[1].files[1].same == 0);
+        TEST(plan.schedule().size() == 3);
+
+        plan.dirs[0].files[0].es = compressS4(samples, 100, 0, 0);
+        plan.copySame();
+        TEST(a.es.nCompressed == plan.dirs[0].files[0].es.nCompressed);
+        TEST(memcmp(a.es.compressed.get(), plan.dirs[0].files[0].es.compressed.get(), a.es.nCompressed) == 0);
+    }
+    {
+        XMLDocument d;
+        d.Parse("<Font><Dir");
+        BuildPlan plan;
+        plan.add(d, "broken", options);
+        TEST(plan.errors.size() == 1);
+    }
+    return true;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "memimage.h"
+#include "wavutil.h"
+#include "preprocess.h"
+#include "imagefit.h"
+
+namespace enki { class TaskScheduler; }
+namespace tinyxml2 { class XMLDocument; }
+
+struct BuildOptions {
+    std::string inputPath;
+    bool textFile = false;
+    bool framedText = false;
+    int64_t budget = 0;         // if > 0, the image has to fit in this many bytes
+    std::string previous;       // if set, unchanged data keeps its address in this image
+    std::string trace;          // if set, a Chrome trace of the build is written here
+    CompressOptions compress;   // defaults for the <File> attributes
+    PreprocessOptions pre;      // defaults for the <File> attributes
+};
+
+struct FileJob {
+    std::string name;           // name in the image: the file name without extension
+    std::string fname;          // file name, from the XML
+    std::string fullPath;
+    bool looping = false;
+    bool optional = false;
+    int priority = 1;
+    int nSamples = 0;           // from the WAV header, at 22050 Hz
+    CompressOptions compress;
+    PreprocessOptions pre;
+    std::vector<int16_t> samples;   // only while the file is being compressed
+    EncodedStream es;
+    std::vector<FitChoice> fit;     // ImageFit::Options(), if there is a budget
+    const FileJob* same = 0;        // an earlier job with the same file and options; not compressed itself
+};
+
+struct DirJob {
+    std::string name;
+    std::string postPath;       // empty if post files aren't written
+    std::vector<FileJob> files;
+};
+
+/*
+    Everything about a build that can be known before a sound is read: the
+    XML parsed and checked, and the header of every WAV. A missing
+    attribute, a bad color, or a file that isn't 16 bit mono is found here,
+    in a second or so, not after minutes of compression. All the problems
+    are collected, so one run reports them all.
+*/
+class BuildPlan
+{
+public:
+    std::string imageName;      // "_" + the config name, and the dir names
+    int nPalette = 0;           // 0 if there is no Config; else NUM_PALETTES
+    MemPalette palette[MemPalette::NUM_PALETTES];
+    std::vector<DirJob> dirs;   // in image order
+    std::vector<std::string> errors;
+
+    // Reads the XML 'files' and the WAV headers, in parallel if there is
+    // a 'scheduler'. Returns false if there are any errors.
+    bool load(const std::vector<std::string>& files, const BuildOptions& options, enki::TaskScheduler* scheduler);
+
+    // The order to compress the files in: largest first, so the long
+    // files aren't the stragglers at the end. Jobs that are the 'same' as
+    // another aren't in it.
+    std::vector<FileJob*> schedule();
+
+    // Once the schedule is compressed: the 'same' jobs get a copy of the
+    // encoding of the one they match.
+    void copySame();
+
+    // "rrggbb" to its color; false if it isn't 6 hex digits.
+    static bool ParseHex(const char* in, uint8_t* r, uint8_t* g, uint8_t* b);
+
+    static bool Test();
+
+private:
+    void add(const tinyxml2::XMLDocument& doc, const std::string& name, const BuildOptions& options);
+    void probe(enki::TaskScheduler* scheduler);
+    void error(const char* format, ...);
+};
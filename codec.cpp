@@ -221,3 +221,67 @@ void decodeADPCM(CodecState* state, const u8* input, int numSamples, s16* output
     state->valprev = valpred;
     state->index = index;
 }
+
+/* The encoder's predicted value is exactly what the decoder will output,
+** so the error of encode + decode can be had from the encoder alone: no
+** output buffer, and no decode pass. Same arithmetic as encodeADPCM().
+*/
+int64_t errorADPCM(CodecState* state, const s16* input, int numSamples)
+{
+    int val, sign, delta, diff, step, valpred, vpdiff, index;
+    int64_t error2 = 0;
+
+    valpred = state->valprev;
+    index = state->index;
+    step = stepsizeTable[index];
+
+    for ( ; numSamples > 0 ; numSamples-- ) {
+	val = *input++;
+
+	diff = val - valpred;
+	sign = (diff < 0) ? 8 : 0;
+	if ( sign ) diff = (-diff);
+
+	delta = 0;
+	vpdiff = (step >> 3);
+	if ( diff >= step ) {
+	    delta = 4;
+	    diff -= step;
+	    vpdiff += step;
+	}
+	step >>= 1;
+	if ( diff >= step  ) {
+	    delta |= 2;
+	    diff -= step;
+	    vpdiff += step;
+	}
+	step >>= 1;
+	if ( diff >= step ) {
+	    delta |= 1;
+	    vpdiff += step;
+	}
+
+	if ( sign )
+	  valpred -= vpdiff;
+	else
+	  valpred += vpdiff;
+
+	if ( valpred > 32767 )
+	  valpred = 32767;
+	else if ( valpred < -32768 )
+	  valpred = -32768;
+
+	/* valpred is the decoded sample */
+	error2 += int64_t(val - valpred) * int64_t(val - valpred);
+
+	delta |= sign;
+	index += indexTable[delta];
+	if ( index < 0 ) index = 0;
+	if ( index > 88 ) index = 88;
+	step = stepsizeTable[index];
+    }
+
+    state->valprev = valpred;
+    state->index = index;
+    return error2;
+}
@@ -17,6 +17,8 @@ struct CodecState
 
 void encodeADPCM(CodecState* state, const s16* input, int numSamples, u8* output);
 void decodeADPCM(CodecState* state, const u8* input, int numSamples, s16* output);
+// Sum of the squared error of encodeADPCM() then decodeADPCM(), without either buffer.
+int64_t errorADPCM(CodecState* state, const s16* input, int numSamples);
 
 
 #endif
@@ -0,0 +1,247 @@
+#include "cyclemodel.h"
+#include "wav12util/manifest.h"
+#include "./wav12/expander.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TEST(x) { if (!(x)) { assert(false); return false; }}
+
+CycleOps& CycleOps::operator+=(const CycleOps& rhs)
+{
+    alu += rhs.alu;
+    shift += rhs.shift;
+    mul += rhs.mul;
+    mul64 += rhs.mul64;
+    load += rhs.load;
+    store += rhs.store;
+    branch += rhs.branch;
+    call += rhs.call;
+    return *this;
+}
+
+CycleOps CycleOps::operator*(int n) const
+{
+    CycleOps r;
+    r.alu = alu * n;
+    r.shift = shift * n;
+    r.mul = mul * n;
+    r.mul64 = mul64 * n;
+    r.load = load * n;
+    r.store = store * n;
+    r.branch = branch * n;
+    r.call = call * n;
+    return r;
+}
+
+int CycleOps::instructions() const
+{
+    return alu + shift + mul + mul64 + load + store + branch + call;
+}
+
+int64_t CycleCosts::cycles(const CycleOps& ops) const
+{
+    return int64_t(ops.alu) * alu + int64_t(ops.shift) * shift
+        + int64_t(ops.mul) * mul + int64_t(ops.mul64) * mul64
+        + int64_t(ops.load) * load + int64_t(ops.store) * store
+        + int64_t(ops.branch) * branch + int64_t(ops.call) * call;
+}
+
+// Approximate, from the cores' reference manuals. The M0+ has no 32x32->64
+// multiply; sat_mult() is a call to __aeabi_lmul.
+const CycleCosts CycleModel::COSTS[N_COSTS] = {
+    //                                        mhz  alu shift mul mul64 load store branch call
+    { "m0plus", "Cortex-M0+ (SAMD21, RP2040)", 48,  1,   1,   1,  30,    2,   2,    2,     6 },
+    { "m4",     "Cortex-M4 (SAMD51, Teensy)", 120,  1,   1,   1,   1,    2,   1,    3,     6 },
+    { "esp32",  "Xtensa LX6 (ESP32)",         240,  1,   1,   2,   4,    2,   1,    3,     6 },
+};
+
+const CycleCosts* CycleModel::FindCosts(const char* name)
+{
+    for (int i = 0; i < N_COSTS; ++i) {
+        if (strcmp(COSTS[i].name, name) == 0)
+            return &COSTS[i];
+    }
+    return 0;
+}
+
+// The decoders, statement by statement.
+//                                          alu shift mul mul64 load store branch call
+// S4ADPCM::decode4(), per sample
+static const CycleOps S4_LOOP           = {  1,   0,   0,   0,    0,   0,    1,     0 };  // while (p < end)
+static const CycleOps S4_INDEX          = {  2,   2,   0,   0,    2,   0,    0,     0 };  // index = (*p >> (high << 2)) & 0x0f; p += high
+static const CycleOps S4_MULT           = {  1,   1,   0,   0,    1,   0,    0,     0 };  // mult = 1 << shift
+static const CycleOps S4_GUESS          = {  3,   2,   1,   0,    3,   0,    0,     0 };  // guess(): the /4 is signed
+static const CycleOps S4_VALUE          = {  1,   1,   1,   0,    2,   0,    0,     0 };  // guess + STEP[index] * mult
+static const CycleOps S4_PUSH           = {  0,   0,   0,   0,    0,   2,    0,     0 };  // push()
+static const CycleOps EASING            = {  4,   3,   0,   0,    2,   1,    0,     0 };  // volumeShifted += EASING * fastSign(...)
+static const CycleOps CLAMP_16          = {  4,   0,   0,   0,    2,   0,    2,     0 };  // fastClamp(value, SHRT_MIN, SHRT_MAX)
+static const CycleOps SAT_MULT          = {  6,   0,   0,   1,    2,   0,    2,     0 };  // 64 bit product, clamped to 32
+static const CycleOps ADD_TEST          = {  1,   0,   0,   0,    0,   0,    1,     0 };  // add ?
+static const CycleOps SAT_ADD           = {  9,   3,   0,   0,    1,   0,    0,     0 };  // sat_add(s, out[0])
+static const CycleOps OUT_STEREO        = {  1,   0,   0,   0,    0,   2,    0,     0 };  // out[0] = out[1] = s; out += 2
+static const CycleOps S4_SHIFT          = {  7,   2,   0,   0,    3,   1,    2,     0 };  // doShift()
+static const CycleOps S4_HIGH           = {  2,   0,   0,   0,    0,   1,    0,     0 };  // high = ~high & 1
+// S4ADPCM::decodeN(), per sample, and per byte for the bit buffer
+static const CycleOps SN_LOOP           = {  1,   0,   0,   0,    0,   0,    1,     0 };  // for (i < nSamples)
+static const CycleOps SN_REFILL_TEST    = {  1,   0,   0,   0,    1,   0,    1,     0 };  // if (nBits < bits)
+static const CycleOps SN_REFILL         = {  3,   1,   0,   0,    1,   2,    0,     0 };  // bitBuf |= *p++ << nBits; nBits += 8
+static const CycleOps SN_INDEX          = {  2,   1,   0,   0,    1,   2,    0,     0 };  // index = bitBuf & mask; bitBuf >>= bits; nBits -= bits
+static const CycleOps SN_SHIFT          = {  8,   2,   0,   0,    2,   1,    3,     0 };  // doShiftN(): the 2 bit test is the longer
+// IMAADPCM::decode(), per sample
+static const CycleOps IMA_LOOP          = {  1,   0,   0,   0,    0,   0,    1,     0 };  // while (p < end)
+static const CycleOps IMA_DELTA         = {  3,   2,   0,   0,    2,   0,    0,     0 };  // delta = (*p >> ((1 - high) << 2)) & 0x0f; p += high
+static const CycleOps IMA_STEP          = {  0,   2,   0,   0,    3,   0,    0,     0 };  // step = STEPSIZE_TABLE[index]; vpdiff = step >> 3
+static const CycleOps IMA_VPDIFF        = {  6,   2,   0,   0,    0,   0,    3,     0 };  // the three "if (delta & n)"
+static const CycleOps IMA_VALPREV       = {  3,   0,   0,   0,    1,   1,    1,     0 };  // valprev += sign ? -vpdiff : vpdiff
+static const CycleOps IMA_INDEX         = {  5,   0,   0,   0,    2,   1,    2,     0 };  // index = fastClamp(index + INDEX_TABLE[delta], 0, 88)
+static const CycleOps IMA_HIGH          = {  2,   0,   0,   0,    0,   1,    0,     0 };  // high = ~high & 1
+// The expander and the mixer
+static const CycleOps FETCH_BYTE        = {  2,   0,   0,   0,    1,   1,    1,     0 };  // memcpy() in MemStream::fetch(), unaligned
+static const CycleOps CHUNK             = { 18,   3,   0,   0,    6,   2,    4,     3 };  // a pull() or expandN() loop: fetch(), then the decoder
+static const CycleOps EXPAND_CALL       = {  4,   0,   0,   0,    4,   0,    3,     1 };  // the virtual expand(), its checks
+static const CycleOps DONE_TEST         = {  2,   0,   0,   0,    6,   0,    2,     2 };  // if (loop[i] && expander->done())
+static const CycleOps REWIND            = {  2,   0,   0,   0,    6,  15,    0,     2 };  // rewind(): a new State, and the stream's
+static const CycleOps VOICE             = {  4,   0,   0,   0,    2,   0,    2,     0 };  // fillBuffer()'s loop over the voices
+
+CycleOps CycleModel::SampleOps(int codec, bool add)
+{
+    CycleOps ops;
+    if (codec == MemUnit::CODEC_IMA) {
+        ops += IMA_LOOP;
+        ops += IMA_DELTA;
+        ops += IMA_STEP;
+        ops += IMA_VPDIFF;
+        ops += IMA_VALPREV;
+        ops += CLAMP_16;
+        ops += IMA_INDEX;
+        ops += IMA_HIGH;
+    }
+    else if (codec == MemUnit::CODEC_S4) {
+        ops += S4_LOOP;
+        ops += S4_INDEX;
+        ops += S4_MULT;
+        ops += S4_GUESS;
+        ops += S4_VALUE;
+        ops += S4_PUSH;
+        ops += CLAMP_16;
+        ops += S4_SHIFT;
+        ops += S4_HIGH;
+    }
+    else {
+        ops += SN_LOOP;
+        ops += SN_REFILL_TEST;
+        ops += SN_INDEX;
+        ops += S4_MULT;
+        ops += S4_GUESS;
+        ops += S4_VALUE;
+        ops += S4_PUSH;
+        ops += CLAMP_16;
+        ops += SN_SHIFT;
+    }
+    // The volume and the mix are the same for all.
+    ops += EASING;
+    ops += SAT_MULT;
+    ops += ADD_TEST;
+    if (add)
+        ops += SAT_ADD;
+    ops += OUT_STEREO;
+    return ops;
+}
+
+CycleOps CycleModel::VoiceOps(int codec, int nSamples, bool add, bool looping)
+{
+    const int bits = MemUnit::CodecBits(codec);
+    // A looping voice that ends in the buffer takes a second expand(),
+    // which starts a chunk of its own.
+    const int calls = looping ? 2 : 1;
+    const int bytes = (nSamples * bits + 7) / 8 + (calls - 1);
+    const int chunks = (bytes + wav12::Expander::BUFFER_SIZE - 1) / wav12::Expander::BUFFER_SIZE + (calls - 1);
+
+    CycleOps ops = VOICE;
+    ops += EXPAND_CALL * calls;
+    ops += DONE_TEST * calls;
+    if (looping)
+        ops += REWIND;
+    ops += CHUNK * chunks;
+    ops += FETCH_BYTE * bytes;
+    if (bits != 4)
+        ops += SN_REFILL * bytes;
+    ops += SampleOps(codec, add) * nSamples;
+    return ops;
+}
+
+CycleOps CycleModel::BufferOps(int codec, int nVoices, int nSamples)
+{
+    CycleOps ops;
+    for (int i = 0; i < nVoices; ++i)
+        ops += VoiceOps(codec, nSamples, i > 0, true);
+    return ops;
+}
+
+void CycleModel::Report(const CycleCosts* costs, int codec, int maxVoices, int bufferSamples, int mhz, int cpuPercent)
+{
+    if (!costs) {
+        for (int i = 0; i < N_COSTS; ++i)
+            Report(&COSTS[i], codec, maxVoices, bufferSamples, mhz, cpuPercent);
+        return;
+    }
+    const int clock = mhz > 0 ? mhz : costs->mhz;
+    // Cycles between buffers, at 22050 Hz.
+    const int64_t period = int64_t(clock) * 1000000 * bufferSamples / 22050;
+
+    const CycleOps first = SampleOps(codec, false);
+    const CycleOps rest = SampleOps(codec, true);
+    printf("%s (%s) at %d MHz, %s, %d sample buffers (%.1f ms, %lld cycles)\n",
+        costs->description, costs->name, clock, MemUnit::CodecName(codec), bufferSamples,
+        bufferSamples * 1000.0 / 22050.0, (long long)period);
+    printf("  per sample: first voice %d instructions %d cycles, others %d instructions %d cycles\n",
+        first.instructions(), int(costs->cycles(first)), rest.instructions(), int(costs->cycles(rest)));
+    printf("  voices  cycles/buffer  cycles/sample    cpu\n");
+
+    int fit = 0;
+    for (int v = 1; v <= maxVoices; ++v) {
+        int64_t cycles = costs->cycles(BufferOps(codec, v, bufferSamples));
+        double cpu = 100.0 * double(cycles) / double(period);
+        printf("  %6d  %13lld  %13lld  %5.1f%%\n", v, (long long)cycles, (long long)(cycles / bufferSamples), cpu);
+        if (cpu <= cpuPercent)
+            fit = v;
+    }
+    printf("  %d voices fit in %d%% of the CPU%s\n", fit, cpuPercent, fit == maxVoices ? " (or more)" : "");
+}
+
+bool CycleModel::Test()
+{
+    static const int N = 256;
+    TEST(FindCosts("m4") == &COSTS[1]);
+    TEST(FindCosts("z80") == 0);
+
+    for (int codec = 0; codec < MemUnit::NUM_CODECS; ++codec) {
+        // Each voice after the first costs the same.
+        CycleOps two = BufferOps(codec, 2, N);
+        CycleOps three = BufferOps(codec, 3, N);
+        CycleOps voice = VoiceOps(codec, N, true, true);
+        two += voice;
+        TEST(memcmp(&two, &three, sizeof(CycleOps)) == 0);
+
+        // Mixing in costs more than writing; looping costs more than not.
+        for (const CycleCosts& c : COSTS) {
+            TEST(c.cycles(SampleOps(codec, true)) > c.cycles(SampleOps(codec, false)));
+            TEST(c.cycles(VoiceOps(codec, N, true, true)) > c.cycles(VoiceOps(codec, N, true, false)));
+        }
+    }
+    // A chunk of the expander is BUFFER_SIZE bytes: 256 S4 samples are one,
+    // 258 are two.
+    CycleOps a = VoiceOps(MemUnit::CODEC_S4, wav12::Expander::BUFFER_SIZE * 2, false, false);
+    CycleOps b = VoiceOps(MemUnit::CODEC_S4, wav12::Expander::BUFFER_SIZE * 2 + 2, false, false);
+    CycleOps more = CHUNK;
+    more += FETCH_BYTE;
+    more += SampleOps(MemUnit::CODEC_S4, false) * 2;
+    a += more;
+    TEST(memcmp(&a, &b, sizeof(CycleOps)) == 0);
+
+    // The M0+ pays for the 64 bit multiply in sat_mult().
+    TEST(COSTS[0].cycles(SampleOps(MemUnit::CODEC_S4, false)) > COSTS[1].cycles(SampleOps(MemUnit::CODEC_S4, false)) + 20);
+    return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+
+// Operations by kind: what a compiler emits for a path of the decoder, on a
+// 32 bit load/store core with no conditional execution.
+struct CycleOps {
+    int alu = 0;        // add, sub, logic, compare, move
+    int shift = 0;
+    int mul = 0;        // 32 x 32 -> 32
+    int mul64 = 0;      // 32 x 32 -> 64 (sat_mult)
+    int load = 0;
+    int store = 0;
+    int branch = 0;     // taken, the worst case
+    int call = 0;       // call and return, direct or virtual
+
+    CycleOps& operator+=(const CycleOps& rhs);
+    CycleOps operator*(int n) const;
+    int instructions() const;
+};
+
+// Cycles per operation on one core.
+struct CycleCosts {
+    const char* name;
+    const char* description;
+    int mhz;            // a typical clock, for the CPU percentage
+    int alu, shift, mul, mul64, load, store, branch, call;
+
+    int64_t cycles(const CycleOps& ops) const;
+};
+
+/*
+    An estimate, from the desktop, of what the device spends on audio:
+    the operations along fillBuffer() -> expand() -> decode4() (or decodeN(),
+    or the IMA decode) per sample, per fetched byte, per chunk of the
+    expander's buffer, and per voice, priced with a cost table per core.
+
+    The counts are by hand from the source, and have to follow it when the
+    decoders change. They are the worst case: all the State in memory,
+    every branch taken, each looping voice wrapping within the buffer, and
+    an unaligned (byte by byte) copy from the stream. Interrupts, flash
+    wait states, and cache misses aren't counted.
+*/
+class CycleModel
+{
+public:
+    static const int N_COSTS = 3;
+    static const CycleCosts COSTS[N_COSTS];
+    // "m0plus", "m4", or "esp32". Null if unknown.
+    static const CycleCosts* FindCosts(const char* name);
+
+    // One voice of fillBuffer(): voice 0 writes the buffer, the rest add.
+    static CycleOps VoiceOps(int codec, int nSamples, bool add, bool looping);
+    // nVoices, all of one codec, looping.
+    static CycleOps BufferOps(int codec, int nVoices, int nSamples);
+    // One decoded sample, without the per byte and per buffer parts.
+    static CycleOps SampleOps(int codec, bool add);
+
+    // Prints cycles per buffer for 1 to maxVoices, and how many voices fit
+    // in 'cpuPercent' of the core. costs == 0 reports every core. mhz 0
+    // uses each core's own clock.
+    static void Report(const CycleCosts* costs, int codec, int maxVoices, int bufferSamples, int mhz, int cpuPercent);
+
+    static bool Test();
+};
@@ -0,0 +1,200 @@
+#include "errormetric.h"
+#include "wavutil.h"
+
+#include <assert.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#define TEST(x) { if (!(x)) { assert(false); return false; }}
+
+static const char* const METRIC_NAMES[] = { "mse", "emphasis", "segsnr" };
+
+const char* ErrorMetricName(ErrorMetric metric)
+{
+    return METRIC_NAMES[int(metric)];
+}
+
+bool ParseErrorMetric(const char* name, ErrorMetric* metric)
+{
+    for (int i = 0; i < 3; ++i) {
+        if (strcmp(name, METRIC_NAMES[i]) == 0) {
+            *metric = ErrorMetric(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Sum of e[i]^2. The values are differences of 16 bit samples, so the
+// squares are exact in 64 bits.
+static int64_t SumSquares(const int32_t* e, int n)
+{
+    int64_t sum = 0;
+    int i = 0;
+#if W12_SSE2()
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 4 <= n; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(e + i));
+        __m128i sign = _mm_srai_epi32(x, 31);
+        x = _mm_sub_epi32(_mm_xor_si128(x, sign), sign);    // abs, so the unsigned multiply works
+        acc = _mm_add_epi64(acc, _mm_mul_epu32(x, x));       // lanes 0 and 2
+        x = _mm_srli_epi64(x, 32);
+        acc = _mm_add_epi64(acc, _mm_mul_epu32(x, x));       // lanes 1 and 3
+    }
+    int64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    sum = lanes[0] + lanes[1];
+#endif
+    for (; i < n; ++i)
+        sum += int64_t(e[i]) * int64_t(e[i]);
+    return sum;
+}
+
+
+void ErrorAccum::add(const int16_t* src, const int16_t* decoded, int n)
+{
+    int32_t e[SEGMENT];
+    while (n > 0) {
+        // Chunks end on segment boundaries, so the segments don't depend on
+        // how the samples are split up. (m_segN is always 0 for the others.)
+        int k = std::min(n, SEGMENT - m_segN);
+        for (int i = 0; i < k; ++i)
+            e[i] = int32_t(src[i]) - int32_t(decoded[i]);
+
+        if (m_metric == ErrorMetric::EMPHASIS) {
+            // e' = e[n] - 0.9375 e[n-1]
+            for (int i = 0; i < k; ++i) {
+                int32_t d = e[i];
+                e[i] = (16 * d - 15 * m_prev) >> 4;
+                m_prev = d;
+            }
+        }
+
+        if (m_metric == ErrorMetric::SEGSNR) {
+            m_segNoise2 += SumSquares(e, k);
+            for (int i = 0; i < k; ++i)
+                e[i] = src[i];
+            m_segSignal2 += SumSquares(e, k);
+            m_segN += k;
+            if (m_segN == SEGMENT)
+                flushSegment();
+        }
+        else {
+            m_sum += SumSquares(e, k);
+            m_n += k;
+        }
+        src += k;
+        decoded += k;
+        n -= k;
+    }
+}
+
+
+int32_t ErrorAccum::SegmentSNR(int64_t signal2, int64_t noise2)
+{
+    double db = 10.0 * log10((double(signal2) + 1.0) / (double(noise2) + 1.0));
+    db = std::min(std::max(db, double(SNR_MIN)), double(SNR_MAX));
+    return int32_t(lround(db * 100.0));
+}
+
+
+void ErrorAccum::flushSegment()
+{
+    m_sum += SegmentSNR(m_segSignal2, m_segNoise2);
+    m_n++;
+    m_segSignal2 = m_segNoise2 = 0;
+    m_segN = 0;
+}
+
+
+int32_t ErrorAccum::result() const
+{
+    if (m_metric == ErrorMetric::SEGSNR) {
+        int64_t sum = m_sum;
+        int64_t n = m_n;
+        if (m_segN) {
+            sum += SegmentSNR(m_segSignal2, m_segNoise2);
+            n++;
+        }
+        return n ? int32_t(SNR_MAX * 100 - sum / n) : 0;
+    }
+    return m_n ? int32_t(m_sum / m_n) : 0;
+}
+
+
+bool ErrorAccum::Test()
+{
+    static const int N = 1000;
+    int16_t src[N], dec[N];
+    uint32_t r = 7;
+    for (int i = 0; i < N; ++i) {
+        r = r * 1103515245 + 12345;
+        src[i] = int16_t(r >> 16);
+        dec[i] = int16_t(src[i] + int16_t(r >> 8) % 400);
+    }
+    dec[10] = -32768;
+    src[10] = 32767;
+
+    // MSE is the plain sum of squares, and no metric depends on how the
+    // samples are split up.
+    int64_t error2 = 0;
+    for (int i = 0; i < N; ++i)
+        error2 += int64_t(src[i] - dec[i]) * int64_t(src[i] - dec[i]);
+    for (int m = 0; m < 3; ++m) {
+        const ErrorMetric metric = ErrorMetric(m);
+        ErrorAccum whole(metric), pieces(metric);
+        whole.add(src, dec, N);
+        for (int pos = 0, piece = 1; pos < N; pos += piece, piece += 7) {
+            piece = std::min(piece, N - pos);
+            pieces.add(src + pos, dec + pos, piece);
+        }
+        TEST(whole.result() == pieces.result());
+        if (metric == ErrorMetric::MSE)
+            TEST(whole.result() == int32_t(error2 / N));
+
+        ErrorMetric parsed;
+        TEST(ParseErrorMetric(ErrorMetricName(metric), &parsed) && parsed == metric);
+    }
+
+    // The same error power: a DC offset vs. at the Nyquist frequency. MSE
+    // can't tell them apart; pre-emphasis weights the high one.
+    for (int i = 0; i < N; ++i)
+        src[i] /= 4;    // room for the error
+    int16_t low[N], high[N];
+    for (int i = 0; i < N; ++i) {
+        low[i] = int16_t(src[i] + 100);
+        high[i] = int16_t(src[i] + ((i & 1) ? 100 : -100));
+    }
+    {
+        ErrorAccum a, b, c(ErrorMetric::EMPHASIS), d(ErrorMetric::EMPHASIS);
+        a.add(src, low, N);
+        b.add(src, high, N);
+        c.add(src, low, N);
+        d.add(src, high, N);
+        TEST(a.result() == b.result());
+        TEST(c.result() < d.result());
+    }
+
+    // A loud half and a quiet half, with the same error in one or the
+    // other. Segmental SNR says the error in the quiet half is worse.
+    int16_t loudQuiet[N], errLoud[N], errQuiet[N];
+    for (int i = 0; i < N; ++i) {
+        loudQuiet[i] = int16_t((i < N / 2) ? src[i] : src[i] / 64);
+        int16_t err = (i & 1) ? 50 : -50;
+        errLoud[i] = int16_t(loudQuiet[i] + (i < N / 2 ? err : 0));
+        errQuiet[i] = int16_t(loudQuiet[i] + (i < N / 2 ? 0 : err));
+    }
+    {
+        ErrorAccum a, b, c(ErrorMetric::SEGSNR), d(ErrorMetric::SEGSNR), e(ErrorMetric::SEGSNR);
+        a.add(loudQuiet, errLoud, N);
+        b.add(loudQuiet, errQuiet, N);
+        c.add(loudQuiet, errLoud, N);
+        d.add(loudQuiet, errQuiet, N);
+        e.add(loudQuiet, loudQuiet, N);
+        TEST(a.result() == b.result());
+        TEST(c.result() < d.result());
+        TEST(e.result() < c.result());
+    }
+    return true;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+
+// How the candidate encodings of a file are compared. All are "lower is
+// better", and a value only compares with values of the same metric.
+enum class ErrorMetric {
+    MSE,        // mean squared error; what the image stores as aveError2
+    EMPHASIS,   // MSE after a first order pre-emphasis, so high frequency error counts for more
+    SEGSNR,     // segmental SNR: error in quiet passages counts as much as in loud ones
+};
+
+const char* ErrorMetricName(ErrorMetric metric);
+// "mse", "emphasis", or "segsnr". Returns false if unknown.
+bool ParseErrorMetric(const char* name, ErrorMetric* metric);
+
+/*
+    Adds up the error between the source and the decoded samples as they
+    come out of the decoder, a block at a time. One pass, no copy of the
+    whole sound, and the same result however the samples are split up.
+*/
+class ErrorAccum
+{
+public:
+    ErrorAccum(ErrorMetric metric = ErrorMetric::MSE) : m_metric(metric) {}
+
+    void add(const int16_t* src, const int16_t* decoded, int n);
+    // MSE and EMPHASIS: per sample, in squared sample units.
+    // SEGSNR: (SNR_MAX - the average SNR) in 1/100 dB.
+    int32_t result() const;
+
+    static const int SEGMENT = 256;     // samples, about 12ms
+    // dB; segments are clamped to this range. The top is higher than the
+    // usual 35, or the good candidates would all tie.
+    static const int SNR_MIN = -10;
+    static const int SNR_MAX = 60;
+
+    static bool Test();
+
+private:
+    void flushSegment();
+    static int32_t SegmentSNR(int64_t signal2, int64_t noise2);
+
+    ErrorMetric m_metric;
+    int64_t m_sum = 0;          // squared error, or segment SNRs in 1/100 dB
+    int64_t m_n = 0;            // samples, or segments
+    int32_t m_prev = 0;         // last error, for the pre-emphasis
+    int64_t m_segSignal2 = 0;   // the current segment
+    int64_t m_segNoise2 = 0;
+    int m_segN = 0;
+};
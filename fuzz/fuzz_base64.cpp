@@ -0,0 +1,36 @@
+// libFuzzer target: decodeBase64() of any chars, and the round trip of
+// any bytes. Buffers are exactly the documented sizes, so a read or write
+// past them is caught. See readme.md for how to build it.
+
+#include "../wavutil.h"
+
+#include <string.h>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    if (size > 1 << 20)
+        return 0;
+
+    // The input as chars: as many whole bytes as they hold.
+    {
+        const int nBytes = int(size / 4 * 3);
+        std::vector<char> src(data, data + base64Size(nBytes));
+        std::vector<uint8_t> dst(nBytes);
+        decodeBase64(src.data(), nBytes, dst.data());
+    }
+
+    // The input as bytes: encode, then decode back.
+    {
+        const int nBytes = int(size);
+        std::vector<char> chars(base64Size(nBytes) + 1);
+        std::vector<uint8_t> back(nBytes);
+        encodeBase64(data, nBytes, chars.data(), true);
+        if (strlen(chars.data()) != size_t(base64Size(nBytes)))
+            __builtin_trap();
+        decodeBase64(chars.data(), nBytes, back.data());
+        if (nBytes && memcmp(back.data(), data, nBytes) != 0)
+            __builtin_trap();
+    }
+    return 0;
+}
@@ -0,0 +1,65 @@
+// libFuzzer target: decode4() (and decodeN(), and IMA) of random bytes,
+// with any table, predictor, and volume. S4Lanes has to agree with
+// decode4(), with and without SIMD. See readme.md for how to build it.
+
+#include "../s4lanes.h"
+#include "../wavutil.h"
+#include "../wav12/s4adpcm.h"
+#include "../wav12/imaadpcm.h"
+
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    if (size < 4 || size > 1 << 16)
+        return 0;
+    const int bits = 2 + data[0] % 3;       // 2, 3, 4
+    const bool ima = data[0] >= 0xf0;
+    const int table = data[1] % S4ADPCM::numTables(bits);
+    const int predictor = data[2] % S4ADPCM::State::N_PREDICTOR;
+    const int32_t volume = data[3] * 2;     // 0 - 510: boost and clip too
+    const bool add = (data[0] & 0x80) != 0;
+    data += 4;
+    size -= 4;
+
+    // Exactly the bytes and samples, so an overrun is caught.
+    const std::vector<uint8_t> compressed(data, data + size);
+    const int nSamples = int(size * 8 / bits) & ~1;
+    std::vector<int32_t> stereo(size_t(nSamples) * 2, 0x1234);
+
+    if (ima) {
+        IMAADPCM::State state;
+        IMAADPCM::decode(compressed.data(), int(size) * 2, volume, add, stereo.data(), &state);
+        return 0;
+    }
+
+    S4ADPCM::State state(S4ADPCM::getTable(table, bits), predictor);
+    if (bits == 4)
+        S4ADPCM::decode4(compressed.data(), nSamples, volume, add, stereo.data(), &state);
+    else
+        S4ADPCM::decodeN(bits, compressed.data(), nSamples, volume, add, stereo.data(), &state);
+    if (bits != 4)
+        return 0;
+
+    // The lanes decoder against decode4(), at volume 256 with no easing.
+    std::vector<int32_t> ref(size_t(nSamples) * 2);
+    S4ADPCM::State refState(S4ADPCM::getTable(table), predictor);
+    refState.volumeShifted = 256 << 8;
+    S4ADPCM::decode4(compressed.data(), nSamples, 256, false, ref.data(), &refState);
+    std::vector<int16_t> expected(nSamples);
+    WavWriter::NarrowStereo32(ref.data(), nSamples, expected.data());
+
+    for (int simd = 0; simd <= 1; ++simd) {
+        std::vector<int16_t> out(nSamples);
+        S4Job job;
+        job.compressed = compressed.data();
+        job.nSamples = nSamples;
+        job.table = S4ADPCM::getTable(table);
+        job.predictor = predictor;
+        job.out = out.data();
+        S4Lanes::Decode(&job, 1, simd != 0);
+        if (out != expected)
+            __builtin_trap();
+    }
+    return 0;
+}
@@ -0,0 +1,67 @@
+// libFuzzer target: an image, binary or text, loaded through Manifest and
+// then played: every file is looked up by name and decoded, as the device
+// and 'wav12 inspect' do. See readme.md for how to build it.
+
+#include "../memimage.h"
+#include "../wavutil.h"
+#include "../wav12util/manifest.h"
+#include "../wav12/expander.h"
+
+#include <string.h>
+#include <vector>
+
+static void Play(const uint8_t* image, uint32_t size)
+{
+    Manifest manifest;
+    if (!manifest.load(image, size))
+        return;
+
+    static const int MAX_SAMPLES = 4096;
+    static int32_t stereo[MAX_SAMPLES * 2];
+
+    for (int d = 0; d < manifest.numDir(); ++d) {
+        char dirName[MemUnit::NAME_ALLOC] = { 0 };
+        memcpy(dirName, manifest.getUnit(d).name, MemUnit::NAME_LEN);
+        manifest.getDir(dirName);
+
+        int start = 0, n = 0;
+        manifest.dirRange(d, &start, &n);
+        for (int i = start; i < start + n; ++i) {
+            const MemUnit& unit = manifest.getUnit(i);
+            char fileName[MemUnit::NAME_ALLOC] = { 0 };
+            memcpy(fileName, unit.name, MemUnit::NAME_LEN);
+            manifest.getFile(d, fileName);
+
+            MemStream stream(image, size);
+            stream.set(unit.offset, unit.size);
+            wav12::ExpanderAD4 ad4;
+            wav12::ExpanderIMA ima;
+            wav12::Expander* expander = &ad4;
+            if (unit.codec == MemUnit::CODEC_IMA) {
+                ima.init(&stream);
+                expander = &ima;
+            }
+            else {
+                const int bits = MemUnit::CodecBits(unit.codec);
+                ad4.init(&stream, S4ADPCM::getTable(unit.table, bits), unit.predictor, bits);
+            }
+            const bool loop = true;
+            const int volume = 256;
+            wav12::Expander::fillBuffer(stereo, MAX_SAMPLES, &expander, 1, &loop, &volume, false);
+        }
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    // A copy of exactly the size, so a read past the end is caught.
+    std::vector<uint8_t> image(data, data + size);
+    Play(image.data(), uint32_t(image.size()));
+
+    std::vector<uint8_t> parsed;
+    std::vector<int> badLines;
+    MemImageUtil::ParseText((const char*)image.data(), image.size(), &parsed, &badLines);
+    if (!parsed.empty())
+        Play(parsed.data(), uint32_t(parsed.size()));
+    return 0;
+}
@@ -0,0 +1,42 @@
+// libFuzzer target: a WAV file, read the way PcmFile::Read() does.
+// See readme.md for how to build it.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+extern "C" {
+#include "../wave_reader.h"
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    if (size == 0)
+        return 0;
+    FILE* fp = fmemopen((void*)data, size, "rb");
+    if (!fp)
+        return 0;
+
+    wave_reader_error error = WR_NO_ERROR;
+    wave_reader* wr = wave_reader_open_file(fp, &error);
+    if (!wr)
+        return 0;
+
+    const int nChannels = wave_reader_get_num_channels(wr);
+    const int bits = wave_reader_get_sample_bits(wr);
+    const int nSamples = wave_reader_get_num_samples(wr);
+    // The reader promises no more samples than the data holds.
+    if (nChannels <= 0 || bits <= 0 || nSamples < 0 || size_t(nSamples) > size)
+        __builtin_trap();
+
+    // Exactly the size it asks for, so an overrun is caught.
+    std::vector<uint8_t> buffer(size_t(nSamples) * nChannels * (bits / 8));
+    if (!buffer.empty()) {
+        int n = wave_reader_get_samples(wr, nSamples, buffer.data());
+        if (n > nSamples)
+            __builtin_trap();
+    }
+    wave_reader_close(wr);
+    return 0;
+}
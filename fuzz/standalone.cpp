@@ -0,0 +1,30 @@
+// Runs a fuzz target over the files on the command line, once each: for
+// replaying a crash, or the corpus as a regression test, with a compiler
+// that has the sanitizers but not libFuzzer.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+int main(int argc, const char* argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        FILE* fp = fopen(argv[i], "rb");
+        if (!fp) {
+            printf("Failed to open: %s\n", argv[i]);
+            return 1;
+        }
+        std::vector<uint8_t> data;
+        uint8_t buf[4096];
+        size_t n = 0;
+        while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+            data.insert(data.end(), buf, buf + n);
+        fclose(fp);
+
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+        printf("%s: okay\n", argv[i]);
+    }
+    return 0;
+}
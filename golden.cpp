@@ -0,0 +1,814 @@
+#include "golden.h"
+#include "wavutil.h"
+#include "codec.h"
+#include "errormetric.h"
+#include "s4lanes.h"
+#include "prefetch.h"
+#include "wav12util/manifest.h"
+#include "./wav12/expander.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#define TEST(x) { if (!(x)) { assert(false); return false; }}
+
+static const char* const SIGNAL_NAMES[Golden::N_SIGNALS] = {
+    "sine", "chirp", "noise", "square", "impulse", "hum"
+};
+
+// The noise shapes pinned besides 0, at table 0 and the default predictor.
+static const int SHAPES[2] = { -S4ADPCM::MAX_NOISE_SHAPE, S4ADPCM::MAX_NOISE_SHAPE };
+static const int N_VECTORS = S4ADPCM::N_TABLES * S4ADPCM::State::N_PREDICTOR + 2
+    + S4ADPCM::N_TABLES_3 * S4ADPCM::State::N_PREDICTOR
+    + S4ADPCM::N_TABLES_2 * S4ADPCM::State::N_PREDICTOR
+    + 1;
+
+extern const GoldenVector GOLDEN[Golden::N_SIGNALS][N_VECTORS];
+
+const char* Golden::SignalName(int signal)
+{
+    return SIGNAL_NAMES[signal];
+}
+
+// A triangle wave: 'phase' is the top 16 bits of the cycle, 'amp' is Q15.
+static int32_t Triangle(uint32_t phase, int32_t amp)
+{
+    int32_t v = phase < 32768 ? int32_t(phase) * 2 - 32768 : (65535 - int32_t(phase)) * 2 - 32768;
+    return v * amp >> 15;
+}
+
+void Golden::Signal(int signal, int16_t* out)
+{
+    uint32_t rng = 12345 + signal;
+    auto noise = [&]() {
+        rng = rng * 1664525u + 1013904223u;
+        return int32_t(rng >> 16) - 32768;
+    };
+
+    switch (signal) {
+    case 0:     // 440 Hz
+        wav12::ExpanderAD4::generateTestData(N_SAMPLES, out);
+        break;
+    case 1: {   // a rising triangle, about 90 Hz to 1.4 kHz
+        uint32_t phase = 0, inc = 18000000;
+        for (int i = 0; i < N_SAMPLES; ++i) {
+            out[i] = int16_t(Triangle(phase >> 16, 20000));
+            phase += inc;
+            inc += 64000;
+        }
+        break;
+    }
+    case 2:     // white, full scale: the shift at its limit
+        for (int i = 0; i < N_SAMPLES; ++i)
+            out[i] = int16_t(noise());
+        break;
+    case 3:     // edges to the rails: the clamps
+        for (int i = 0; i < N_SAMPLES; ++i)
+            out[i] = (i / 55) & 1 ? 32767 : -32768;
+        break;
+    case 4: {   // silence, then a click and a decaying burst: the shift down to 0
+        int32_t amp = 32767;
+        for (int i = 0; i < N_SAMPLES; ++i) {
+            if (i < 1000) {
+                out[i] = 0;
+            }
+            else if (i == 1000) {
+                out[i] = 32767;
+            }
+            else {
+                out[i] = int16_t(noise() * amp >> 15);
+                amp = amp * 253 / 256;
+            }
+        }
+        break;
+    }
+    case 5:     // quiet, with two tones and a little noise
+        for (int i = 0; i < N_SAMPLES; ++i) {
+            uint32_t a = uint32_t(i % 200) * 65536 / 200;
+            uint32_t b = uint32_t(i % 301) * 65536 / 301;
+            out[i] = int16_t(Triangle(a, 3000) + Triangle(b, 2000) + (noise() >> 10));
+        }
+        break;
+    default:
+        assert(false);
+    }
+}
+
+// The CRC-32 of the 16 bit samples, as bytes.
+static uint32_t SampleCRC32(const int16_t* samples, int n)
+{
+    return crc32((const uint8_t*)samples, size_t(n) * 2);
+}
+
+static int32_t ErrorOf(const int16_t* src, const int16_t* decoded, int n)
+{
+    ErrorAccum accum(ErrorMetric::MSE);
+    accum.add(src, decoded, n);
+    return accum.result();
+}
+
+// The device decoders, called once over the stream at volume 256, with no easing.
+static void DecodeReference(const GoldenVector& v, const uint8_t* data, int n, int16_t* out)
+{
+    std::vector<int32_t> stereo(size_t(n) * 2 + 2);
+    if (v.codec == MemUnit::CODEC_IMA) {
+        IMAADPCM::State state;
+        state.volumeShifted = 256 << 8;
+        IMAADPCM::decode(data, n, 256, false, stereo.data(), &state);
+    }
+    else {
+        const int bits = MemUnit::CodecBits(v.codec);
+        S4ADPCM::State state(S4ADPCM::getTable(v.table, bits), v.predictor);
+        state.volumeShifted = 256 << 8;
+        if (bits == 4)
+            S4ADPCM::decode4(data, n, 256, false, stereo.data(), &state);
+        else
+            S4ADPCM::decodeN(bits, data, n, 256, false, stereo.data(), &state);
+    }
+    WavWriter::NarrowStereo32(stereo.data(), n, out);
+}
+
+static void Encode(GoldenVector* v, const int16_t* samples, int n, std::vector<uint8_t>* stream)
+{
+    const int bits = MemUnit::CodecBits(v->codec);
+    stream->assign((size_t(n) * bits + 7) / 8 + 1, 0);
+    int bytes = 0;
+    if (v->codec == MemUnit::CODEC_IMA) {
+        CodecState state = { 0, 0 };
+        encodeADPCM(&state, samples, n, stream->data());
+        bytes = n / 2;
+    }
+    else {
+        S4ADPCM::State state(S4ADPCM::getTable(v->table, bits), v->predictor);
+        if (bits == 4)
+            bytes = S4ADPCM::encode4(samples, n, stream->data(), &state, v->noiseShape);
+        else {
+            bytes = S4ADPCM::encodeN(bits, samples, n, stream->data(), &state);
+            bytes += S4ADPCM::flushN(stream->data() + bytes, &state);
+        }
+    }
+    stream->resize(bytes);
+
+    std::vector<int16_t> decoded(n + 1);
+    DecodeReference(*v, stream->data(), n, decoded.data());
+    v->compressedCRC = crc32(stream->data(), stream->size());
+    v->decodedCRC = SampleCRC32(decoded.data(), n);
+    v->error = ErrorOf(samples, decoded.data(), n);
+}
+
+void Golden::Compute(const int16_t* samples, int n, std::vector<GoldenVector>* vectors, std::vector<std::vector<uint8_t>>* streams)
+{
+    assert((n & 1) == 0);
+    vectors->clear();
+    auto add = [&](int codec, int table, int predictor, int shape) {
+        GoldenVector v = { codec, table, predictor, shape, 0, 0, 0 };
+        vectors->push_back(v);
+    };
+    for (int t = 0; t < S4ADPCM::N_TABLES; ++t)
+        for (int p = 0; p < S4ADPCM::State::N_PREDICTOR; ++p)
+            add(MemUnit::CODEC_S4, t, p, 0);
+    for (int shape : SHAPES)
+        add(MemUnit::CODEC_S4, 0, S4ADPCM::State::PREDICTOR, shape);
+    for (int t = 0; t < S4ADPCM::N_TABLES_3; ++t)
+        for (int p = 0; p < S4ADPCM::State::N_PREDICTOR; ++p)
+            add(MemUnit::CODEC_S3, t, p, 0);
+    for (int t = 0; t < S4ADPCM::N_TABLES_2; ++t)
+        for (int p = 0; p < S4ADPCM::State::N_PREDICTOR; ++p)
+            add(MemUnit::CODEC_S2, t, p, 0);
+    add(MemUnit::CODEC_IMA, 0, 0, 0);
+    assert(vectors->size() == N_VECTORS);
+
+    std::vector<uint8_t> stream;
+    if (streams)
+        streams->clear();
+    for (GoldenVector& v : *vectors) {
+        Encode(&v, samples, n, &stream);
+        if (streams)
+            streams->push_back(stream);
+    }
+}
+
+int Golden::Check(const int16_t* samples, int n, const GoldenVector* golden, int nGolden, const char* name)
+{
+    int failures = 0;
+    auto fail = [&](const GoldenVector& v, const char* what) {
+        printf("Golden mismatch: %s %s table=%d predictor=%d shape=%d: %s\n",
+            name, MemUnit::CodecName(v.codec), v.table, v.predictor, v.noiseShape, what);
+        ++failures;
+    };
+
+    std::vector<GoldenVector> vectors;
+    std::vector<std::vector<uint8_t>> streams;
+    Compute(samples, n, &vectors, &streams);
+    if (int(vectors.size()) != nGolden) {
+        printf("Golden mismatch: %s has %d vectors, expected %d\n", name, nGolden, int(vectors.size()));
+        return 1;
+    }
+
+    // The encoders, and the reference decoders.
+    for (int i = 0; i < nGolden; ++i) {
+        const GoldenVector& g = golden[i];
+        const GoldenVector& v = vectors[i];
+        if (g.codec != v.codec || g.table != v.table || g.predictor != v.predictor || g.noiseShape != v.noiseShape) {
+            fail(g, "setting");
+            return failures;
+        }
+        if (v.compressedCRC != g.compressedCRC) fail(g, "compressed bytes");
+        if (v.decodedCRC != g.decodedCRC) fail(g, "decode");
+        if (v.error != g.error) fail(g, "error");
+    }
+
+    // The expanders, in uneven pieces, from the golden stream.
+    static const int PIECES[4] = { 2, 30, 256, 98 };
+    std::vector<int32_t> stereo(size_t(n) * 2 + 2);
+    std::vector<int16_t> decoded(n + 1);
+    for (int i = 0; i < nGolden; ++i) {
+        const GoldenVector& g = golden[i];
+        const std::vector<uint8_t>& s = streams[i];
+        MemStream stream(s.data(), uint32_t(s.size()));
+        stream.set(0, uint32_t(s.size()));
+        wav12::ExpanderAD4 ad4;
+        wav12::ExpanderIMA ima;
+        wav12::Expander* expander = &ad4;
+        if (g.codec == MemUnit::CODEC_IMA) {
+            ima.init(&stream);
+            expander = &ima;
+        }
+        else {
+            const int bits = MemUnit::CodecBits(g.codec);
+            ad4.init(&stream, S4ADPCM::getTable(g.table, bits), g.predictor, bits);
+        }
+        int pos = 0;
+        for (int p = 0; pos < n; ++p) {
+            int want = std::min(PIECES[p % 4], n - pos);
+            int got = expander->expand(stereo.data() + pos * 2, want, 256, false, p == 0);
+            if (got != want)
+                break;
+            pos += got;
+        }
+        WavWriter::NarrowStereo32(stereo.data(), pos, decoded.data());
+        if (pos != n || SampleCRC32(decoded.data(), n) != g.decodedCRC)
+            fail(g, "expander");
+
+        // The tool's IMA decoder has to agree with the device's.
+        if (g.codec == MemUnit::CODEC_IMA) {
+            CodecState state = { 0, 0 };
+            decodeADPCM(&state, s.data(), n, decoded.data());
+            if (SampleCRC32(decoded.data(), n) != g.decodedCRC)
+                fail(g, "decodeADPCM");
+        }
+    }
+
+    // S4Lanes: every S4 stream at once, with and without SIMD.
+    std::vector<S4Job> jobs;
+    std::vector<int> index;
+    for (int i = 0; i < nGolden; ++i) {
+        if (golden[i].codec == MemUnit::CODEC_S4) {
+            S4Job job;
+            job.compressed = streams[i].data();
+            job.nSamples = n;
+            job.table = S4ADPCM::getTable(golden[i].table);
+            job.predictor = golden[i].predictor;
+            jobs.push_back(job);
+            index.push_back(i);
+        }
+    }
+    std::vector<int16_t> lanesOut(jobs.size() * (n + 1));
+    for (int simd = 0; simd <= 1; ++simd) {
+        for (size_t j = 0; j < jobs.size(); ++j)
+            jobs[j].out = lanesOut.data() + j * (n + 1);
+        S4Lanes::Decode(jobs.data(), int(jobs.size()), simd != 0);
+        for (size_t j = 0; j < jobs.size(); ++j) {
+            if (SampleCRC32(jobs[j].out, n) != golden[index[j]].decodedCRC)
+                fail(golden[index[j]], simd ? "S4Lanes::Decode" : "S4Lanes::Decode scalar");
+        }
+    }
+
+    // S4Lanes::EncodeErrors: the S4 candidates, LANES at a time, by noise shape.
+    for (size_t j = 0; j < index.size();) {
+        const int shape = golden[index[j]].noiseShape;
+        S4Candidate cands[S4Lanes::LANES];
+        int nCands = 0;
+        size_t first = j;
+        while (j < index.size() && nCands < S4Lanes::LANES && golden[index[j]].noiseShape == shape) {
+            cands[nCands].table = S4ADPCM::getTable(golden[index[j]].table);
+            cands[nCands].predictor = golden[index[j]].predictor;
+            ++nCands;
+            ++j;
+        }
+        for (int simd = 0; simd <= 1; ++simd) {
+            int32_t errors[S4Lanes::LANES];
+            S4Lanes::EncodeErrors(samples, n, cands, nCands, ErrorMetric::MSE, shape, errors, simd != 0);
+            for (int c = 0; c < nCands; ++c) {
+                if (errors[c] != golden[index[first + c]].error)
+                    fail(golden[index[first + c]], simd ? "S4Lanes::EncodeErrors" : "S4Lanes::EncodeErrors scalar");
+            }
+        }
+    }
+    return failures;
+}
+
+void Golden::PrintTable()
+{
+    std::vector<int16_t> samples(N_SAMPLES);
+    std::vector<GoldenVector> vectors;
+    printf("const GoldenVector GOLDEN[Golden::N_SIGNALS][N_VECTORS] = {\n");
+    for (int s = 0; s < N_SIGNALS; ++s) {
+        Signal(s, samples.data());
+        Compute(samples.data(), N_SAMPLES, &vectors);
+        printf("    {   // %s\n", SIGNAL_NAMES[s]);
+        for (const GoldenVector& v : vectors) {
+            // The enum is the name in upper case.
+            std::string codec = MemUnit::CodecName(v.codec);
+            for (char& c : codec)
+                c = char(toupper(c));
+            printf("        { MemUnit::CODEC_%s, %d, %d, %2d, 0x%08x, 0x%08x, %d },\n",
+                codec.c_str(), v.table, v.predictor, v.noiseShape, v.compressedCRC, v.decodedCRC, v.error);
+        }
+        printf("    },\n");
+    }
+    printf("};\n");
+}
+
+// The samples of a WAV as they are, whatever the rate and channels, to an even count.
+static bool ReadSamples(const std::string& path, std::vector<int16_t>* samples)
+{
+    PcmFile pcm = PcmFile::Read(path);
+    if (pcm.error) {
+        printf("Failed to read: %s\n", path.c_str());
+        return false;
+    }
+    *samples = std::move(pcm.samples);
+    samples->resize(samples->size() & ~size_t(1));
+    return true;
+}
+
+int Golden::WriteFile(const char* path, const std::vector<std::string>& wavs)
+{
+    FILE* fp = fopen(path, "w");
+    if (!fp) {
+        printf("Failed to open: %s\n", path);
+        return 1;
+    }
+    std::vector<int16_t> samples;
+    std::vector<GoldenVector> vectors;
+    for (const std::string& wav : wavs) {
+        if (!ReadSamples(wav, &samples)) {
+            fclose(fp);
+            return 1;
+        }
+        Compute(samples.data(), int(samples.size()), &vectors);
+        fprintf(fp, "file %s\n", wav.c_str());
+        for (const GoldenVector& v : vectors) {
+            fprintf(fp, "%d %d %d %d %08x %08x %d\n",
+                v.codec, v.table, v.predictor, v.noiseShape, v.compressedCRC, v.decodedCRC, v.error);
+        }
+    }
+    fclose(fp);
+    printf("Wrote golden vectors of %d files to %s\n", int(wavs.size()), path);
+    return 0;
+}
+
+int Golden::CheckFile(const char* path)
+{
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        printf("Failed to open: %s\n", path);
+        return 1;
+    }
+    // Each "file" line is followed by its vectors.
+    std::vector<std::pair<std::string, std::vector<GoldenVector>>> files;
+    char line[1024];
+    while (fgets(line, sizeof(line), fp)) {
+        GoldenVector v;
+        if (strncmp(line, "file ", 5) == 0) {
+            std::string name = line + 5;
+            while (!name.empty() && (name.back() == '\n' || name.back() == '\r'))
+                name.pop_back();
+            files.push_back(std::make_pair(name, std::vector<GoldenVector>()));
+        }
+        else if (!files.empty() && sscanf(line, "%d %d %d %d %x %x %d", &v.codec, &v.table, &v.predictor, &v.noiseShape,
+            &v.compressedCRC, &v.decodedCRC, &v.error) == 7) {
+            files.back().second.push_back(v);
+        }
+    }
+    fclose(fp);
+
+    int failures = 0;
+    std::vector<int16_t> samples;
+    for (const auto& f : files) {
+        if (!ReadSamples(f.first, &samples))
+            return 1;
+        failures += Check(samples.data(), int(samples.size()), f.second.data(), int(f.second.size()), f.first.c_str());
+    }
+    printf("Checked %d files: %d mismatches\n", int(files.size()), failures);
+    return failures ? 1 : 0;
+}
+
+bool Golden::Test()
+{
+    std::vector<int16_t> samples(N_SAMPLES);
+    for (int s = 0; s < N_SIGNALS; ++s) {
+        Signal(s, samples.data());
+        TEST(Check(samples.data(), N_SAMPLES, GOLDEN[s], N_VECTORS, SIGNAL_NAMES[s]) == 0);
+    }
+    return true;
+}
+
+
+// From 'wav12 golden'. Regenerate only when the format changes on purpose.
+const GoldenVector GOLDEN[Golden::N_SIGNALS][N_VECTORS] = {
+    {   // sine
+        { MemUnit::CODEC_S4, 0, 0,  0, 0x0fc37b5c, 0xa6c1c831, 76835 },
+        { MemUnit::CODEC_S4, 0, 1,  0, 0xe0f409e6, 0x0b34bf9a, 57598 },
+        { MemUnit::CODEC_S4, 0, 2,  0, 0xd6627b58, 0x4a1caac8, 38320 },
+        { MemUnit::CODEC_S4, 0, 3,  0, 0x4bbdac9e, 0x5c43be96, 32494 },
+        { MemUnit::CODEC_S4, 0, 4,  0, 0xab5a1103, 0xba70ee35, 34039 },
+        { MemUnit::CODEC_S4, 1, 0,  0, 0xbd28c997, 0x28063e2d, 66077 },
+        { MemUnit::CODEC_S4, 1, 1,  0, 0x3e259588, 0x2fcd621c, 62566 },
+        { MemUnit::CODEC_S4, 1, 2,  0, 0x45330877, 0x574b7424, 36820 },
+        { MemUnit::CODEC_S4, 1, 3,  0, 0xb4cd1e2b, 0x88fffff7, 57807 },
+        { MemUnit::CODEC_S4, 1, 4,  0, 0x78bd528b, 0x0f61ffc6, 61375 },
+        { MemUnit::CODEC_S4, 2, 0,  0, 0xd0ef87bc, 0x4960d9e0, 140790 },
+        { MemUnit::CODEC_S4, 2, 1,  0, 0x2139119b, 0x03d4f674, 134654 },
+        { MemUnit::CODEC_S4, 2, 2,  0, 0x654d5316, 0x8e110171, 112253 },
+        { MemUnit::CODEC_S4, 2, 3,  0, 0x4cf39bc8, 0x5d3c2436, 98494 },
+        { MemUnit::CODEC_S4, 2, 4,  0, 0xdfb93cf0, 0x5c4d5f16, 92553 },
+        { MemUnit::CODEC_S4, 3, 0,  0, 0xe7c5fc92, 0x4960d9e0, 140790 },
+        { MemUnit::CODEC_S4, 3, 1,  0, 0xc95226de, 0x3d4e4740, 134404 },
+        { MemUnit::CODEC_S4, 3, 2,  0, 0x2569fe8a, 0x17c315a7, 112682 },
+        { MemUnit::CODEC_S4, 3, 3,  0, 0x6d180241, 0x1c5f9ea0, 98731 },
+        { MemUnit::CODEC_S4, 3, 4,  0, 0x6245d005, 0x1f096214, 93335 },
+        { MemUnit::CODEC_S4, 4, 0,  0, 0x8da3d41c, 0xa0904946, 48423 },
+        { MemUnit::CODEC_S4, 4, 1,  0, 0xf991e8d6, 0x6a46e2a9, 48180 },
+        { MemUnit::CODEC_S4, 4, 2,  0, 0x114b180d, 0xa39afda1, 35534 },
+        { MemUnit::CODEC_S4, 4, 3,  0, 0x2796de24, 0x92aa9c8d, 32399 },
+        { MemUnit::CODEC_S4, 4, 4,  0, 0x59b65afe, 0x5e7814ff, 35603 },
+        { MemUnit::CODEC_S4, 5, 0,  0, 0xe7a490f1, 0xb1865a4f, 41540 },
+        { MemUnit::CODEC_S4, 5, 1,  0, 0x2baf8cb2, 0xba5be4e0, 47746 },
+        { MemUnit::CODEC_S4, 5, 2,  0, 0x62e50f96, 0x5fbfde01, 38474 },
+        { MemUnit::CODEC_S4, 5, 3,  0, 0xe2dd8a05, 0x7525c789, 37118 },
+        { MemUnit::CODEC_S4, 5, 4,  0, 0xbe9905e3, 0x6b3f895c, 34843 },
+        { MemUnit::CODEC_S4, 0, 2, -3, 0xc9b50c89, 0xa0b11e0c, 53230 },
+        { MemUnit::CODEC_S4, 0, 2,  3, 0xaefe0a0f, 0xb7702604, 77835 },
+        { MemUnit::CODEC_S3, 0, 0,  0, 0xac2c76a2, 0x07d175fa, 166444 },
+        { MemUnit::CODEC_S3, 0, 1,  0, 0x58390491, 0xfffaefe8, 113013 },
+        { MemUnit::CODEC_S3, 0, 2,  0, 0xa5cdf0b9, 0x720d122f, 82815 },
+        { MemUnit::CODEC_S3, 0, 3,  0, 0xfb2a2349, 0xb9de39b0, 103178 },
+        { MemUnit::CODEC_S3, 0, 4,  0, 0xdef48780, 0xb63e2bbd, 81942 },
+        { MemUnit::CODEC_S3, 1, 0,  0, 0x011476f7, 0x102669e3, 229629 },
+        { MemUnit::CODEC_S3, 1, 1,  0, 0xf67a5ba3, 0xfc402c38, 190220 },
+        { MemUnit::CODEC_S3, 1, 2,  0, 0x8b2bc366, 0xd69e7987, 111220 },
+        { MemUnit::CODEC_S3, 1, 3,  0, 0x532ab258, 0xb1f65907, 138688 },
+        { MemUnit::CODEC_S3, 1, 4,  0, 0x7fcde17c, 0x45502d3c, 124347 },
+        { MemUnit::CODEC_S3, 2, 0,  0, 0xea6dd303, 0xb0079f5f, 180689 },
+        { MemUnit::CODEC_S3, 2, 1,  0, 0x57cc97c1, 0xbb3e66f9, 147032 },
+        { MemUnit::CODEC_S3, 2, 2,  0, 0x1021ee3c, 0x7d673617, 152191 },
+        { MemUnit::CODEC_S3, 2, 3,  0, 0x5cafd43e, 0x00255515, 184989 },
+        { MemUnit::CODEC_S3, 2, 4,  0, 0xeeb533ab, 0xca4f1c71, 119689 },
+        { MemUnit::CODEC_S2, 0, 0,  0, 0xa2f53dc7, 0x8a36975c, 817747 },
+        { MemUnit::CODEC_S2, 0, 1,  0, 0x8106979a, 0xccdb5dd8, 873715 },
+        { MemUnit::CODEC_S2, 0, 2,  0, 0xf9037c64, 0x4749c276, 740658 },
+        { MemUnit::CODEC_S2, 0, 3,  0, 0x6400760e, 0x83ea0f42, 548098 },
+        { MemUnit::CODEC_S2, 0, 4,  0, 0xd8955abc, 0x03dccaa6, 406115 },
+        { MemUnit::CODEC_S2, 1, 0,  0, 0x02003a62, 0xb7cfe378, 3084755 },
+        { MemUnit::CODEC_S2, 1, 1,  0, 0xd433d5cb, 0x4d25e9b8, 2656386 },
+        { MemUnit::CODEC_S2, 1, 2,  0, 0xe3356a43, 0xb0bc296c, 10927986 },
+        { MemUnit::CODEC_S2, 1, 3,  0, 0x16490907, 0x5f49957c, 12677240 },
+        { MemUnit::CODEC_S2, 1, 4,  0, 0x25fe091f, 0x132ee8d7, 27091987 },
+        { MemUnit::CODEC_S2, 2, 0,  0, 0x1adcf750, 0xa97bc980, 5817850 },
+        { MemUnit::CODEC_S2, 2, 1,  0, 0xc199a6f0, 0x0697e54a, 5416835 },
+        { MemUnit::CODEC_S2, 2, 2,  0, 0x5176027a, 0xedca9915, 5206548 },
+        { MemUnit::CODEC_S2, 2, 3,  0, 0x53feb3a1, 0xe00dc6f2, 96332751 },
+        { MemUnit::CODEC_S2, 2, 4,  0, 0x115c243a, 0x74c6144f, 87799175 },
+        { MemUnit::CODEC_IMA, 0, 0,  0, 0xc01c48f8, 0x24ad5d64, 122849 },
+    },
+    {   // chirp
+        { MemUnit::CODEC_S4, 0, 0,  0, 0x1a432383, 0x64066b8c, 518374 },
+        { MemUnit::CODEC_S4, 0, 1,  0, 0x59529e4e, 0xe696eecb, 503617 },
+        { MemUnit::CODEC_S4, 0, 2,  0, 0xd820bb3b, 0xc0d0fc79, 493200 },
+        { MemUnit::CODEC_S4, 0, 3,  0, 0xb9ebed05, 0x3a716755, 485738 },
+        { MemUnit::CODEC_S4, 0, 4,  0, 0xba2b7f4a, 0x43bb7bf7, 2812913 },
+        { MemUnit::CODEC_S4, 1, 0,  0, 0x73d30c43, 0x142314fe, 522091 },
+        { MemUnit::CODEC_S4, 1, 1,  0, 0x03c53172, 0x2faee14d, 475534 },
+        { MemUnit::CODEC_S4, 1, 2,  0, 0x2bbe71c4, 0x8955f4e0, 490208 },
+        { MemUnit::CODEC_S4, 1, 3,  0, 0x5808f472, 0xb0345542, 733013 },
+        { MemUnit::CODEC_S4, 1, 4,  0, 0xa07fbe9f, 0x7940752e, 16000406 },
+        { MemUnit::CODEC_S4, 2, 0,  0, 0xbac0f712, 0x8c6fb5aa, 520688 },
+        { MemUnit::CODEC_S4, 2, 1,  0, 0x8e278e69, 0xeec22382, 463223 },
+        { MemUnit::CODEC_S4, 2, 2,  0, 0xa522c801, 0x4d46ba1b, 460707 },
+        { MemUnit::CODEC_S4, 2, 3,  0, 0x0103a239, 0x652fd8b4, 470051 },
+        { MemUnit::CODEC_S4, 2, 4,  0, 0x1161b8a1, 0x639a62a5, 8006615 },
+        { MemUnit::CODEC_S4, 3, 0,  0, 0x22d6ccaf, 0x8d0dc947, 778842 },
+        { MemUnit::CODEC_S4, 3, 1,  0, 0x9a11294d, 0xc6c0dc03, 710153 },
+        { MemUnit::CODEC_S4, 3, 2,  0, 0x3b3dee18, 0xe1cc9f42, 704405 },
+        { MemUnit::CODEC_S4, 3, 3,  0, 0x5444b2d0, 0x59e05ec2, 691320 },
+        { MemUnit::CODEC_S4, 3, 4,  0, 0xc4ebc1ea, 0xb8831ff7, 9997131 },
+        { MemUnit::CODEC_S4, 4, 0,  0, 0xa2a1d200, 0x7ee68892, 520338 },
+        { MemUnit::CODEC_S4, 4, 1,  0, 0x4a4d4797, 0x8de5edf8, 465489 },
+        { MemUnit::CODEC_S4, 4, 2,  0, 0x07821bb5, 0x7f3d5454, 467338 },
+        { MemUnit::CODEC_S4, 4, 3,  0, 0x1018e707, 0xf6b94ef5, 480975 },
+        { MemUnit::CODEC_S4, 4, 4,  0, 0x7efa2fda, 0xaee3fc1c, 2525366 },
+        { MemUnit::CODEC_S4, 5, 0,  0, 0xa57484a5, 0xffb337ae, 373155 },
+        { MemUnit::CODEC_S4, 5, 1,  0, 0x612cc119, 0x8261d8d9, 330497 },
+        { MemUnit::CODEC_S4, 5, 2,  0, 0x437d49f4, 0x5f0f0086, 341117 },
+        { MemUnit::CODEC_S4, 5, 3,  0, 0x4f848043, 0x9349d1dc, 449362 },
+        { MemUnit::CODEC_S4, 5, 4,  0, 0xa399cf1b, 0x3b53d452, 3831716 },
+        { MemUnit::CODEC_S4, 0, 2, -3, 0x29e529f0, 0xfe88e7f9, 591228 },
+        { MemUnit::CODEC_S4, 0, 2,  3, 0x4ebd4131, 0xc726514b, 550077 },
+        { MemUnit::CODEC_S3, 0, 0,  0, 0xa3e8f682, 0x2734deee, 1180073 },
+        { MemUnit::CODEC_S3, 0, 1,  0, 0xa3c0852c, 0x389a2930, 1022714 },
+        { MemUnit::CODEC_S3, 0, 2,  0, 0xd2488d06, 0x8596ec42, 943136 },
+        { MemUnit::CODEC_S3, 0, 3,  0, 0x5ea96b9f, 0xe42e4e3d, 1401661 },
+        { MemUnit::CODEC_S3, 0, 4,  0, 0x7fdb732c, 0x374b0c5f, 13945990 },
+        { MemUnit::CODEC_S3, 1, 0,  0, 0xe3a31155, 0xe1483e71, 2065224 },
+        { MemUnit::CODEC_S3, 1, 1,  0, 0x06d7b7bb, 0xb37cdeab, 1499855 },
+        { MemUnit::CODEC_S3, 1, 2,  0, 0xf7872feb, 0x3aaa0967, 1152465 },
+        { MemUnit::CODEC_S3, 1, 3,  0, 0xf4486612, 0xb3faf87c, 1220774 },
+        { MemUnit::CODEC_S3, 1, 4,  0, 0xecb8a51d, 0xb8456bd8, 5409083 },
+        { MemUnit::CODEC_S3, 2, 0,  0, 0x6a80cf51, 0x5c3606e3, 1172561 },
+        { MemUnit::CODEC_S3, 2, 1,  0, 0x9ed944ef, 0x236fdfef, 1006129 },
+        { MemUnit::CODEC_S3, 2, 2,  0, 0x5172b5dd, 0xaffb0247, 1077023 },
+        { MemUnit::CODEC_S3, 2, 3,  0, 0xd4d1d2e9, 0xfa17300c, 2148350 },
+        { MemUnit::CODEC_S3, 2, 4,  0, 0x54d3ff63, 0x6f183d1b, 90850400 },
+        { MemUnit::CODEC_S2, 0, 0,  0, 0xdda50786, 0xb09482e1, 2268167 },
+        { MemUnit::CODEC_S2, 0, 1,  0, 0x7c9988c3, 0xaaa4a241, 2461738 },
+        { MemUnit::CODEC_S2, 0, 2,  0, 0x33b119ab, 0x044cba38, 2716626 },
+        { MemUnit::CODEC_S2, 0, 3,  0, 0x48311d98, 0xcc8dcf97, 4217469 },
+        { MemUnit::CODEC_S2, 0, 4,  0, 0xdbbdc002, 0xa40f2ac7, 33030040 },
+        { MemUnit::CODEC_S2, 1, 0,  0, 0xc3c68b9c, 0xb269c056, 6555536 },
+        { MemUnit::CODEC_S2, 1, 1,  0, 0x6dcddc51, 0x8b5f5ce5, 10292877 },
+        { MemUnit::CODEC_S2, 1, 2,  0, 0xb6c3aebe, 0x62416fc6, 12356858 },
+        { MemUnit::CODEC_S2, 1, 3,  0, 0x2f7cdb28, 0xb33385d3, 15867490 },
+        { MemUnit::CODEC_S2, 1, 4,  0, 0xad6c81ce, 0xd31b946f, 26964572 },
+        { MemUnit::CODEC_S2, 2, 0,  0, 0x10d7f787, 0xc3861708, 9694836 },
+        { MemUnit::CODEC_S2, 2, 1,  0, 0x945f1ed0, 0x97ba1a62, 10485412 },
+        { MemUnit::CODEC_S2, 2, 2,  0, 0xba0dbfb2, 0xc4a904bf, 17005394 },
+        { MemUnit::CODEC_S2, 2, 3,  0, 0xf30492b3, 0x27148159, 79176182 },
+        { MemUnit::CODEC_S2, 2, 4,  0, 0x2ee996d9, 0x94f0945e, 89366512 },
+        { MemUnit::CODEC_IMA, 0, 0,  0, 0x523ccd1e, 0x6c883c84, 698326 },
+    },
+    {   // noise
+        { MemUnit::CODEC_S4, 0, 0,  0, 0x186489ff, 0x29730cf1, 14076189 },
+        { MemUnit::CODEC_S4, 0, 1,  0, 0x30cf231d, 0xb7848401, 17218274 },
+        { MemUnit::CODEC_S4, 0, 2,  0, 0xee4732bf, 0xcb419f6d, 18961335 },
+        { MemUnit::CODEC_S4, 0, 3,  0, 0x1f571b9e, 0xc550ef34, 23608384 },
+        { MemUnit::CODEC_S4, 0, 4,  0, 0x749c0557, 0xa88b6d83, 28304552 },
+        { MemUnit::CODEC_S4, 1, 0,  0, 0xa046ec90, 0x13e368c3, 22207644 },
+        { MemUnit::CODEC_S4, 1, 1,  0, 0x3aef7c04, 0x2f0d3388, 23743549 },
+        { MemUnit::CODEC_S4, 1, 2,  0, 0xeb84429b, 0x2de4f916, 27055569 },
+        { MemUnit::CODEC_S4, 1, 3,  0, 0x8ff5dc33, 0xb9b6db9e, 33045177 },
+        { MemUnit::CODEC_S4, 1, 4,  0, 0x0a872e2e, 0x71f12208, 39377701 },
+        { MemUnit::CODEC_S4, 2, 0,  0, 0x22524639, 0x01b10b81, 11874143 },
+        { MemUnit::CODEC_S4, 2, 1,  0, 0xcda57063, 0x2198b785, 14823238 },
+        { MemUnit::CODEC_S4, 2, 2,  0, 0x3740a970, 0x252c7e3f, 17830449 },
+        { MemUnit::CODEC_S4, 2, 3,  0, 0x7012e41d, 0x05f86b64, 22468266 },
+        { MemUnit::CODEC_S4, 2, 4,  0, 0x9925893b, 0xcad791a0, 29523967 },
+        { MemUnit::CODEC_S4, 3, 0,  0, 0xe3395bfb, 0x278cb038, 12411453 },
+        { MemUnit::CODEC_S4, 3, 1,  0, 0x93135726, 0x92372bcf, 14755883 },
+        { MemUnit::CODEC_S4, 3, 2,  0, 0x055697e2, 0xbfcdafd4, 18667402 },
+        { MemUnit::CODEC_S4, 3, 3,  0, 0x67d3ca17, 0x4e730c59, 23998784 },
+        { MemUnit::CODEC_S4, 3, 4,  0, 0x21f8af15, 0xff03b383, 30138788 },
+        { MemUnit::CODEC_S4, 4, 0,  0, 0x63be07a3, 0x2266b390, 12358776 },
+        { MemUnit::CODEC_S4, 4, 1,  0, 0x475c7bfd, 0xb6afee66, 15247102 },
+        { MemUnit::CODEC_S4, 4, 2,  0, 0x3a68aae4, 0xd63cf9df, 18538766 },
+        { MemUnit::CODEC_S4, 4, 3,  0, 0x88b9a0b3, 0x6d967913, 24044156 },
+        { MemUnit::CODEC_S4, 4, 4,  0, 0x7a955617, 0x5d42222b, 29945669 },
+        { MemUnit::CODEC_S4, 5, 0,  0, 0x845c33f9, 0x0510e383, 15106574 },
+        { MemUnit::CODEC_S4, 5, 1,  0, 0x48b8fc2d, 0x0591b624, 17239751 },
+        { MemUnit::CODEC_S4, 5, 2,  0, 0xe98c5815, 0xf645c43b, 20640857 },
+        { MemUnit::CODEC_S4, 5, 3,  0, 0x0ccb0ba8, 0x806e1207, 23456705 },
+        { MemUnit::CODEC_S4, 5, 4,  0, 0xc2707343, 0x57a89873, 28903989 },
+        { MemUnit::CODEC_S4, 0, 2, -3, 0xf252bae9, 0xd32816e9, 28542339 },
+        { MemUnit::CODEC_S4, 0, 2,  3, 0xa1d23acd, 0xabb21a17, 28754184 },
+        { MemUnit::CODEC_S3, 0, 0,  0, 0x2478a286, 0xc548889b, 42157803 },
+        { MemUnit::CODEC_S3, 0, 1,  0, 0x7a1a5931, 0x0e15d559, 54189166 },
+        { MemUnit::CODEC_S3, 0, 2,  0, 0xa21dd2ad, 0x901b7484, 64133635 },
+        { MemUnit::CODEC_S3, 0, 3,  0, 0xfa5e7599, 0xcf956c77, 74839550 },
+        { MemUnit::CODEC_S3, 0, 4,  0, 0x4db796e9, 0x4236e231, 92707384 },
+        { MemUnit::CODEC_S3, 1, 0,  0, 0x60a7d1b1, 0xde1d557e, 54458260 },
+        { MemUnit::CODEC_S3, 1, 1,  0, 0xe99c4813, 0x8a9df62c, 58282072 },
+        { MemUnit::CODEC_S3, 1, 2,  0, 0xc7ae8867, 0x8abe390b, 67346453 },
+        { MemUnit::CODEC_S3, 1, 3,  0, 0xc5347f4a, 0x30d7ca21, 79977279 },
+        { MemUnit::CODEC_S3, 1, 4,  0, 0xab717264, 0xbd9863ac, 94747786 },
+        { MemUnit::CODEC_S3, 2, 0,  0, 0x74f5e381, 0x4553c7c2, 63445187 },
+        { MemUnit::CODEC_S3, 2, 1,  0, 0xca520428, 0xced1a76d, 69374244 },
+        { MemUnit::CODEC_S3, 2, 2,  0, 0x21d8a6a3, 0xf5bf6da4, 80401387 },
+        { MemUnit::CODEC_S3, 2, 3,  0, 0x7b404846, 0xf225192b, 103995254 },
+        { MemUnit::CODEC_S3, 2, 4,  0, 0xb62436dc, 0x3d788450, 115048832 },
+        { MemUnit::CODEC_S2, 0, 0,  0, 0xe1c28722, 0x4c8fc4e2, 141814596 },
+        { MemUnit::CODEC_S2, 0, 1,  0, 0x72647854, 0xb465827e, 156107736 },
+        { MemUnit::CODEC_S2, 0, 2,  0, 0xc81b2a5c, 0x0adabe99, 185153030 },
+        { MemUnit::CODEC_S2, 0, 3,  0, 0x76df2bad, 0xfd81bded, 234775727 },
+        { MemUnit::CODEC_S2, 0, 4,  0, 0x008c508f, 0xdc166f52, 321079844 },
+        { MemUnit::CODEC_S2, 1, 0,  0, 0xa380187f, 0x4714d7c9, 135041886 },
+        { MemUnit::CODEC_S2, 1, 1,  0, 0xe9290fb9, 0x2d2ed2d8, 161457941 },
+        { MemUnit::CODEC_S2, 1, 2,  0, 0xc5c0ca90, 0x52117e79, 191373829 },
+        { MemUnit::CODEC_S2, 1, 3,  0, 0xf870cf20, 0x207a7152, 242065312 },
+        { MemUnit::CODEC_S2, 1, 4,  0, 0x1318295c, 0x157ccb23, 303752550 },
+        { MemUnit::CODEC_S2, 2, 0,  0, 0x4a72d6f8, 0x2c3873c5, 87173735 },
+        { MemUnit::CODEC_S2, 2, 1,  0, 0x9603029c, 0xdb987d37, 96514471 },
+        { MemUnit::CODEC_S2, 2, 2,  0, 0x21b3640e, 0x9a21fdc8, 119273987 },
+        { MemUnit::CODEC_S2, 2, 3,  0, 0xf9951392, 0xe4fd5337, 160768325 },
+        { MemUnit::CODEC_S2, 2, 4,  0, 0xaa3d36d7, 0xd2f52546, 218233740 },
+        { MemUnit::CODEC_IMA, 0, 0,  0, 0x3d1b68d8, 0x0c3c199c, 9291492 },
+    },
+    {   // square
+        { MemUnit::CODEC_S4, 0, 0,  0, 0x77d49168, 0x9e69dc02, 406996697 },
+        { MemUnit::CODEC_S4, 0, 1,  0, 0x04a09179, 0xe8778ee0, 99069649 },
+        { MemUnit::CODEC_S4, 0, 2,  0, 0xa85d7a70, 0xb7eb87bd, 398988062 },
+        { MemUnit::CODEC_S4, 0, 3,  0, 0xbde7e702, 0x5165f145, 394788476 },
+        { MemUnit::CODEC_S4, 0, 4,  0, 0x2bc1d136, 0xe5811953, 199486392 },
+        { MemUnit::CODEC_S4, 1, 0,  0, 0x2d91ad77, 0x1fb4de71, 406852836 },
+        { MemUnit::CODEC_S4, 1, 1,  0, 0x5e80f672, 0x27ca57dc, 403092280 },
+        { MemUnit::CODEC_S4, 1, 2,  0, 0xe171f012, 0x52177816, 398993937 },
+        { MemUnit::CODEC_S4, 1, 3,  0, 0x9b118d58, 0x25616a3d, 394660468 },
+        { MemUnit::CODEC_S4, 1, 4,  0, 0x1a8d1b47, 0x7634914b, 390309343 },
+        { MemUnit::CODEC_S4, 2, 0,  0, 0xa53d42db, 0x859e9113, 564583781 },
+        { MemUnit::CODEC_S4, 2, 1,  0, 0xaa6fe07c, 0x545ab7da, 48906249 },
+        { MemUnit::CODEC_S4, 2, 2,  0, 0x39aa4f00, 0x01337da2, 545538203 },
+        { MemUnit::CODEC_S4, 2, 3,  0, 0x880910c0, 0xac5da26a, 533179032 },
+        { MemUnit::CODEC_S4, 2, 4,  0, 0xee186576, 0x1a0e89f2, 343896838 },
+        { MemUnit::CODEC_S4, 3, 0,  0, 0x196972ab, 0xff05a108, 724223836 },
+        { MemUnit::CODEC_S4, 3, 1,  0, 0xf1d43eb2, 0xbb3b695e, 51078353 },
+        { MemUnit::CODEC_S4, 3, 2,  0, 0x19c40cfa, 0x8c098027, 692988605 },
+        { MemUnit::CODEC_S4, 3, 3,  0, 0x7b37f63b, 0x0304ec50, 672413969 },
+        { MemUnit::CODEC_S4, 3, 4,  0, 0x24711ad9, 0xa232dc50, 293202810 },
+        { MemUnit::CODEC_S4, 4, 0,  0, 0x77d49168, 0x9e69dc02, 406996697 },
+        { MemUnit::CODEC_S4, 4, 1,  0, 0x04a09179, 0xe8778ee0, 99069649 },
+        { MemUnit::CODEC_S4, 4, 2,  0, 0xa85d7a70, 0xb7eb87bd, 398988062 },
+        { MemUnit::CODEC_S4, 4, 3,  0, 0x37f0334f, 0x5165f145, 394788476 },
+        { MemUnit::CODEC_S4, 4, 4,  0, 0x2bc1d136, 0xe5811953, 199486392 },
+        { MemUnit::CODEC_S4, 5, 0,  0, 0xba6dd8d3, 0x68ed19cd, 254771936 },
+        { MemUnit::CODEC_S4, 5, 1,  0, 0x3240e38b, 0x1b15c734, 254545526 },
+        { MemUnit::CODEC_S4, 5, 2,  0, 0x55ee924b, 0xc129a382, 254534045 },
+        { MemUnit::CODEC_S4, 5, 3,  0, 0x7bcc15b3, 0xc79ae3f0, 255575789 },
+        { MemUnit::CODEC_S4, 5, 4,  0, 0xd4a3fd5b, 0x81d36e3b, 254560931 },
+        { MemUnit::CODEC_S4, 0, 2, -3, 0x6f42ec7f, 0x6b27f419, 399762841 },
+        { MemUnit::CODEC_S4, 0, 2,  3, 0xa85d7a70, 0xb7eb87bd, 398988062 },
+        { MemUnit::CODEC_S3, 0, 0,  0, 0x0071a536, 0x3b525f99, 610797427 },
+        { MemUnit::CODEC_S3, 0, 1,  0, 0xff5a65e2, 0xdba3462e, 251338517 },
+        { MemUnit::CODEC_S3, 0, 2,  0, 0x94276005, 0x6df70261, 478151097 },
+        { MemUnit::CODEC_S3, 0, 3,  0, 0xffdf28f0, 0x30c76dd6, 541715505 },
+        { MemUnit::CODEC_S3, 0, 4,  0, 0xed4fcb11, 0xb45ae375, 356000269 },
+        { MemUnit::CODEC_S3, 1, 0,  0, 0x0071a536, 0x3b525f99, 610797427 },
+        { MemUnit::CODEC_S3, 1, 1,  0, 0x0965d29b, 0x14c42d60, 251338517 },
+        { MemUnit::CODEC_S3, 1, 2,  0, 0x94276005, 0x6df70261, 478151097 },
+        { MemUnit::CODEC_S3, 1, 3,  0, 0x5711909f, 0x9dfced50, 541716603 },
+        { MemUnit::CODEC_S3, 1, 4,  0, 0x5e47420f, 0x25cdee71, 158863412 },
+        { MemUnit::CODEC_S3, 2, 0,  0, 0x8682f936, 0x61abd37a, 610797427 },
+        { MemUnit::CODEC_S3, 2, 1,  0, 0x45c90950, 0x2db4b83c, 605092365 },
+        { MemUnit::CODEC_S3, 2, 2,  0, 0xd131a2b2, 0x4a494d97, 592893589 },
+        { MemUnit::CODEC_S3, 2, 3,  0, 0xab78d0c9, 0x02bab8c9, 580128628 },
+        { MemUnit::CODEC_S3, 2, 4,  0, 0xb8caa554, 0x519f1676, 567261609 },
+        { MemUnit::CODEC_S2, 0, 0,  0, 0xfeca9a57, 0x0439c391, 911330321 },
+        { MemUnit::CODEC_S2, 0, 1,  0, 0x08547e87, 0x87944610, 896755115 },
+        { MemUnit::CODEC_S2, 0, 2,  0, 0x496fd023, 0xffdeacd6, 879259353 },
+        { MemUnit::CODEC_S2, 0, 3,  0, 0xdca5b0f4, 0x008d33ef, 860162632 },
+        { MemUnit::CODEC_S2, 0, 4,  0, 0x5754a999, 0xab3b6a02, 834566081 },
+        { MemUnit::CODEC_S2, 1, 0,  0, 0xe5337fc6, 0x7feb2bf4, 496384085 },
+        { MemUnit::CODEC_S2, 1, 1,  0, 0xf287d48f, 0xccdd1c5a, 498280359 },
+        { MemUnit::CODEC_S2, 1, 2,  0, 0x7f9583de, 0x795013fb, 492258189 },
+        { MemUnit::CODEC_S2, 1, 3,  0, 0xe2d6fbea, 0xe154beaa, 222876132 },
+        { MemUnit::CODEC_S2, 1, 4,  0, 0xe03ca366, 0xb47baf51, 201744151 },
+        { MemUnit::CODEC_S2, 2, 0,  0, 0xba44b919, 0xfa10b283, 71035861 },
+        { MemUnit::CODEC_S2, 2, 1,  0, 0x01e841a5, 0xcf3e40f0, 31435388 },
+        { MemUnit::CODEC_S2, 2, 2,  0, 0x5eaecd91, 0x7187da47, 69061913 },
+        { MemUnit::CODEC_S2, 2, 3,  0, 0xaee99dfa, 0x845152d6, 57462194 },
+        { MemUnit::CODEC_S2, 2, 4,  0, 0xec2d3e41, 0xeca8dc3f, 57548902 },
+        { MemUnit::CODEC_IMA, 0, 0,  0, 0x62408f69, 0xa204182a, 322371220 },
+    },
+    {   // impulse
+        { MemUnit::CODEC_S4, 0, 0,  0, 0x4ea9e1ea, 0xc5417eb0, 789104 },
+        { MemUnit::CODEC_S4, 0, 1,  0, 0xf6a6ba50, 0xe9132b42, 873266 },
+        { MemUnit::CODEC_S4, 0, 2,  0, 0x73d7c2d8, 0x63a58c80, 964567 },
+        { MemUnit::CODEC_S4, 0, 3,  0, 0x4e500699, 0xf8c4f829, 921732 },
+        { MemUnit::CODEC_S4, 0, 4,  0, 0xb5d1ee39, 0x265dc43b, 1016193 },
+        { MemUnit::CODEC_S4, 1, 0,  0, 0xe83ef64b, 0x041d64a4, 919549 },
+        { MemUnit::CODEC_S4, 1, 1,  0, 0xf2b25d0c, 0x6c8ab087, 967087 },
+        { MemUnit::CODEC_S4, 1, 2,  0, 0x91dfc4c8, 0x288f7c86, 1016895 },
+        { MemUnit::CODEC_S4, 1, 3,  0, 0x871c84b3, 0x1b6cb814, 1105765 },
+        { MemUnit::CODEC_S4, 1, 4,  0, 0x99d83b1b, 0x76951a6c, 1153118 },
+        { MemUnit::CODEC_S4, 2, 0,  0, 0x4fab41fb, 0x50192fcd, 871511 },
+        { MemUnit::CODEC_S4, 2, 1,  0, 0x6d44d85d, 0x7378be91, 885265 },
+        { MemUnit::CODEC_S4, 2, 2,  0, 0xbb4bf096, 0x82a9bc15, 974842 },
+        { MemUnit::CODEC_S4, 2, 3,  0, 0x93a35912, 0xac191f21, 1021065 },
+        { MemUnit::CODEC_S4, 2, 4,  0, 0x410dd435, 0xa70b8782, 1083261 },
+        { MemUnit::CODEC_S4, 3, 0,  0, 0xc8944a9a, 0xb56b49bc, 1041132 },
+        { MemUnit::CODEC_S4, 3, 1,  0, 0x32bf2293, 0x67a5fbec, 1071681 },
+        { MemUnit::CODEC_S4, 3, 2,  0, 0xdafbb24a, 0x927f5250, 1163200 },
+        { MemUnit::CODEC_S4, 3, 3,  0, 0xca68bd94, 0x27c9af82, 1144228 },
+        { MemUnit::CODEC_S4, 3, 4,  0, 0x5f531088, 0xa287cb26, 1523758 },
+        { MemUnit::CODEC_S4, 4, 0,  0, 0x2f587b7b, 0x63453005, 780258 },
+        { MemUnit::CODEC_S4, 4, 1,  0, 0xd4ef80c6, 0xad5eb260, 813596 },
+        { MemUnit::CODEC_S4, 4, 2,  0, 0xf5a4f4e6, 0x3dac7545, 912738 },
+        { MemUnit::CODEC_S4, 4, 3,  0, 0x6153f289, 0xc920b2f5, 915969 },
+        { MemUnit::CODEC_S4, 4, 4,  0, 0x55f907fc, 0xd23c754d, 1011396 },
+        { MemUnit::CODEC_S4, 5, 0,  0, 0xac9d1384, 0xa367b310, 664440 },
+        { MemUnit::CODEC_S4, 5, 1,  0, 0x6d2f006f, 0x0f16298e, 687249 },
+        { MemUnit::CODEC_S4, 5, 2,  0, 0x8a18bfd6, 0x7698b8f2, 742045 },
+        { MemUnit::CODEC_S4, 5, 3,  0, 0x7a58a00b, 0xa84d99f3, 758540 },
+        { MemUnit::CODEC_S4, 5, 4,  0, 0xae987ec2, 0x32bdf109, 927739 },
+        { MemUnit::CODEC_S4, 0, 2, -3, 0x74362ea3, 0x6c852997, 1157734 },
+        { MemUnit::CODEC_S4, 0, 2,  3, 0xaf976f09, 0xd01475ff, 1041670 },
+        { MemUnit::CODEC_S3, 0, 0,  0, 0x4171f7a6, 0x47a0562a, 1268021 },
+        { MemUnit::CODEC_S3, 0, 1,  0, 0xb6d33259, 0x85a8415f, 1511522 },
+        { MemUnit::CODEC_S3, 0, 2,  0, 0xebc9f85b, 0xa9a25115, 1501469 },
+        { MemUnit::CODEC_S3, 0, 3,  0, 0x453cfae0, 0xcd8ca3ad, 1508764 },
+        { MemUnit::CODEC_S3, 0, 4,  0, 0xc1484673, 0x59fdc323, 1922747 },
+        { MemUnit::CODEC_S3, 1, 0,  0, 0x7dcf6e26, 0x05fcacee, 1492251 },
+        { MemUnit::CODEC_S3, 1, 1,  0, 0x1c49081f, 0xed332f06, 1559033 },
+        { MemUnit::CODEC_S3, 1, 2,  0, 0x652e1e6a, 0x9bd130ac, 1746933 },
+        { MemUnit::CODEC_S3, 1, 3,  0, 0xf30962fd, 0xc12362a7, 2273017 },
+        { MemUnit::CODEC_S3, 1, 4,  0, 0x8648ccc3, 0x298e6764, 2789943 },
+        { MemUnit::CODEC_S3, 2, 0,  0, 0xc3deaeb8, 0xdce0e76b, 1663279 },
+        { MemUnit::CODEC_S3, 2, 1,  0, 0xf5ca249c, 0x489c8a75, 1919344 },
+        { MemUnit::CODEC_S3, 2, 2,  0, 0x7561db6b, 0x1c7e1305, 2067364 },
+        { MemUnit::CODEC_S3, 2, 3,  0, 0x30f40997, 0x4d68de39, 2238016 },
+        { MemUnit::CODEC_S3, 2, 4,  0, 0x5e45488a, 0xaba6c5f9, 2178049 },
+        { MemUnit::CODEC_S2, 0, 0,  0, 0xe13f22d5, 0xafb750a7, 2581358 },
+        { MemUnit::CODEC_S2, 0, 1,  0, 0xc52cd94f, 0x5cc4c4f3, 2909040 },
+        { MemUnit::CODEC_S2, 0, 2,  0, 0x7a51b705, 0xa105ed79, 3142057 },
+        { MemUnit::CODEC_S2, 0, 3,  0, 0x48a908e1, 0xf4fa9446, 3457187 },
+        { MemUnit::CODEC_S2, 0, 4,  0, 0x3f952d60, 0xfb81f8c3, 4442737 },
+        { MemUnit::CODEC_S2, 1, 0,  0, 0xb5d8b4b0, 0x07877c10, 2669528 },
+        { MemUnit::CODEC_S2, 1, 1,  0, 0xb8d3b1d8, 0x2231d8fb, 3069740 },
+        { MemUnit::CODEC_S2, 1, 2,  0, 0x63899af2, 0x6256b059, 3364017 },
+        { MemUnit::CODEC_S2, 1, 3,  0, 0xbd049ae8, 0x9b38a0da, 4670745 },
+        { MemUnit::CODEC_S2, 1, 4,  0, 0x19eea4ac, 0x5471aa98, 44592303 },
+        { MemUnit::CODEC_S2, 2, 0,  0, 0x78ffcaae, 0xba88746d, 68486539 },
+        { MemUnit::CODEC_S2, 2, 1,  0, 0xaa6919c8, 0xcf5cfb0a, 54431786 },
+        { MemUnit::CODEC_S2, 2, 2,  0, 0x1ee539c7, 0xc30f16b7, 57647372 },
+        { MemUnit::CODEC_S2, 2, 3,  0, 0xcaa15faa, 0xc8695ce1, 84695898 },
+        { MemUnit::CODEC_S2, 2, 4,  0, 0x7c0f6829, 0x237a1427, 68388501 },
+        { MemUnit::CODEC_IMA, 0, 0,  0, 0xd663778e, 0xb1433088, 927624 },
+    },
+    {   // hum
+        { MemUnit::CODEC_S4, 0, 0,  0, 0x14d49592, 0xd3bd5703, 20025 },
+        { MemUnit::CODEC_S4, 0, 1,  0, 0xa81fbb8c, 0x39b4e757, 19812 },
+        { MemUnit::CODEC_S4, 0, 2,  0, 0xc4f5e708, 0xa4e3c4be, 19630 },
+        { MemUnit::CODEC_S4, 0, 3,  0, 0x2c847cf0, 0xd3d3bddc, 19354 },
+        { MemUnit::CODEC_S4, 0, 4,  0, 0xaf6a4f38, 0xbacfc84a, 19087 },
+        { MemUnit::CODEC_S4, 1, 0,  0, 0x37d3924e, 0x9ebbd72e, 20031 },
+        { MemUnit::CODEC_S4, 1, 1,  0, 0xb6fd921e, 0xc8af4065, 19820 },
+        { MemUnit::CODEC_S4, 1, 2,  0, 0xc4e3751c, 0x369041f4, 19653 },
+        { MemUnit::CODEC_S4, 1, 3,  0, 0x0fe79593, 0x5e2fc7e4, 19357 },
+        { MemUnit::CODEC_S4, 1, 4,  0, 0x9dcd704f, 0xe442590a, 19341 },
+        { MemUnit::CODEC_S4, 2, 0,  0, 0x99c8d287, 0xea41bde2, 20021 },
+        { MemUnit::CODEC_S4, 2, 1,  0, 0x94f171cc, 0x79039ce0, 19805 },
+        { MemUnit::CODEC_S4, 2, 2,  0, 0xbc2890e7, 0xe0a0f6ca, 19623 },
+        { MemUnit::CODEC_S4, 2, 3,  0, 0x64670e04, 0xf50950c2, 19347 },
+        { MemUnit::CODEC_S4, 2, 4,  0, 0xf1c4587f, 0x902973bc, 19320 },
+        { MemUnit::CODEC_S4, 3, 0,  0, 0x6bd3f131, 0x52c8a0f8, 31802 },
+        { MemUnit::CODEC_S4, 3, 1,  0, 0xe3c2d371, 0xf8c287cc, 30963 },
+        { MemUnit::CODEC_S4, 3, 2,  0, 0x2b2fd0d6, 0x7dc1b775, 29948 },
+        { MemUnit::CODEC_S4, 3, 3,  0, 0xf52ede49, 0x0f0e7e53, 28787 },
+        { MemUnit::CODEC_S4, 3, 4,  0, 0xa1c7332e, 0x21507dca, 27579 },
+        { MemUnit::CODEC_S4, 4, 0,  0, 0x96936ae4, 0xb06f54d1, 20023 },
+        { MemUnit::CODEC_S4, 4, 1,  0, 0xbf4b4336, 0x8f8391e8, 19804 },
+        { MemUnit::CODEC_S4, 4, 2,  0, 0xb2f823b0, 0xa1a8c68b, 19625 },
+        { MemUnit::CODEC_S4, 4, 3,  0, 0x31d5a670, 0x35a00870, 19349 },
+        { MemUnit::CODEC_S4, 4, 4,  0, 0x4a1e693c, 0xbdf65d50, 19323 },
+        { MemUnit::CODEC_S4, 5, 0,  0, 0x686d49bc, 0x5455496b, 11871 },
+        { MemUnit::CODEC_S4, 5, 1,  0, 0x4ad3acf5, 0xb89b7e96, 12184 },
+        { MemUnit::CODEC_S4, 5, 2,  0, 0x52d150a1, 0x980ca067, 12939 },
+        { MemUnit::CODEC_S4, 5, 3,  0, 0x774a9f9d, 0x871e7281, 12089 },
+        { MemUnit::CODEC_S4, 5, 4,  0, 0x0dfe20d5, 0xd0998738, 11798 },
+        { MemUnit::CODEC_S4, 0, 2, -3, 0xdaf9d70d, 0xcc8f4760, 19659 },
+        { MemUnit::CODEC_S4, 0, 2,  3, 0xb5e57c07, 0x1fe0a861, 28438 },
+        { MemUnit::CODEC_S3, 0, 0,  0, 0x2401a139, 0x367bf18e, 36845 },
+        { MemUnit::CODEC_S3, 0, 1,  0, 0xdfc9cf2a, 0xf509c663, 36030 },
+        { MemUnit::CODEC_S3, 0, 2,  0, 0xbcd660cd, 0xaeba55e9, 34926 },
+        { MemUnit::CODEC_S3, 0, 3,  0, 0x0f3b6cbe, 0x6485f96f, 33704 },
+        { MemUnit::CODEC_S3, 0, 4,  0, 0xbea92efd, 0x86714444, 32373 },
+        { MemUnit::CODEC_S3, 1, 0,  0, 0x9d05ae66, 0x7b47e56f, 37311 },
+        { MemUnit::CODEC_S3, 1, 1,  0, 0x53ca152c, 0xbcb86add, 36184 },
+        { MemUnit::CODEC_S3, 1, 2,  0, 0x2a102237, 0xfcdbb938, 35046 },
+        { MemUnit::CODEC_S3, 1, 3,  0, 0x1532dc52, 0x727180d7, 33862 },
+        { MemUnit::CODEC_S3, 1, 4,  0, 0xfa77edc2, 0xd5843045, 32716 },
+        { MemUnit::CODEC_S3, 2, 0,  0, 0xb2cab0bd, 0xa3f87bd3, 36894 },
+        { MemUnit::CODEC_S3, 2, 1,  0, 0x644ea4c5, 0x984c3997, 36099 },
+        { MemUnit::CODEC_S3, 2, 2,  0, 0xc7768479, 0x4a9e64e3, 35022 },
+        { MemUnit::CODEC_S3, 2, 3,  0, 0x9aaa1d77, 0xd2b1bde4, 33791 },
+        { MemUnit::CODEC_S3, 2, 4,  0, 0xa394fb93, 0x6fc82b2f, 32423 },
+        { MemUnit::CODEC_S2, 0, 0,  0, 0x1a5bd79c, 0x2d2494d5, 45177 },
+        { MemUnit::CODEC_S2, 0, 1,  0, 0xee5f614d, 0xb0a857be, 43818 },
+        { MemUnit::CODEC_S2, 0, 2,  0, 0x6b5033cb, 0xbf181ce3, 42519 },
+        { MemUnit::CODEC_S2, 0, 3,  0, 0x17c423b6, 0xb68de276, 41229 },
+        { MemUnit::CODEC_S2, 0, 4,  0, 0x70bfef31, 0x84856c00, 39867 },
+        { MemUnit::CODEC_S2, 1, 0,  0, 0xc6df9fab, 0xa1511276, 37152 },
+        { MemUnit::CODEC_S2, 1, 1,  0, 0xd8289eb5, 0x09259890, 77955 },
+        { MemUnit::CODEC_S2, 1, 2,  0, 0xd01639f2, 0xaee09bf3, 116734 },
+        { MemUnit::CODEC_S2, 1, 3,  0, 0xa39a0f2a, 0x02295de8, 243449 },
+        { MemUnit::CODEC_S2, 1, 4,  0, 0x2b07347a, 0x5ced3f9f, 62214904 },
+        { MemUnit::CODEC_S2, 2, 0,  0, 0xffb5aae8, 0x20a5ce7b, 392933 },
+        { MemUnit::CODEC_S2, 2, 1,  0, 0x3bb83b09, 0xc3cfb38b, 344021 },
+        { MemUnit::CODEC_S2, 2, 2,  0, 0xb2365c3a, 0xde91de05, 363454 },
+        { MemUnit::CODEC_S2, 2, 3,  0, 0x26e64528, 0x2dd79464, 22203826 },
+        { MemUnit::CODEC_S2, 2, 4,  0, 0x36afa25f, 0x65abfa01, 64239203 },
+        { MemUnit::CODEC_IMA, 0, 0,  0, 0x21ebd534, 0x4a8d1d3b, 30952 },
+    },
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// One codec setting over one input: CRC32s of the compressed bytes and
+// of the decoded 16 bit samples, and the MSE of the decode.
+struct GoldenVector {
+    int codec;          // MemUnit::CODEC_*
+    int table;
+    int predictor;
+    int noiseShape;     // S4 only
+    uint32_t compressedCRC;
+    uint32_t decodedCRC;
+    int32_t error;
+};
+
+/*
+    Conformance of the bitstream: every table and predictor of S4 (and of
+    S3 and S2, and IMA) run over a fixed corpus of synthetic signals, with
+    the results pinned in golden.cpp. Test() checks the encoders and every
+    decoder (decode4, decodeN, the expanders, S4Lanes with and without
+    SIMD, and S4Lanes::EncodeErrors) against them, so any rewrite of a
+    kernel has to be bit exact.
+
+    The corpus is integer only (no libm), so it is the same everywhere.
+    The CRCs are of little endian data. Real sounds can't live in the
+    repo; WriteFile() and CheckFile() keep golden vectors for them locally.
+*/
+class Golden
+{
+public:
+    static const int N_SIGNALS = 6;
+    static const int N_SAMPLES = 4000;
+    static const char* SignalName(int signal);
+    static void Signal(int signal, int16_t* samples);   // N_SAMPLES
+
+    // The settings in a fixed order, from the reference encoders and decoders.
+    static void Compute(const int16_t* samples, int nSamples, std::vector<GoldenVector>* vectors,
+        std::vector<std::vector<uint8_t>>* streams = 0);
+    // Runs every kernel over the samples, and compares with 'golden'.
+    // Prints the mismatches and returns how many.
+    static int Check(const int16_t* samples, int nSamples, const GoldenVector* golden, int nGolden, const char* name);
+
+    // Prints the corpus' vectors as the source of the table in golden.cpp.
+    // Only for a deliberate change to the format.
+    static void PrintTable();
+    // Golden vectors of WAV files, in a text file: write them once, check
+    // after a change. Return 0 on success.
+    static int WriteFile(const char* path, const std::vector<std::string>& wavs);
+    static int CheckFile(const char* path);
+
+    static bool Test();
+};
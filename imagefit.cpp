@@ -0,0 +1,229 @@
+#include "imagefit.h"
+#include "preprocess.h"
+#include "./wav12util/manifest.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#define TEST(x) { if (!(x)) { assert(false); return false; }}
+
+namespace {
+    // Trailing samples at or below these levels are candidates for trimming.
+    const int TRIM_LEVEL[] = { 32, 128, 512 };
+    // Looping sounds can be shortened to these fractions (out of 8).
+    const int LOOP_FRACTION[] = { 6, 4 };
+
+    int64_t energy(const int16_t* s, int n)
+    {
+        int64_t e = 0;
+        for (int i = 0; i < n; ++i)
+            e += int64_t(s[i]) * int64_t(s[i]);
+        return e;
+    }
+
+    FitChoice makeChoice(const FitItem& item, int kind, int nSamples, int64_t tradeError)
+    {
+        FitChoice c;
+        c.kind = kind;
+        c.nSamples = nSamples;
+        c.bytes = int((int64_t(nSamples) * MemUnit::CodecBits(item.codec) + 7) / 8);
+        c.cost = (int64_t(item.aveError2) * nSamples + tradeError) * item.priority;
+        return c;
+    }
+}
+
+const char* ImageFit::KindName(int kind)
+{
+    switch (kind) {
+    case FitChoice::FULL: return "full";
+    case FitChoice::TRIM: return "trimmed";
+    case FitChoice::LOOP: return "shorter loop";
+    case FitChoice::DROP: return "dropped";
+    }
+    return "?";
+}
+
+std::vector<FitChoice> ImageFit::Options(const FitItem& item)
+{
+    std::vector<FitChoice> options;
+    options.push_back(makeChoice(item, FitChoice::FULL, item.nSamples, 0));
+
+    if (item.looping) {
+        for (int frac : LOOP_FRACTION) {
+            int n = (item.nSamples * frac / 8) & ~1;
+            if (n < 2) continue;
+            // When the shorter loop plays, the time it covers from the
+            // original sound is replaced by its own start.
+            int64_t e = 0;
+            for (int i = n; i < item.nSamples; ++i) {
+                int64_t d = int64_t(item.samples[i]) - int64_t(item.samples[i % n]);
+                e += d * d;
+            }
+            options.push_back(makeChoice(item, FitChoice::LOOP, n, e));
+        }
+    }
+    else {
+        int prevN = item.nSamples;
+        for (int level : TRIM_LEVEL) {
+            int n = item.nSamples - Preprocess::TrailingSilence(item.samples, item.nSamples, level);
+            n = (n + 1) & ~1;
+            // A file that is all quiet isn't trimmed away; only optional files are dropped.
+            if (n < 2 || n >= prevN) continue;
+            prevN = n;
+            options.push_back(makeChoice(item, FitChoice::TRIM, n, energy(item.samples + n, item.nSamples - n)));
+        }
+    }
+    if (item.optional) {
+        options.push_back(makeChoice(item, FitChoice::DROP, 0, energy(item.samples, item.nSamples)));
+    }
+    return options;
+}
+
+bool ImageFit::Fit(const std::vector<FitItem>& items, int64_t budget, std::vector<FitChoice>* choices)
+{
+    std::vector<std::vector<FitChoice>> options;
+    for (const FitItem& item : items)
+        options.push_back(Options(item));
+    return Fit(options, budget, choices);
+}
+
+bool ImageFit::Fit(const std::vector<std::vector<FitChoice>>& options, int64_t budget, std::vector<FitChoice>* choices)
+{
+    int64_t total = 0;
+    choices->clear();
+    for (const std::vector<FitChoice>& opts : options) {
+        choices->push_back(opts[0]);
+        total += choices->back().bytes;
+    }
+
+    // Greedy: take the step that costs the least error per byte saved.
+    // Steps can skip options, so a cheap big step isn't hidden behind an
+    // expensive small one.
+    while (total > budget) {
+        int bestItem = -1;
+        int bestOption = -1;
+        double bestSlope = 0;
+        for (size_t i = 0; i < options.size(); ++i) {
+            const FitChoice& cur = (*choices)[i];
+            for (size_t j = 0; j < options[i].size(); ++j) {
+                const FitChoice& opt = options[i][j];
+                if (opt.bytes >= cur.bytes) continue;
+                double slope = double(opt.cost - cur.cost) / double(cur.bytes - opt.bytes);
+                if (bestItem < 0 || slope < bestSlope) {
+                    bestItem = int(i);
+                    bestOption = int(j);
+                    bestSlope = slope;
+                }
+            }
+        }
+        if (bestItem < 0)
+            return false;
+
+        total -= (*choices)[bestItem].bytes - options[bestItem][bestOption].bytes;
+        (*choices)[bestItem] = options[bestItem][bestOption];
+    }
+
+    // The steps are coarse, so there is often room left over. Give it
+    // back where it buys the most error.
+    for (;;) {
+        int bestItem = -1;
+        int bestOption = -1;
+        int64_t bestGain = 0;
+        for (size_t i = 0; i < options.size(); ++i) {
+            const FitChoice& cur = (*choices)[i];
+            for (size_t j = 0; j < options[i].size(); ++j) {
+                const FitChoice& opt = options[i][j];
+                int64_t gain = cur.cost - opt.cost;
+                if (gain > bestGain && total - cur.bytes + opt.bytes <= budget) {
+                    bestItem = int(i);
+                    bestOption = int(j);
+                    bestGain = gain;
+                }
+            }
+        }
+        if (bestItem < 0)
+            break;
+        total += options[bestItem][bestOption].bytes - (*choices)[bestItem].bytes;
+        (*choices)[bestItem] = options[bestItem][bestOption];
+    }
+    return true;
+}
+
+bool ImageFit::Test()
+{
+    static const int N = 1000;
+    int16_t loud[N];
+    int16_t tail[N];
+    for (int i = 0; i < N; ++i) {
+        loud[i] = (i & 1) ? 10000 : -10000;
+        tail[i] = i < N / 2 ? loud[i] : 20;
+    }
+
+    FitItem a;
+    a.samples = loud;
+    a.nSamples = N;
+    a.aveError2 = 100;
+
+    FitItem b = a;
+    b.samples = tail;
+
+    FitItem c = a;
+    c.optional = true;
+    c.priority = 2;
+
+    std::vector<FitItem> items = { a, b, c };
+    std::vector<FitChoice> choices;
+
+    // Everything fits.
+    TEST(ImageFit::Fit(items, 3 * N / 2, &choices));
+    TEST(choices[0].kind == FitChoice::FULL && choices[1].kind == FitChoice::FULL && choices[2].kind == FitChoice::FULL);
+
+    // The quiet tail goes first.
+    TEST(ImageFit::Fit(items, 3 * N / 2 - 100, &choices));
+    TEST(choices[0].kind == FitChoice::FULL);
+    TEST(choices[1].kind == FitChoice::TRIM && choices[1].nSamples == N / 2);
+    TEST(choices[2].kind == FitChoice::FULL);
+
+    // Then the optional file has to go...
+    TEST(ImageFit::Fit(items, N - 100, &choices));
+    TEST(choices[0].kind == FitChoice::FULL);
+    TEST(choices[1].kind == FitChoice::TRIM);
+    TEST(choices[2].kind == FitChoice::DROP && choices[2].bytes == 0);
+
+    // ...which leaves enough room to not trim.
+    TEST(ImageFit::Fit(items, N, &choices));
+    TEST(choices[1].kind == FitChoice::FULL);
+    TEST(choices[2].kind == FitChoice::DROP);
+
+    // And it can't always be done.
+    TEST(!ImageFit::Fit(items, N / 4, &choices));
+
+    // Looping sounds get shorter, not trimmed.
+    FitItem loop = b;
+    loop.looping = true;
+    std::vector<FitChoice> options = ImageFit::Options(loop);
+    TEST(options.size() == 3);
+    TEST(options[1].kind == FitChoice::LOOP && options[1].nSamples == N * 6 / 8);
+
+    // Bytes are by the codec: 2 and 3 bit files are smaller.
+    FitItem s2 = b;
+    s2.codec = MemUnit::CODEC_S2;
+    options = ImageFit::Options(s2);
+    TEST(options[0].bytes == N / 4);
+    TEST(options[1].kind == FitChoice::TRIM && options[1].bytes == N / 8);
+    s2.codec = MemUnit::CODEC_S3;
+    TEST(ImageFit::Options(s2)[0].bytes == N * 3 / 8);
+
+    // All quiet: no trim leaves it empty, so it stays whole if it has to stay.
+    int16_t quiet[N];
+    for (int i = 0; i < N; ++i)
+        quiet[i] = int16_t((i * 7919) % 601 - 300);
+    FitItem q = a;
+    q.samples = quiet;
+    for (const FitChoice& o : ImageFit::Options(q))
+        TEST(o.nSamples > 0);
+    items = { a, q };
+    TEST(!ImageFit::Fit(items, N / 2, &choices));
+    TEST(choices[1].nSamples > 0);
+    return true;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// One file, as the fitter sees it.
+struct FitItem {
+    const int16_t* samples = 0;
+    int nSamples = 0;
+    int32_t aveError2 = 0;      // per sample error of the encoding, from compressGroup()
+    int codec = 0;              // MemUnit::CODEC_*, from compressGroup(); sets the bytes per sample
+    bool looping = false;
+    bool optional = false;      // can be dropped from the image
+    int priority = 1;           // scales the cost of degrading this file. 0 is "don't care".
+};
+
+// A way to store a file, and what it costs.
+struct FitChoice {
+    enum { FULL, TRIM, LOOP, DROP };
+
+    int kind = FULL;
+    int nSamples = 0;           // samples kept, from the start of the file
+    int bytes = 0;
+    int64_t cost = 0;           // estimated total squared error vs. the source, times priority
+};
+
+/*
+    Fits files in to a byte budget by trading away quality.
+
+    Each file has options: stored in full, trailing quiet trimmed (at a few
+    thresholds), a looping sound shortened, or (if optional) dropped. The
+    cost of an option is the encoding error, estimated from the per sample
+    error compressGroup() already computed, plus the error of the change
+    itself (the energy trimmed, the difference a shorter loop makes, or
+    the whole sound.) Options are taken greedily, cheapest error per byte
+    saved first, until everything fits.
+
+    Lowering the sample rate isn't an option: the image and the device
+    assume 22050 Hz.
+*/
+class ImageFit
+{
+public:
+    // The options for one item; the first is FULL, and the rest are smaller.
+    static std::vector<FitChoice> Options(const FitItem& item);
+
+    // Picks a choice per item. Returns false (and the smallest choices)
+    // if the items can't fit in 'budget' bytes.
+    static bool Fit(const std::vector<FitItem>& items, int64_t budget, std::vector<FitChoice>* choices);
+    // The same, from each item's Options(): the samples can be gone by now.
+    static bool Fit(const std::vector<std::vector<FitChoice>>& options, int64_t budget, std::vector<FitChoice>* choices);
+
+    static const char* KindName(int kind);
+    static bool Test();
+};
@@ -0,0 +1,137 @@
+#include "imagepatch.h"
+#include "wavutil.h"
+
+#include <assert.h>
+#include <string.h>
+
+#define TEST(x) { if (!(x)) { assert(false); return false; }}
+
+namespace {
+    void append(std::vector<uint8_t>* v, const void* data, size_t n)
+    {
+        const uint8_t* p = (const uint8_t*)data;
+        v->insert(v->end(), p, p + n);
+    }
+}
+
+void ImagePatch::Diff(const uint8_t* oldImage, uint32_t oldSize,
+                      const uint8_t* newImage, uint32_t newSize,
+                      std::vector<uint8_t>* patch)
+{
+    PatchHeader header;
+    header.magic = PatchHeader::MAGIC;
+    header.version = PatchHeader::VERSION;
+    header.oldSize = oldSize;
+    header.newSize = newSize;
+    header.oldCRC = crc32(oldImage, oldSize);
+    header.newCRC = crc32(newImage, newSize);
+    header.numRanges = 0;
+
+    patch->clear();
+    append(patch, &header, sizeof(header));
+
+    // Past the end of the old image, everything is different.
+    auto same = [&](uint32_t i) { return i < oldSize && oldImage[i] == newImage[i]; };
+
+    uint32_t i = 0;
+    while (i < newSize) {
+        if (same(i)) {
+            ++i;
+            continue;
+        }
+        uint32_t start = i;
+        uint32_t end = i;   // one past the last different byte
+        while (i < newSize) {
+            if (!same(i)) {
+                end = ++i;
+            }
+            else if (i - end >= MERGE_GAP) {
+                break;
+            }
+            else {
+                ++i;
+            }
+        }
+        uint32_t size = end - start;
+        append(patch, &start, 4);
+        append(patch, &size, 4);
+        append(patch, newImage + start, size);
+        header.numRanges++;
+    }
+    memcpy(patch->data(), &header, sizeof(header));
+}
+
+
+bool ImagePatch::Apply(const uint8_t* oldImage, uint32_t oldSize,
+                       const uint8_t* patch, uint32_t patchSize,
+                       std::vector<uint8_t>* newImage)
+{
+    PatchHeader header;
+    if (patchSize < sizeof(header))
+        return false;
+    memcpy(&header, patch, sizeof(header));
+    if (header.magic != PatchHeader::MAGIC || header.version != PatchHeader::VERSION)
+        return false;
+    if (header.oldSize != oldSize || header.oldCRC != crc32(oldImage, oldSize))
+        return false;
+
+    newImage->assign(header.newSize, 0);
+    memcpy(newImage->data(), oldImage, oldSize < header.newSize ? oldSize : header.newSize);
+
+    uint32_t pos = sizeof(header);
+    for (uint32_t r = 0; r < header.numRanges; ++r) {
+        uint32_t offset = 0, size = 0;
+        if (patchSize - pos < 8)
+            return false;
+        memcpy(&offset, patch + pos, 4);
+        memcpy(&size, patch + pos + 4, 4);
+        pos += 8;
+        if (size > patchSize - pos || offset > header.newSize || size > header.newSize - offset)
+            return false;
+        memcpy(newImage->data() + offset, patch + pos, size);
+        pos += size;
+    }
+    return pos == patchSize && crc32(newImage->data(), header.newSize) == header.newCRC;
+}
+
+
+bool ImagePatch::Test()
+{
+    std::vector<uint8_t> a(1000), b;
+    for (size_t i = 0; i < a.size(); ++i)
+        a[i] = uint8_t(i * 7);
+
+    // Identical: no ranges.
+    std::vector<uint8_t> patch, result;
+    Diff(a.data(), 1000, a.data(), 1000, &patch);
+    TEST(patch.size() == sizeof(PatchHeader));
+    TEST(Apply(a.data(), 1000, patch.data(), uint32_t(patch.size()), &result));
+    TEST(result == a);
+
+    // Two nearby changes merge, a far one doesn't, and the image grows.
+    b = a;
+    b[100] ^= 1;
+    b[105] ^= 1;
+    b[500] ^= 1;
+    b.push_back(1);
+    b.push_back(2);
+    Diff(a.data(), 1000, b.data(), 1002, &patch);
+    PatchHeader header;
+    memcpy(&header, patch.data(), sizeof(header));
+    TEST(header.numRanges == 3);
+    TEST(patch.size() == sizeof(PatchHeader) + 3 * 8 + 6 + 1 + 2);
+    TEST(Apply(a.data(), 1000, patch.data(), uint32_t(patch.size()), &result));
+    TEST(result == b);
+
+    // Shrinks.
+    Diff(b.data(), 1002, a.data(), 990, &patch);
+    TEST(Apply(b.data(), 1002, patch.data(), uint32_t(patch.size()), &result));
+    TEST(result.size() == 990 && memcmp(result.data(), a.data(), 990) == 0);
+
+    // Wrong base image, or damaged patch.
+    TEST(!Apply(a.data(), 1000, patch.data(), uint32_t(patch.size()), &result));
+    patch.back() ^= 1;
+    TEST(!Apply(b.data(), 1002, patch.data(), uint32_t(patch.size()), &result));
+    TEST(!Apply(b.data(), 1002, patch.data(), uint32_t(patch.size() - 1), &result));
+    return true;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+/*
+    A patch from one memory image to the next: the byte ranges of the new
+    image that differ from the old one. Uploading the patch instead of the
+    whole image is the point; build the new image with
+    MemImageUtil::setPrevious() so unchanged sounds don't move.
+
+    Format (little endian):
+        header      PatchHeader
+        ranges      { uint32_t offset; uint32_t size; uint8_t data[size]; } * numRanges
+    The CRCs (crc32 of the whole image) guard against patching the wrong
+    image, and confirm the result.
+*/
+struct PatchHeader {
+    static const uint32_t MAGIC = 0x50323157;   // "W12P"
+    static const uint32_t VERSION = 1;
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t oldSize;
+    uint32_t newSize;
+    uint32_t oldCRC;
+    uint32_t newCRC;
+    uint32_t numRanges;
+};
+
+class ImagePatch
+{
+public:
+    // Changed ranges closer than this are merged; a range costs 8 bytes.
+    static const uint32_t MERGE_GAP = 16;
+
+    static void Diff(const uint8_t* oldImage, uint32_t oldSize,
+                     const uint8_t* newImage, uint32_t newSize,
+                     std::vector<uint8_t>* patch);
+
+    // Returns false if 'patch' is damaged, isn't for 'oldImage', or the
+    // result doesn't check out.
+    static bool Apply(const uint8_t* oldImage, uint32_t oldSize,
+                      const uint8_t* patch, uint32_t patchSize,
+                      std::vector<uint8_t>* newImage);
+
+    static bool Test();
+};
@@ -1,8 +1,13 @@
 #include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <string>
+#include <algorithm>
+#include <map>
 
 #include "memimage.h"
+#include "imagepatch.h"
 #include "wavutil.h"
 
 extern "C" { 
@@ -14,125 +19,415 @@ extern "C" {
 
 MemImageUtil::MemImageUtil()
 {
-    dataVec = new uint8_t[MEMORY_SIZE];
-    image = (MemImage*)dataVec;
-    memset(dataVec, 0, MEMORY_SIZE);
-    memset(e12, 0, sizeof(e12[0]) * MemImage::NUM_FILES);
+    memset(desc, 0, sizeof(desc));
 }
 
 
 MemImageUtil::~MemImageUtil()
 {
-    delete[] dataVec;
 }
 
 
 void MemImageUtil::addDir(const char* name)
 {
-    assert(numDir < MemImage::NUM_DIR);
-    strncpy(image->unit[numDir].name, name, MemUnit::NAME_LEN);
-    image->unit[numDir].offset = MemImage::NUM_DIR + numFile;
-    numDir++;
+    assert(dirs.size() < 0xffff);
+    MemUnit dir;
+    memset(&dir, 0, sizeof(dir));
+    strncpy(dir.name, name, MemUnit::NAME_LEN);
+    dir.offset = uint32_t(files.size());
+    dirs.push_back(dir);
 }
 
 
-void MemImageUtil::addFile(const char* name, const void* data, int size, int table, int predictor, int32_t _e12)
+void MemImageUtil::addFile(const char* name, const void* data, int size, int table, int predictor, int32_t _e12, int codec)
 {   
-    assert(numDir > 0);
-    assert(numFile < MemImage::NUM_FILES);
-
-    image->unit[numDir-1].size += 1;
-    int index = MemImage::NUM_DIR + numFile;
-    strncpy(image->unit[index].name, name, MemUnit::NAME_LEN);
-    assert(addr + size <= MEMORY_SIZE);
-    if (addr + size > MEMORY_SIZE) {
-        printf("Too much memory used.\n");
-        printf("Adding file: %s\n", name);
-        printf("addr=%d size=%d of %d\n", addr, size, MEMORY_SIZE);
-        exit(1);
-    }
-    image->unit[index].offset = addr;
-    image->unit[index].size = size;
-    image->unit[index].table = table;
-    image->unit[index].predictor = predictor;
-    e12[numFile] = _e12;
-    memcpy(dataVec + addr, data, size);
-    addr += size;
-    numFile++;
-}
-
-
-void MemImageUtil::writePalette(int index, const MemPalette& palette)
+    assert(!dirs.empty());
+    assert(dirs.size() + files.size() < Manifest::MAX_UNITS);
+
+    dirs.back().size += 1;
+
+    MemUnit file;
+    memset(&file, 0, sizeof(file));
+    strncpy(file.name, name, MemUnit::NAME_LEN);
+    file.offset = uint32_t(heap.size());
+    file.size = size;
+    file.table = table;
+    file.predictor = predictor;
+    file.codec = uint8_t(codec);
+
+    // Sound fonts often share clips. If the same bytes are already in
+    // the heap, point at them instead of storing another copy.
+    const uint32_t h = hash32((const char*)data, (const char*)data + size);
+    bool dup = false;
+    auto range = content.equal_range(h);
+    for (auto it = range.first; it != range.second; ++it) {
+        const MemUnit& prev = files[it->second];
+        if (prev.size == file.size && memcmp(heap.data() + prev.offset, data, size) == 0) {
+            file.offset = prev.offset;
+            dup = true;
+            break;
+        }
+    }
+    if (dup) {
+        numDup++;
+        dupBytes += size;
+    }
+    else {
+        content.insert(std::make_pair(h, int(files.size())));
+        heap.insert(heap.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+    }
+    files.push_back(file);
+    e12.push_back(_e12);
+}
+
+
+void MemImageUtil::writePalette(int index, const MemPalette& _palette)
 {
     assert(index >= 0 && index < MemPalette::NUM_PALETTES);
-    memcpy(dataVec + Manifest::PaletteAddr(index), &palette, sizeof(palette));
+    palette[index] = _palette;
 }
 
 
-void MemImageUtil::writeDesc(const char* desc)
+void MemImageUtil::writeDesc(const char* _desc)
 {
-    size_t len = strlen(desc);
+    size_t len = strlen(_desc);
     if (len > MemImage::SIZE_DESC - 1)
         len = MemImage::SIZE_DESC - 1;
-    memset(dataVec + Manifest::DescAddr(), 0, MemImage::SIZE_DESC);
-    for (size_t i = 0; i < len; ++i)
-        *(dataVec + Manifest::DescAddr() + i) = desc[i];
+    memset(desc, 0, MemImage::SIZE_DESC);
+    memcpy(desc, _desc, len);
+}
+
+
+uint32_t MemImageUtil::imageSize() const
+{
+    std::vector<uint32_t> addr;
+    return layout(&addr);
+}
+
+
+void MemImageUtil::setPrevious(const uint8_t* data, uint32_t size)
+{
+    previous.assign(data, data + size);
+    previousContent.clear();
+
+    Manifest manifest;
+    if (!manifest.load(data, size))
+        return;
+    for (int i = manifest.numDir(); i < manifest.numUnits(); ++i) {
+        const MemUnit& unit = manifest.getUnit(i);
+        if (unit.size == 0)
+            continue;
+        const char* p = (const char*)data + unit.offset;
+        previousContent.insert(std::make_pair(hash32(p, p + unit.size), unit.offset));
+    }
+}
+
+
+uint32_t MemImageUtil::layout(std::vector<uint32_t>* addr) const
+{
+    const uint32_t base = dataAddr();
+    addr->assign(files.size(), 0);
+
+    if (previous.empty()) {
+        // Data in the order it was added.
+        for (size_t i = 0; i < files.size(); ++i)
+            (*addr)[i] = base + files[i].offset;
+        return base + uint32_t(heap.size());
+    }
+
+    // Keep data that is unchanged from the previous image where it was,
+    // so a patch between the two stays small. Everything else goes in
+    // the gaps, then at the end. Shared data is placed once.
+    std::map<uint32_t, uint32_t> used;          // start -> end, in the image
+    std::map<uint32_t, uint32_t> placed;        // heap offset -> image address
+    std::vector<size_t> unplaced;
+
+    auto overlaps = [&](uint32_t start, uint32_t end) {
+        auto it = used.lower_bound(start);
+        if (it != used.end() && it->first < end) return true;
+        if (it != used.begin() && (--it)->second > start) return true;
+        return false;
+    };
+
+    for (size_t i = 0; i < files.size(); ++i) {
+        const MemUnit& f = files[i];
+        if (f.size == 0 || placed.count(f.offset))
+            continue;
+        const uint8_t* p = heap.data() + f.offset;
+        bool pinned = false;
+        auto range = previousContent.equal_range(hash32((const char*)p, (const char*)p + f.size));
+        for (auto it = range.first; it != range.second && !pinned; ++it) {
+            uint32_t a = it->second;
+            if (a >= base && a + f.size <= previous.size()
+                && memcmp(previous.data() + a, p, f.size) == 0
+                && !overlaps(a, a + f.size))
+            {
+                used[a] = a + f.size;
+                placed[f.offset] = a;
+                pinned = true;
+            }
+        }
+        if (!pinned)
+            unplaced.push_back(i);
+    }
+
+    uint32_t end = base;
+    if (!used.empty())
+        end = std::max(end, used.rbegin()->second);
+
+    for (size_t i : unplaced) {
+        const MemUnit& f = files[i];
+        if (placed.count(f.offset))
+            continue;
+        // First fit.
+        uint32_t a = base;
+        for (const auto& u : used) {
+            if (a + f.size <= u.first)
+                break;
+            a = std::max(a, u.second);
+        }
+        used[a] = a + f.size;
+        placed[f.offset] = a;
+        end = std::max(end, a + f.size);
+    }
+
+    for (size_t i = 0; i < files.size(); ++i) {
+        auto it = placed.find(files[i].offset);
+        (*addr)[i] = it != placed.end() ? it->second : base;
+    }
+    return end;
+}
+
+
+const std::vector<uint8_t>& MemImageUtil::assemble()
+{
+    const uint32_t nDir = uint32_t(dirs.size());
+    std::vector<uint32_t> addr;
+    const uint32_t size = layout(&addr);
+
+    image.assign(size, 0);
+
+    MemImage header;
+    header.magic = MemImage::MAGIC;
+    header.version = MemImage::VERSION;
+    header.numDir = uint16_t(nDir);
+    header.numFile = uint32_t(files.size());
+    header.size = size;
+    memcpy(image.data(), &header, sizeof(header));
+    memcpy(image.data() + MemImage::DESC_ADDR, desc, MemImage::SIZE_DESC);
+    memcpy(image.data() + MemImage::PALETTE_ADDR, palette, MemImage::SIZE_PALETTE);
+
+    // Dirs point to the unit id of the first file, files to the image address.
+    MemUnit* unit = (MemUnit*)(image.data() + MemImage::UNIT_ADDR);
+    for (size_t i = 0; i < dirs.size(); ++i) {
+        unit[i] = dirs[i];
+        unit[i].offset += nDir;
+    }
+    for (size_t i = 0; i < files.size(); ++i) {
+        unit[nDir + i] = files[i];
+        unit[nDir + i].offset = addr[i];
+        if (files[i].size)
+            memcpy(image.data() + addr[i], heap.data() + files[i].offset, files[i].size);
+    }
+    return image;
 }
 
 
 void MemImageUtil::write(const char* name)
 {
-    assert(addr < MEMORY_SIZE);
+    assemble();
 
     FILE* fp = fopen(name, "wb");
-    fwrite(dataVec, addr, 1, fp);
+    fwrite(image.data(), image.size(), 1, fp);
     fclose(fp);
 }
 
-void MemImageUtil::writeText(const char* name)
+void MemImageUtil::writeText(const char* name, bool framed)
 {
-    assert(addr < MEMORY_SIZE);
+    assemble();
+    const int size = int(image.size());
+    std::string text;
+
+    if (framed) {
+        text = FramedText(image.data(), uint32_t(size));
+    }
+    else {
+        static const int STEP = TEXT_LINE_BYTES;
+        static const int LINE = (STEP + 2) / 3 * 4 + 1;
+
+        // Build the whole text in memory, and write it once.
+        text = std::to_string(size) + "\n";
+        size_t pos = text.size();
+        text.resize(pos + size_t(size / STEP + 1) * LINE);
+
+        for (int i = 0; i < size; i += STEP) {
+            int n = STEP;
+            if (i + STEP > size)
+                n = size - i;
+            encodeBase64(image.data() + i, n, &text[pos], false);
+            pos += (n + 2) / 3 * 4;
+            text[pos++] = '\n';
+        }
+        text.resize(pos);
+    }
+
     FILE* fp = fopen(name, "w");
+    fwrite(text.data(), text.size(), 1, fp);
+    fclose(fp);
+}
+
+/*
+    Framed text format:
+        W12T 1 <image size> <number of lines> <crc32 of image, hex>
+        <line> <crc32 of line bytes, hex> <base64 of up to 256 bytes>
+        ...
+    A line of all the same byte (common in the tables) is written as
+    '=' and the byte in hex instead of base64. The sound data itself is
+    ADPCM, and doesn't compress further.
+*/
+std::string MemImageUtil::FramedText(const uint8_t* data, uint32_t size)
+{
+    static const int STEP = TEXT_LINE_BYTES;
+    const int nLines = int((size + STEP - 1) / STEP);
+
+    char buf[64];
+    snprintf(buf, sizeof(buf), "W12T 1 %u %d %08x\n", size, nLines, crc32(data, size));
+    std::string text = buf;
+    text.reserve(text.size() + size_t(nLines) * ((STEP + 2) / 3 * 4 + 24));
+
+    char line[(STEP + 2) / 3 * 4 + 1];
+    for (int i = 0; i < nLines; ++i) {
+        const uint8_t* p = data + i * STEP;
+        const int n = std::min(STEP, int(size) - i * STEP);
+        snprintf(buf, sizeof(buf), "%d %08x ", i, crc32(p, n));
+        text += buf;
+
+        bool run = true;
+        for (int j = 1; j < n && run; ++j)
+            run = p[j] == p[0];
+        if (run) {
+            snprintf(buf, sizeof(buf), "=%02x", p[0]);
+            text += buf;
+        }
+        else {
+            encodeBase64(p, n, line, true);
+            text += line;
+        }
+        text += '\n';
+    }
+    return text;
+}
 
-    fprintf(fp, "%d\n", addr);
+bool MemImageUtil::ParseText(const char* text, size_t len, std::vector<uint8_t>* out, std::vector<int>* badLines)
+{
+    static const int STEP = TEXT_LINE_BYTES;
+    const char* end = text + len;
+    badLines->clear();
+    out->clear();
+
+    // Returns the next line (without the newline) or false at the end.
+    auto nextLine = [&](std::string* s) {
+        if (text >= end) return false;
+        const char* eol = text;
+        while (eol < end && *eol != '\n') ++eol;
+        s->assign(text, eol);
+        if (!s->empty() && s->back() == '\r') s->pop_back();
+        text = eol < end ? eol + 1 : end;
+        return true;
+    };
+
+    std::string s;
+    if (!nextLine(&s))
+        return false;
+
+    if (s.compare(0, 5, "W12T ") != 0) {
+        // Original format: the size, then lines of base64.
+        long size = strtol(s.c_str(), 0, 10);
+        // Every byte takes more than a char, so the text bounds the size.
+        if (size <= 0 || size_t(size) > len) return false;
+        out->resize(size);
+        for (long pos = 0; pos < size; pos += STEP) {
+            if (!nextLine(&s)) return false;
+            int n = int(std::min<long>(STEP, size - pos));
+            if (s.size() < size_t(base64Size(n))) return false;
+            decodeBase64(s.c_str(), n, out->data() + pos);
+        }
+        return true;
+    }
 
-    static const int STEP = 256;
-    char cBuf[STEP*2];
+    unsigned version = 0, size = 0, crc = 0;
+    int nLines = 0;
+    if (sscanf(s.c_str(), "W12T %u %u %d %x", &version, &size, &nLines, &crc) != 4
+        || version != 1
+        || nLines < 0
+        || nLines != int((uint64_t(size) + STEP - 1) / STEP)
+        || size_t(nLines) > len)    // a line per line of text, at most
+    {
+        return false;
+    }
+    out->assign(size, 0);
+    std::vector<bool> good(nLines, false);
+
+    while (nextLine(&s)) {
+        int seq = -1;
+        unsigned lineCRC = 0;
+        int offset = 0;
+        if (sscanf(s.c_str(), "%d %x %n", &seq, &lineCRC, &offset) != 2 || seq < 0 || seq >= nLines || offset == 0)
+            continue;
+
+        uint8_t* p = out->data() + seq * STEP;
+        const int n = std::min(STEP, int(size) - seq * STEP);
+        const char* payload = s.c_str() + offset;
+        if (*payload == '=') {
+            memset(p, int(strtol(payload + 1, 0, 16)), n);
+        }
+        else {
+            if (strlen(payload) < size_t(base64Size(n)))
+                continue;
+            decodeBase64(payload, n, p);
+        }
+        good[seq] = crc32(p, n) == lineCRC;
+    }
 
-    for (int i = 0; i < addr; i += STEP) {
-        int n = STEP;
-        if (i + STEP > addr)
-            n = addr - i;
-        encodeBase64(dataVec + i, n, cBuf, true);
-        fprintf(fp, "%s\n", cBuf);
+    for (int i = 0; i < nLines; ++i) {
+        if (!good[i])
+            badLines->push_back(i);
     }
-    fclose(fp);
+    return badLines->empty() && crc32(out->data(), size) == crc;
 }
 
 void MemImageUtil::dumpConsole()
 {
     uint32_t totalSize = 0;
+    std::vector<uint32_t> addr;
+    const uint32_t size = layout(&addr);
     
-    for (int d = 0; d < MemImage::NUM_DIR; ++d) {
+    for (size_t d = 0; d < dirs.size(); ++d) {
         uint32_t dirTotal = 0;
 
-        if (image->unit[d].name[0]) {
+        if (dirs[d].name[0]) {
             char dirName[9] = { 0 };
-            strncpy(dirName, image->unit[d].name, 8);
+            strncpy(dirName, dirs[d].name, 8);
             printf("Dir: %s\n", dirName);
 
-            for (unsigned f = 0; f < image->unit[d].size; ++f) {
-                int index = image->unit[d].offset + f;
-                const MemUnit& fileUnit = image->unit[index];
+            for (unsigned f = 0; f < dirs[d].size; ++f) {
+                int index = dirs[d].offset + f;
+                const MemUnit& fileUnit = files[index];
                 char fileName[9] = { 0 };
                 strncpy(fileName, fileUnit.name, 8);
+                // Shared if an earlier file has the same offset.
+                bool shared = false;
+                for (int i = 0; i < index && !shared; ++i)
+                    shared = files[i].offset == fileUnit.offset && files[i].size;
 
-                printf("   %8s at %8d size=%6d (%3dk) table=%2d predictor=%2d ave-err=%7.1f\n",
+                printf("   %8s at %8d size=%6d (%3dk) %-3s table=%2d predictor=%2d ave-err=%7.1f%s\n",
                     fileName,
-                    fileUnit.offset, fileUnit.size, fileUnit.size / 1024,
+                    addr[index], fileUnit.size, fileUnit.size / 1024,
+                    MemUnit::CodecName(fileUnit.codec),
                     fileUnit.table,
                     fileUnit.predictor,
-                    sqrtf((float)e12[index - MemImage::NUM_DIR]));
+                    sqrtf((float)e12[index]),
+                    shared ? " (shared)" : "");
 
                 totalSize += fileUnit.size;
                 dirTotal += fileUnit.size;
@@ -142,9 +437,6 @@ void MemImageUtil::dumpConsole()
             printf("  Dir total=%dk\n", dirTotal / 1024);
     }
 
-    MemPalette palette[MemPalette::NUM_PALETTES];
-    memcpy(palette, dataVec + Manifest::PaletteAddr(0), sizeof(MemPalette) * MemPalette::NUM_PALETTES);
-
     for (int i = 0; i < MemPalette::NUM_PALETTES; ++i) {
         printf("  %d font=%d bc=%02x%02x%02x ic=%02x%02x%02x\n",
             i,
@@ -152,19 +444,19 @@ void MemImageUtil::dumpConsole()
             palette[i].bladeColor.r, palette[i].bladeColor.g, palette[i].bladeColor.b,
             palette[i].impactColor.r, palette[i].impactColor.g, palette[i].impactColor.b);
     }
-    printf("Description=%s\n", (const char*)(dataVec + Manifest::DescAddr()));
+    printf("Description=%s\n", desc);
 
-    size_t totalImageSize = sizeof(MemImage) + addr;
+    size_t totalImageSize = size;
     printf("Image size=%d bytes, %d k\n", int(totalImageSize), int(totalImageSize / 1024));
+    if (numDup)
+        printf("Shared data: %d files, saved %d bytes (%dk)\n", numDup, int(dupBytes), int(dupBytes / 1024));
 }
 
 
-bool MemImageUtil::Test()
+bool MemImageUtil::Test(bool large)
 {
     MemImageUtil miu;
 
-    TEST((void*)miu.dataVec == (void*)miu.image);
-
     const uint8_t data4[4] = { 0, 1, 2, 3 };
     const uint8_t data5[5] = { 0, 1, 2, 3, 4 };
 
@@ -173,19 +465,28 @@ bool MemImageUtil::Test()
     
     miu.addDir("dir1abcd");
     miu.addFile("file1", data4, 4, 2, 3, 2);
-    miu.addFile("file2", data5, 5, 3, 2, 3);
+    miu.addFile("file2", data5, 5, 3, 2, 3, MemUnit::CODEC_IMA);
+    miu.writeDesc("test");
 
-    TEST(miu.addr == MemImage::SIZE_BASE + 4 + 4 + 5);
+    TEST(miu.imageSize() == MemImage::DataAddr(5) + 4 + 5);   // file1 shares file0's data
+    const std::vector<uint8_t>& image = miu.assemble();
+    TEST(image.size() == miu.imageSize());
 
     Manifest m;
-    // load from memory
-    memcpy(m.getBasePtr(), miu.image, sizeof(Manifest));
+    TEST(m.load(image.data(), uint32_t(image.size())));
+    TEST(m.version() == MemImage::VERSION);
+    TEST(m.numDir() == 2);
+    TEST(m.numFile() == 3);
+    TEST(strcmp((const char*)image.data() + m.descAddr(), "test") == 0);
 
     TEST(m.getDir("dir2") < 0);
     const MemUnit& muDir0 = m.getUnit(m.getDir("dir0"));
     const MemUnit& muDir1 = m.getUnit(m.getDir("dir1abcd"));
+    TEST(muDir0.size == 1);
+    TEST(muDir1.size == 2);
 
     TEST(m.getFile(m.getDir("dir0"), "file3") < 0);
+    TEST(m.getFile(m.getDir("dir0"), "file1") < 0);
     const MemUnit& muFile0 = m.getUnit(m.getFile(m.getDir("dir0"), "file0"));
     const MemUnit& muFile1 = m.getUnit(m.getFile(m.getDir("dir1abcd"), "file1"));
     const MemUnit& muFile2 = m.getUnit(m.getFile(m.getDir("dir1abcd"), "file2"));
@@ -196,7 +497,7 @@ bool MemImageUtil::Test()
         TEST(muFile0.size == 4);
         TEST(muFile0.table == 1);
         TEST(muFile0.predictor == 4);
-        const uint8_t* data = miu.dataVec + muFile0.offset;
+        const uint8_t* data = image.data() + muFile0.offset;
         for (int i = 0; i < 4; ++i)
             TEST(data[i] == i);
     }
@@ -208,9 +509,139 @@ bool MemImageUtil::Test()
         TEST(muFile2.size == 5);
         TEST(muFile2.table == 3);
         TEST(muFile2.predictor == 2);
-        const uint8_t* data = miu.dataVec + muFile2.offset;
+        TEST(muFile2.codec == MemUnit::CODEC_IMA);
+        TEST(muFile1.codec == MemUnit::CODEC_S4);
+        const uint8_t* data = image.data() + muFile2.offset;
         for (int i = 0; i < 5; ++i)
             TEST(data[i] == i);
     } 
+
+    // An unknown codec isn't loaded.
+    {
+        std::vector<uint8_t> bad = image;
+        MemUnit* unit = (MemUnit*)(bad.data() + MemImage::UNIT_ADDR);
+        unit[4].codec = MemUnit::NUM_CODECS;
+        Manifest mb;
+        TEST(!mb.load(bad.data(), uint32_t(bad.size())));
+    }
+
+    // Text round trip, both formats, and finding a bad line.
+    {
+        std::vector<uint8_t> bytes(1000);
+        for (size_t i = 0; i < bytes.size(); ++i)
+            bytes[i] = i < 600 ? uint8_t(i * 7) : 0;
+
+        std::string text = FramedText(bytes.data(), uint32_t(bytes.size()));
+        std::vector<uint8_t> back;
+        std::vector<int> bad;
+        TEST(ParseText(text.c_str(), text.size(), &back, &bad));
+        TEST(back == bytes);
+        TEST(text.find(" =00\n") != std::string::npos);     // last line is all zero
+
+        size_t line2 = text.find("\n2 ");
+        text[line2 + 20] = text[line2 + 20] == 'A' ? 'B' : 'A';
+        TEST(!ParseText(text.c_str(), text.size(), &back, &bad));
+        TEST(bad.size() == 1 && bad[0] == 2);
+
+        std::string legacy = "1000\n";
+        char line[400];
+        for (int i = 0; i < 1000; i += TEXT_LINE_BYTES) {
+            encodeBase64(bytes.data() + i, std::min(int(TEXT_LINE_BYTES), 1000 - i), line, true);
+            legacy += line;
+            legacy += "\n";
+        }
+        TEST(ParseText(legacy.c_str(), legacy.size(), &back, &bad));
+        TEST(back == bytes);
+    }
+
+    // Identical data is stored once.
+    {
+        MemImageUtil dup;
+        dup.addDir("dir0");
+        dup.addFile("file0", data4, 4, 1, 4, 1);
+        dup.addFile("file1", data5, 5, 1, 4, 1);
+        dup.addDir("dir1");
+        dup.addFile("file0", data4, 4, 2, 3, 1);
+        dup.addFile("file1", data5 + 1, 4, 2, 3, 1);    // same size, different bytes
+        TEST(dup.getNumDupFiles() == 1);
+        TEST(dup.getDupBytes() == 4);
+        TEST(dup.imageSize() == MemImage::DataAddr(6) + 4 + 5 + 4);
+
+        const std::vector<uint8_t>& dupImage = dup.assemble();
+        Manifest dm;
+        TEST(dm.load(dupImage.data(), uint32_t(dupImage.size())));
+        const MemUnit& a = dm.getUnit(dm.getFile("dir0", "file0"));
+        const MemUnit& b = dm.getUnit(dm.getFile("dir1", "file0"));
+        TEST(a.offset == b.offset);
+        TEST(a.table == 1 && b.table == 2);
+        TEST(dm.getUnit(dm.getFile("dir0", "file1")).offset != dm.getUnit(dm.getFile("dir1", "file1")).offset);
+    }
+
+    // With a previous image, unchanged data stays put and the changed file
+    // takes the free space; the patch is only the changed bytes.
+    {
+        uint8_t d[3][64];
+        for (int i = 0; i < 3; ++i)
+            for (int j = 0; j < 64; ++j)
+                d[i][j] = uint8_t(i * 64 + j);
+
+        MemImageUtil a;
+        a.addDir("dir0");
+        for (int i = 0; i < 3; ++i) {
+            char name[MemUnit::NAME_ALLOC];
+            snprintf(name, sizeof(name), "file%d", i);
+            a.addFile(name, d[i], 64, 0, 0, 0);
+        }
+        std::vector<uint8_t> imageA = a.assemble();
+
+        MemImageUtil b;
+        b.setPrevious(imageA.data(), uint32_t(imageA.size()));
+        b.addDir("dir0");
+        d[0][10] ^= 0xff;
+        b.addFile("file1", d[1], 64, 0, 0, 0);  // order changed
+        b.addFile("file0", d[0], 64, 0, 0, 0);  // contents changed
+        b.addFile("file2", d[2], 64, 0, 0, 0);
+        const std::vector<uint8_t>& imageB = b.assemble();
+        TEST(imageB.size() == imageA.size());
+
+        Manifest ma, mb;
+        TEST(ma.load(imageA.data(), uint32_t(imageA.size())));
+        TEST(mb.load(imageB.data(), uint32_t(imageB.size())));
+        for (const char* name : { "file0", "file1", "file2" })
+            TEST(ma.getUnit(ma.getFile("dir0", name)).offset == mb.getUnit(mb.getFile("dir0", name)).offset);
+
+        std::vector<uint8_t> patch, back;
+        ImagePatch::Diff(imageA.data(), uint32_t(imageA.size()), imageB.data(), uint32_t(imageB.size()), &patch);
+        TEST(patch.size() < sizeof(PatchHeader) + 2 * (8 + 64));
+        TEST(ImagePatch::Apply(imageA.data(), uint32_t(imageA.size()), patch.data(), uint32_t(patch.size()), &back));
+        TEST(back == imageB);
+    }
+
+    // More than the old 4 dirs / 92 files; and, if 'large', a size past
+    // the old 24 bit limit.
+    {
+        MemImageUtil big;
+        std::vector<uint8_t> bigData(large ? (1 << 24) + 2 : 2, 7);
+        for (int d = 0; d < 6; ++d) {
+            char name[MemUnit::NAME_ALLOC];
+            snprintf(name, sizeof(name), "font%d", d);
+            big.addDir(name);
+            for (int f = 0; f < 20; ++f) {
+                snprintf(name, sizeof(name), "file%d", f);
+                big.addFile(name, data4, 4, 0, 0, 0);
+            }
+        }
+        big.addFile("big", bigData.data(), int(bigData.size()), 0, 0, 0);
+        const std::vector<uint8_t>& bigImage = big.assemble();
+
+        Manifest bm;
+        TEST(bm.load(bigImage.data(), uint32_t(bigImage.size())));
+        TEST(bm.numDir() == 6);
+        TEST(bm.numFile() == 121);
+        TEST(bm.getFile("font3", "file19") > 0);
+        const MemUnit& bigUnit = bm.getUnit(bm.getFile("font5", "big"));
+        TEST(bigUnit.size == bigData.size());
+        TEST(bigImage[bigUnit.offset + bigUnit.size - 1] == 7);
+    }
     return true;
-}
\ No newline at end of file
+}
@@ -3,9 +3,13 @@
 
 #include <stdint.h>
 #include <vector>
+#include <string>
+#include <unordered_map>
 
 #include "./wav12util/manifest.h"
 
+// Builds a (version 2) memory image. The image grows as files are
+// added; there is no fixed limit on size, dirs, or files.
 class MemImageUtil
 {
 public:
@@ -13,30 +17,65 @@ public:
     ~MemImageUtil();
 
     void addDir(const char* name);
-    void addFile(const char* name, const void* data, int size, int table, int predictor, int32_t e12);
+    void addFile(const char* name, const void* data, int size, int table, int predictor, int32_t e12, int codec = MemUnit::CODEC_S4);
     void writePalette(int index, const MemPalette& palette);
     void writeDesc(const char* desc);
     void dumpConsole();
     int getNumFiles() const {
-        return numFile;
+        return int(files.size());
     }
     int getNumDirs() const {
-        return numDir;
+        return int(dirs.size());
     }
+    // Size of the image, in bytes.
+    uint32_t imageSize() const;
+    // Files whose data was already in the image, and the bytes that saved.
+    int getNumDupFiles() const { return numDup; }
+    uint32_t getDupBytes() const { return dupBytes; }
+
+    // Image this one replaces. Data that hasn't changed is kept at the same
+    // address, so a patch (see ImagePatch) from the previous image is small.
+    void setPrevious(const uint8_t* data, uint32_t size);
+
+    // Lays out the image. The result is valid until the next change.
+    const std::vector<uint8_t>& assemble();
 
     void write(const char* name);
-    void writeText(const char* name);
+    // Text (base64) image, for upload over serial. The framed version adds a
+    // sequence number and CRC32 to every line, and a CRC32 of the whole image,
+    // so a bad line can be found and resent on its own.
+    void writeText(const char* name, bool framed = false);
+
+    static std::string FramedText(const uint8_t* image, uint32_t size);
+    // Reads either text format. Returns false if the text can't be parsed or,
+    // if framed, any line or the whole image fails its CRC. Lines that are
+    // bad or missing are returned in 'badLines'.
+    static bool ParseText(const char* text, size_t len, std::vector<uint8_t>* image, std::vector<int>* badLines);
 
-    static bool Test();
+    // 'large' adds a file past the old 24 bit size limit. That's 16 MB of
+    // data, so it's only run by 'wav12 test', not every start up.
+    static bool Test(bool large = false);
+
+    static const int TEXT_LINE_BYTES = 256;
 
 private:
-    static const int MEMORY_SIZE = 2 * 1024 * 1024;
-    int numDir = 0;
-    int numFile = 0;
-    int addr = MemImage::SIZE_BASE;      // points to the beginning of the heap.
-    int32_t e12[MemImage::NUM_MEMUNITS];
-    MemImage* image = 0;            // alias to dataVac
-    uint8_t* dataVec;               // The entire 2mb image. The MemImage is at the beginning.
+    uint32_t dataAddr() const { return MemImage::DataAddr(uint32_t(dirs.size() + files.size())); }
+    // Image address of each file. Returns the size of the image.
+    uint32_t layout(std::vector<uint32_t>* addr) const;
+
+    std::vector<MemUnit> dirs;      // offset is the index of the first file
+    std::vector<MemUnit> files;     // offset is relative to the start of 'heap'
+    std::vector<int32_t> e12;       // per file
+    std::vector<uint8_t> heap;      // the sound data
+    // Identical data is stored once: hash of the data -> file that first stored it.
+    std::unordered_multimap<uint32_t, int> content;
+    int numDup = 0;
+    uint32_t dupBytes = 0;
+    char desc[MemImage::SIZE_DESC];
+    MemPalette palette[MemPalette::NUM_PALETTES];
+    std::vector<uint8_t> image;     // the assembled image
+    std::vector<uint8_t> previous;  // the image this one replaces, if any
+    std::unordered_multimap<uint32_t, uint32_t> previousContent;   // hash of data -> address in 'previous'
 };
 
 #endif // MEMORY_IMAGE_INCLUDE
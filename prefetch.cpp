@@ -0,0 +1,150 @@
+#include "prefetch.h"
+#include "wavutil.h"
+#include "trace.h"
+
+extern "C" {
+#include "wave_reader.h"
+}
+
+#include <assert.h>
+#include <stdio.h>
+
+#define TEST(x) { if (!(x)) { assert(false); return false; }}
+
+static PcmFile ReadWav(const std::string& path, bool readSamples)
+{
+    PcmFile file;
+    wave_reader_error wrErr = WR_NO_ERROR;
+    wave_reader* wr = wave_reader_open(path.c_str(), &wrErr);
+    if (wrErr != WR_NO_ERROR) {
+        file.error = wrErr;
+        return file;
+    }
+    file.format = wave_reader_get_format(wr);
+    file.nChannels = wave_reader_get_num_channels(wr);
+    file.rate = wave_reader_get_sample_rate(wr);
+    file.bits = wave_reader_get_sample_bits(wr);
+    file.nSamples = wave_reader_get_num_samples(wr);
+    // Only 16 bit mono is useful; the caller reports anything else.
+    if (readSamples && file.format == 1 && file.nChannels == 1 && file.bits == 16) {
+        file.samples.resize(file.nSamples);
+        if (!file.samples.empty())
+            wave_reader_get_samples(wr, int(file.samples.size()), file.samples.data());
+    }
+    wave_reader_close(wr);
+    return file;
+}
+
+PcmFile PcmFile::Read(const std::string& path)
+{
+    Trace::Scope scope("read", path);
+    return ReadWav(path, true);
+}
+
+PcmFile PcmFile::ReadHeader(const std::string& path)
+{
+    Trace::Scope scope("header", path);
+    return ReadWav(path, false);
+}
+
+
+WavPrefetch::WavPrefetch(const std::vector<std::string>& paths, int ahead)
+    : m_paths(paths), m_files(paths.size()), m_ahead(ahead > 1 ? ahead : 1)
+{
+    m_thread = std::thread(&WavPrefetch::run, this);
+}
+
+
+WavPrefetch::~WavPrefetch()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cond.notify_all();
+    m_thread.join();
+}
+
+
+void WavPrefetch::run()
+{
+    Trace::NameThread("prefetch");
+    const int n = int(m_paths.size());
+    for (int i = 0; i < n; ++i) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [&] { return m_stop || i < m_taken + m_ahead; });
+            if (m_stop)
+                return;
+        }
+        // Read without the lock, so take() can hand over earlier files.
+        PcmFile file = PcmFile::Read(m_paths[i]);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_files[i] = std::move(file);
+            m_read = i + 1;
+        }
+        m_cond.notify_all();
+    }
+}
+
+
+PcmFile WavPrefetch::take(int index)
+{
+    assert(index == m_taken);
+    Trace::Scope scope("read wait");    // time the compression waits on the disk
+    PcmFile file;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond.wait(lock, [&] { return index < m_read; });
+        file = std::move(m_files[index]);
+        m_taken = index + 1;
+    }
+    m_cond.notify_all();
+    return file;
+}
+
+
+bool WavPrefetch::Test()
+{
+    TempDir tmp;
+    TEST(tmp.ok());
+    const std::string name = tmp.path("testPrefetch.wav");
+    const std::string missing = tmp.path("testPrefetchMissing.wav");
+    int16_t samples[100];
+    for (int i = 0; i < 100; ++i)
+        samples[i] = int16_t(i * 300 - 15000);
+    {
+        WavWriter writer;
+        TEST(writer.open(name.c_str()));
+        writer.put(samples, 100);
+        TEST(writer.close());
+    }
+
+    std::vector<std::string> paths = { name, missing, name, name, name };
+    {
+        WavPrefetch prefetch(paths, 2);
+        for (int i = 0; i < int(paths.size()); ++i) {
+            PcmFile file = prefetch.take(i);
+            if (i == 1) {
+                TEST(file.error != 0);
+                continue;
+            }
+            TEST(file.error == 0);
+            TEST(file.rate == 22050 && file.nChannels == 1 && file.format == 1);
+            TEST(file.samples.size() == 100);
+            TEST(file.samples[99] == samples[99]);
+        }
+    }
+    {
+        PcmFile header = PcmFile::ReadHeader(name);
+        TEST(header.error == 0 && header.nSamples == 100 && header.samples.empty());
+        TEST(PcmFile::ReadHeader(missing).error != 0);
+    }
+    {
+        // Stopping early doesn't wait for the rest.
+        WavPrefetch prefetch(paths, 1);
+        TEST(prefetch.take(0).error == 0);
+    }
+    return true;
+}
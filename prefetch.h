@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The contents of a WAV file, as read from disk.
+struct PcmFile {
+    int error = 0;              // wave_reader_error
+    int format = 0;
+    int nChannels = 0;
+    int rate = 0;
+    int bits = 0;
+    int nSamples = 0;               // frames in the file
+    std::vector<int16_t> samples;   // only read for 16 bit mono
+
+    // Reads 'path' now.
+    static PcmFile Read(const std::string& path);
+    // The format and length of 'path', without the samples.
+    static PcmFile ReadHeader(const std::string& path);
+};
+
+/*
+    Reads WAV files on a background thread, ahead of when they are needed,
+    so disk (or network) time overlaps with compression. At most 'ahead'
+    files are read and not yet taken, which bounds the memory used.
+*/
+class WavPrefetch
+{
+public:
+    WavPrefetch(const std::vector<std::string>& paths, int ahead);
+    ~WavPrefetch();
+
+    // Waits for file 'index' to be read, and hands it over. Files are
+    // taken in order.
+    PcmFile take(int index);
+
+    static bool Test();
+
+private:
+    WavPrefetch(const WavPrefetch&) = delete;
+    void operator=(const WavPrefetch&) = delete;
+
+    void run();
+
+    std::vector<std::string> m_paths;
+    std::vector<PcmFile> m_files;
+    int m_ahead = 1;
+    int m_read = 0;         // files read by the thread
+    int m_taken = 0;        // files handed over by take()
+    bool m_stop = false;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::thread m_thread;
+};
@@ -0,0 +1,123 @@
+#include "preprocess.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#define TEST(x) { if (!(x)) { assert(false); return false; }}
+
+int Preprocess::LeadingSilence(const int16_t* samples, int nSamples, int level)
+{
+    int n = 0;
+    while (n < nSamples && abs(samples[n]) <= level)
+        ++n;
+    return n;
+}
+
+int Preprocess::TrailingSilence(const int16_t* samples, int nSamples, int level)
+{
+    int n = 0;
+    while (n < nSamples && abs(samples[nSamples - 1 - n]) <= level)
+        ++n;
+    return n;
+}
+
+PreprocessResult Preprocess::Apply(std::vector<int16_t>& samples, const PreprocessOptions& options, bool looping)
+{
+    PreprocessResult result;
+    if (samples.empty())
+        return result;
+
+    if (options.removeDC) {
+        int64_t sum = 0;
+        for (int16_t s : samples)
+            sum += s;
+        int64_t n = int64_t(samples.size());
+        result.dc = int((sum + (sum >= 0 ? n / 2 : -n / 2)) / n);
+        if (result.dc) {
+            for (int16_t& s : samples)
+                s = int16_t(std::min(std::max(int(s) - result.dc, -32768), 32767));
+        }
+    }
+
+    if (looping)
+        return result;
+
+    if (options.trimLevel > 0) {
+        int n = int(samples.size());
+        result.leading = LeadingSilence(samples.data(), n, options.trimLevel);
+        if (result.leading == n) {
+            // All silence. Keep a little, so there is still a sound.
+            result.leading = std::max(n - 2, 0);
+        }
+        result.trailing = TrailingSilence(samples.data() + result.leading, n - result.leading, options.trimLevel);
+        samples.erase(samples.end() - result.trailing, samples.end());
+        samples.erase(samples.begin(), samples.begin() + result.leading);
+    }
+
+    if (options.fadeMSec > 0 && (result.leading || result.trailing)) {
+        const int n = int(samples.size());
+        // 64 bit: a long fade on a long sound overflows sample * i.
+        const int fade = int(std::min<int64_t>(int64_t(options.fadeMSec) * 22050 / 1000, n / 2));
+        for (int i = 0; i < fade; ++i) {
+            if (result.leading)
+                samples[i] = int16_t(int64_t(samples[i]) * i / fade);
+            if (result.trailing)
+                samples[n - 1 - i] = int16_t(int64_t(samples[n - 1 - i]) * i / fade);
+        }
+    }
+    return result;
+}
+
+bool Preprocess::Test()
+{
+    {
+        std::vector<int16_t> s = { 0, 1, -2, 100, -200, 300, 3, 0, -1 };
+        TEST(LeadingSilence(s.data(), int(s.size()), 4) == 3);
+        TEST(TrailingSilence(s.data(), int(s.size()), 4) == 3);
+        TEST(TrailingSilence(s.data(), int(s.size()), 0) == 0);
+
+        PreprocessOptions options;
+        options.trimLevel = 4;
+        PreprocessResult r = Apply(s, options, true);
+        TEST(r.leading == 0 && r.trailing == 0 && s.size() == 9);  // looping: left alone
+
+        r = Apply(s, options, false);
+        TEST(r.leading == 3 && r.trailing == 3);
+        TEST(s.size() == 3 && s[0] == 100 && s[2] == 300);
+    }
+    {
+        std::vector<int16_t> s = { 110, 90, 110, 90 };
+        PreprocessOptions options;
+        options.removeDC = true;
+        PreprocessResult r = Apply(s, options, false);
+        TEST(r.dc == 100);
+        TEST(s[0] == 10 && s[1] == -10);
+    }
+    {
+        std::vector<int16_t> s(1000, 1000);
+        s.insert(s.begin(), 10, 0);
+        PreprocessOptions options;
+        options.trimLevel = 1;
+        options.fadeMSec = 1;     // 22 samples
+        PreprocessResult r = Apply(s, options, false);
+        TEST(r.leading == 10 && r.trailing == 0);
+        TEST(s.size() == 1000);
+        TEST(s[0] == 0 && s[11] == 500 && s[22] == 1000);
+        TEST(s[999] == 1000);
+    }
+    {
+        // A fade of 100000 samples: past where sample * i fits in 32 bits.
+        std::vector<int16_t> s(300000, 30000);
+        s.insert(s.begin(), 10, 0);
+        s.push_back(0);
+        PreprocessOptions options;
+        options.trimLevel = 1;
+        options.fadeMSec = PreprocessOptions::MAX_FADE_MSEC;
+        Apply(s, options, false);
+        TEST(s.size() == 300000);
+        TEST(s[100000] == 20000 && s[149999] == 29999);
+        TEST(s[300000 - 1 - 100000] == 20000);
+    }
+    return true;
+}
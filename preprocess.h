@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+struct PreprocessOptions {
+    int trimLevel = 0;          // leading and trailing samples at or below this level are removed. 0 is off.
+    bool removeDC = false;      // subtract the average
+    int fadeMSec = 0;           // fade in and out over this time at trimmed ends. 0 is off.
+
+    static const int MAX_FADE_MSEC = 60 * 1000;
+};
+
+struct PreprocessResult {
+    int leading = 0;            // samples trimmed from the start
+    int trailing = 0;           // samples trimmed from the end
+    int dc = 0;                 // offset removed
+};
+
+// Cleans up the source samples before encoding. Quiet leading and trailing
+// samples still cost 4 bits each in the image, and a DC offset makes the
+// predictor work harder.
+class Preprocess
+{
+public:
+    // Samples at the start / end at or below 'level'.
+    static int LeadingSilence(const int16_t* samples, int nSamples, int level);
+    static int TrailingSilence(const int16_t* samples, int nSamples, int level);
+
+    // Looping sounds are not trimmed or faded, since that would break the loop.
+    static PreprocessResult Apply(std::vector<int16_t>& samples, const PreprocessOptions& options, bool looping);
+
+    static bool Test();
+};
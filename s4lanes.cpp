@@ -0,0 +1,394 @@
+#include "s4lanes.h"
+#include "wavutil.h"
+#include "./wav12/s4adpcm.h"
+
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#define TEST(x) { if (!(x)) { assert(false); return false; }}
+
+namespace {
+    const int LANES = S4Lanes::LANES;
+    const int CHUNK = S4Lanes::CHUNK;
+    const int TABLE_SIZE = S4ADPCM::TABLE_SIZE;
+
+    struct Lanes {
+        int32_t prev1[LANES];
+        int32_t prev2[LANES];
+        int32_t shift[LANES];
+        int32_t predictor[LANES];
+        int32_t table[LANES * TABLE_SIZE];  // lane i at i * TABLE_SIZE
+        int32_t index[CHUNK][LANES];        // the nibbles, one row per sample
+        int32_t value[CHUNK][LANES];        // the clamped output
+    };
+
+    struct EncodeLanes {
+        int32_t prev1[LANES];
+        int32_t prev2[LANES];
+        int32_t shift[LANES];
+        int32_t predictor[LANES];
+        int32_t shapeErr[LANES];
+        int32_t table[LANES * TABLE_SIZE];
+        int32_t value[CHUNK][LANES];        // the clamped reconstruction, as decoded
+    };
+}
+
+// decode4(), one lane at a time.
+static void DecodeScalar(Lanes& s, int n)
+{
+    for (int t = 0; t < n; ++t) {
+        for (int l = 0; l < LANES; ++l) {
+            const int index = s.index[t][l];
+            const int32_t guess = S4ADPCM::State::predict(s.prev1[l], s.prev2[l], s.predictor[l]);
+            const int32_t value = wrapAdd(guess, S4ADPCM::STEP[index] * (1 << s.shift[l]));
+            s.prev2[l] = s.prev1[l];
+            s.prev1[l] = value;
+            s.value[t][l] = fastClamp<int32_t>(value, SHRT_MIN, SHRT_MAX);
+            const int delta = abs(index - S4ADPCM::ZERO_INDEX);
+            s.shift[l] = fastClamp(s.shift[l] + s.table[l * TABLE_SIZE + delta], int32_t(0), S4ADPCM::SHIFT_LIMIT_4);
+        }
+    }
+}
+
+#if W12_AVX2()
+W12_TARGET_AVX2 static void DecodeAVX2(Lanes& s, int n)
+{
+    static_assert(LANES == 8, "one lane per 32 bit element");
+    __m256i prev1 = _mm256_loadu_si256((const __m256i*)s.prev1);
+    __m256i prev2 = _mm256_loadu_si256((const __m256i*)s.prev2);
+    __m256i shift = _mm256_loadu_si256((const __m256i*)s.shift);
+    const __m256i predictor = _mm256_loadu_si256((const __m256i*)s.predictor);
+
+    const __m256i tableBase = _mm256_setr_epi32(0, TABLE_SIZE, TABLE_SIZE * 2, TABLE_SIZE * 3,
+        TABLE_SIZE * 4, TABLE_SIZE * 5, TABLE_SIZE * 6, TABLE_SIZE * 7);
+    const __m256i zeroIndex = _mm256_set1_epi32(S4ADPCM::ZERO_INDEX);
+    const __m256i three = _mm256_set1_epi32(3);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i shiftLimit = _mm256_set1_epi32(S4ADPCM::SHIFT_LIMIT_4);
+    const __m256i lo = _mm256_set1_epi32(SHRT_MIN);
+    const __m256i hi = _mm256_set1_epi32(SHRT_MAX);
+
+    for (int t = 0; t < n; ++t) {
+        const __m256i index = _mm256_loadu_si256((const __m256i*)s.index[t]);
+
+        // (prev1 - prev2) * predictor / 4, rounding towards zero like C.
+        __m256i v = _mm256_mullo_epi32(_mm256_sub_epi32(prev1, prev2), predictor);
+        v = _mm256_add_epi32(v, _mm256_and_si256(_mm256_srai_epi32(v, 31), three));
+        const __m256i guess = _mm256_add_epi32(prev1, _mm256_srai_epi32(v, 2));
+
+        // STEP[index] << shift is STEP[index] * mult
+        const __m256i step = _mm256_i32gather_epi32((const int*)S4ADPCM::STEP, index, 4);
+        const __m256i value = _mm256_add_epi32(guess, _mm256_sllv_epi32(step, shift));
+        prev2 = prev1;
+        prev1 = value;
+        _mm256_storeu_si256((__m256i*)s.value[t], _mm256_min_epi32(_mm256_max_epi32(value, lo), hi));
+
+        const __m256i delta = _mm256_abs_epi32(_mm256_sub_epi32(index, zeroIndex));
+        const __m256i dShift = _mm256_i32gather_epi32((const int*)s.table, _mm256_add_epi32(tableBase, delta), 4);
+        shift = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(shift, dShift), zero), shiftLimit);
+    }
+    _mm256_storeu_si256((__m256i*)s.prev1, prev1);
+    _mm256_storeu_si256((__m256i*)s.prev2, prev2);
+    _mm256_storeu_si256((__m256i*)s.shift, shift);
+}
+#endif
+
+
+// encode4(), one lane at a time, keeping the reconstructed values. Only
+// the first nLanes are run: there is no vector to fill.
+static void EncodeScalar(EncodeLanes& s, int nLanes, const int16_t* samples, int n, int32_t noiseShape)
+{
+    for (int t = 0; t < n; ++t) {
+        for (int l = 0; l < nLanes; ++l) {
+            const int32_t guess = s.prev1[l] + (s.prev1[l] - s.prev2[l]) * s.predictor[l] / 4;
+            const int32_t mult = 1 << s.shift[l];
+            int32_t want = samples[t];
+            if (noiseShape)
+                want = fastClamp<int32_t>(want - s.shapeErr[l] * noiseShape / 4, SHRT_MIN, SHRT_MAX);
+
+            int bestE = INT_MAX;
+            int index = S4ADPCM::ZERO_INDEX;
+            for (int j = 0; j < 16; ++j) {
+                int32_t e = abs(guess + mult * S4ADPCM::STEP[j] - want);
+                if (e < bestE) {
+                    bestE = e;
+                    index = j;
+                }
+            }
+            const int32_t value = guess + S4ADPCM::STEP[index] * mult;
+            const int32_t clamped = fastClamp<int32_t>(value, SHRT_MIN, SHRT_MAX);
+            s.prev2[l] = s.prev1[l];
+            s.prev1[l] = value;
+            s.value[t][l] = clamped;
+            const int delta = abs(index - S4ADPCM::ZERO_INDEX);
+            s.shift[l] = fastClamp(s.shift[l] + s.table[l * TABLE_SIZE + delta], int32_t(0), S4ADPCM::SHIFT_LIMIT_4);
+            if (noiseShape)
+                s.shapeErr[l] = clamped - want;
+        }
+    }
+}
+
+#if W12_AVX2()
+// Rounds towards zero, like C.
+W12_TARGET_AVX2 static inline __m256i DivBy4(__m256i v)
+{
+    v = _mm256_add_epi32(v, _mm256_and_si256(_mm256_srai_epi32(v, 31), _mm256_set1_epi32(3)));
+    return _mm256_srai_epi32(v, 2);
+}
+
+W12_TARGET_AVX2 static void EncodeAVX2(EncodeLanes& s, const int16_t* samples, int n, int32_t noiseShape)
+{
+    __m256i prev1 = _mm256_loadu_si256((const __m256i*)s.prev1);
+    __m256i prev2 = _mm256_loadu_si256((const __m256i*)s.prev2);
+    __m256i shift = _mm256_loadu_si256((const __m256i*)s.shift);
+    __m256i shapeErr = _mm256_loadu_si256((const __m256i*)s.shapeErr);
+    const __m256i predictor = _mm256_loadu_si256((const __m256i*)s.predictor);
+
+    const __m256i tableBase = _mm256_setr_epi32(0, TABLE_SIZE, TABLE_SIZE * 2, TABLE_SIZE * 3,
+        TABLE_SIZE * 4, TABLE_SIZE * 5, TABLE_SIZE * 6, TABLE_SIZE * 7);
+    const __m256i zeroIndex = _mm256_set1_epi32(S4ADPCM::ZERO_INDEX);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i shiftLimit = _mm256_set1_epi32(S4ADPCM::SHIFT_LIMIT_4);
+    const __m256i lo = _mm256_set1_epi32(SHRT_MIN);
+    const __m256i hi = _mm256_set1_epi32(SHRT_MAX);
+    const __m256i shape = _mm256_set1_epi32(noiseShape);
+
+    for (int t = 0; t < n; ++t) {
+        const __m256i guess = _mm256_add_epi32(prev1, DivBy4(_mm256_mullo_epi32(_mm256_sub_epi32(prev1, prev2), predictor)));
+        __m256i want = _mm256_set1_epi32(samples[t]);
+        if (noiseShape) {
+            want = _mm256_sub_epi32(want, DivBy4(_mm256_mullo_epi32(shapeErr, shape)));
+            want = _mm256_min_epi32(_mm256_max_epi32(want, lo), hi);
+        }
+
+        // The search over STEP: the first j with the smallest error wins,
+        // as in encode4().
+        const __m256i offset = _mm256_sub_epi32(guess, want);
+        __m256i bestE = _mm256_set1_epi32(INT_MAX);
+        __m256i index = zeroIndex;
+        __m256i value = guess;
+        for (int j = 0; j < 16; ++j) {
+            const __m256i step = _mm256_sllv_epi32(_mm256_set1_epi32(S4ADPCM::STEP[j]), shift);
+            const __m256i e = _mm256_abs_epi32(_mm256_add_epi32(offset, step));
+            const __m256i better = _mm256_cmpgt_epi32(bestE, e);
+            bestE = _mm256_min_epi32(bestE, e);
+            index = _mm256_blendv_epi8(index, _mm256_set1_epi32(j), better);
+            value = _mm256_blendv_epi8(value, _mm256_add_epi32(guess, step), better);
+        }
+        prev2 = prev1;
+        prev1 = value;
+        const __m256i clamped = _mm256_min_epi32(_mm256_max_epi32(value, lo), hi);
+        _mm256_storeu_si256((__m256i*)s.value[t], clamped);
+
+        const __m256i delta = _mm256_abs_epi32(_mm256_sub_epi32(index, zeroIndex));
+        const __m256i dShift = _mm256_i32gather_epi32((const int*)s.table, _mm256_add_epi32(tableBase, delta), 4);
+        shift = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(shift, dShift), zero), shiftLimit);
+        if (noiseShape)
+            shapeErr = _mm256_sub_epi32(clamped, want);
+    }
+    _mm256_storeu_si256((__m256i*)s.prev1, prev1);
+    _mm256_storeu_si256((__m256i*)s.prev2, prev2);
+    _mm256_storeu_si256((__m256i*)s.shift, shift);
+    _mm256_storeu_si256((__m256i*)s.shapeErr, shapeErr);
+}
+#endif
+
+
+void S4Lanes::EncodeErrors(const int16_t* samples, int nSamples,
+    const S4Candidate* candidates, int nCandidates,
+    ErrorMetric metric, int noiseShape, int32_t* errors, bool simd)
+{
+    assert(nCandidates <= LANES);
+    assert((nSamples & 1) == 0);
+    std::unique_ptr<EncodeLanes> lanes(new EncodeLanes);
+    EncodeLanes& s = *lanes;
+    memset(&s, 0, sizeof(EncodeLanes));
+    for (int l = 0; l < nCandidates; ++l) {
+        s.predictor[l] = candidates[l].predictor;
+        for (int i = 0; i < TABLE_SIZE; ++i)
+            s.table[l * TABLE_SIZE + i] = candidates[l].table[i];
+    }
+
+    simd = simd && CpuHasAVX2();
+    std::vector<ErrorAccum> accum(nCandidates, ErrorAccum(metric));
+    int16_t decoded[CHUNK];
+    for (int pos = 0; pos < nSamples; pos += CHUNK) {
+        const int n = std::min(int(CHUNK), nSamples - pos);
+#if W12_AVX2()
+        if (simd)
+            EncodeAVX2(s, samples + pos, n, noiseShape);
+        else
+#endif
+            EncodeScalar(s, nCandidates, samples + pos, n, noiseShape);
+
+        for (int l = 0; l < nCandidates; ++l) {
+            for (int t = 0; t < n; ++t)
+                decoded[t] = int16_t(s.value[t][l]);
+            accum[l].add(samples + pos, decoded, n);
+        }
+    }
+    for (int l = 0; l < nCandidates; ++l)
+        errors[l] = accum[l].result();
+}
+
+
+void S4Lanes::Decode(const S4Job* jobs, int nJobs, bool simd)
+{
+    simd = simd && CpuHasAVX2();
+    std::unique_ptr<Lanes> lanes(new Lanes);
+    Lanes& s = *lanes;
+    int job[LANES];     // -1 if the lane is idle
+    int pos[LANES];
+    int next = 0;
+
+    // Idle lanes decode silence, and their state never changes.
+    auto start = [&](int l) {
+        while (next < nJobs && jobs[next].nSamples <= 0)
+            ++next;
+        job[l] = next < nJobs ? next++ : -1;
+        pos[l] = 0;
+        s.prev1[l] = s.prev2[l] = s.shift[l] = 0;
+        s.predictor[l] = job[l] >= 0 ? jobs[job[l]].predictor : 0;
+        for (int i = 0; i < TABLE_SIZE; ++i)
+            s.table[l * TABLE_SIZE + i] = job[l] >= 0 ? jobs[job[l]].table[i] : 0;
+    };
+    for (int l = 0; l < LANES; ++l)
+        start(l);
+
+    while (true) {
+        // Up to the end of the shortest stream.
+        int n = CHUNK;
+        bool any = false;
+        for (int l = 0; l < LANES; ++l) {
+            if (job[l] >= 0) {
+                n = std::min(n, jobs[job[l]].nSamples - pos[l]);
+                any = true;
+            }
+        }
+        if (!any)
+            break;
+        assert((n & 1) == 0);
+
+        for (int l = 0; l < LANES; ++l) {
+            if (job[l] < 0) {
+                for (int t = 0; t < n; ++t)
+                    s.index[t][l] = S4ADPCM::ZERO_INDEX;
+                continue;
+            }
+            // Low nibble first, as decode4() reads them.
+            const uint8_t* src = jobs[job[l]].compressed + pos[l] / 2;
+            for (int t = 0; t < n; t += 2) {
+                s.index[t][l] = src[t / 2] & 0x0f;
+                s.index[t + 1][l] = src[t / 2] >> 4;
+            }
+        }
+
+#if W12_AVX2()
+        if (simd)
+            DecodeAVX2(s, n);
+        else
+#endif
+            DecodeScalar(s, n);
+
+        for (int l = 0; l < LANES; ++l) {
+            if (job[l] < 0)
+                continue;
+            int16_t* out = jobs[job[l]].out + pos[l];
+            for (int t = 0; t < n; ++t)
+                out[t] = int16_t(s.value[t][l]);
+            pos[l] += n;
+            if (pos[l] == jobs[job[l]].nSamples)
+                start(l);
+        }
+    }
+}
+
+
+bool S4Lanes::Test()
+{
+    // More streams than lanes, of lengths that end inside chunks, one
+    // empty, and every table and predictor.
+    static const int N_JOBS = 21;
+    static const int MAX_N = 3000;
+    std::vector<int16_t> samples(MAX_N);
+    wav12::ExpanderAD4::generateTestData(MAX_N, samples.data());
+    for (int i = 0; i < MAX_N; ++i)
+        samples[i] = int16_t(samples[i] * (i % 700) / 700);
+
+    std::vector<uint8_t> compressed[N_JOBS];
+    std::vector<int16_t> ref[N_JOBS], out[N_JOBS], outScalar[N_JOBS];
+    S4Job jobs[N_JOBS], jobsScalar[N_JOBS];
+    for (int j = 0; j < N_JOBS; ++j) {
+        const int n = j == 5 ? 0 : (MAX_N - j * 131) & ~1;
+        const int table = j % S4ADPCM::N_TABLES;
+        const int predictor = j % S4ADPCM::State::N_PREDICTOR;
+        compressed[j].resize(n / 2 + 1);
+        S4ADPCM::State encState(S4ADPCM::getTable(table), predictor);
+        S4ADPCM::encode4(samples.data() + j, n, compressed[j].data(), &encState);
+
+        std::vector<int32_t> stereo(n * 2 + 2);
+        S4ADPCM::State decState(S4ADPCM::getTable(table), predictor);
+        decState.volumeShifted = 256 << 8;
+        S4ADPCM::decode4(compressed[j].data(), n, 256, false, stereo.data(), &decState);
+        ref[j].resize(n + 1);
+        WavWriter::NarrowStereo32(stereo.data(), n, ref[j].data());
+
+        out[j].assign(n + 1, 0x5555);
+        outScalar[j].assign(n + 1, 0x5555);
+        jobs[j].compressed = compressed[j].data();
+        jobs[j].nSamples = n;
+        jobs[j].table = S4ADPCM::getTable(table);
+        jobs[j].predictor = predictor;
+        jobs[j].out = out[j].data();
+        jobsScalar[j] = jobs[j];
+        jobsScalar[j].out = outScalar[j].data();
+    }
+    Decode(jobs, N_JOBS);
+    Decode(jobsScalar, N_JOBS, false);
+    for (int j = 0; j < N_JOBS; ++j) {
+        const int n = jobs[j].nSamples;
+        TEST(memcmp(out[j].data(), ref[j].data(), n * 2) == 0);
+        TEST(memcmp(outScalar[j].data(), ref[j].data(), n * 2) == 0);
+        TEST(out[j][n] == 0x5555);     // nothing past the end
+    }
+
+    // Every candidate, in groups of LANES, against encode4() then decode4().
+    static const int N_CANDIDATES = S4ADPCM::N_TABLES * S4ADPCM::State::N_PREDICTOR;
+    static const int N = 2000;
+    std::vector<uint8_t> enc(N / 2);
+    std::vector<int32_t> stereo(N * 2);
+    std::vector<int16_t> dec(N);
+    const int shapes[3] = { 0, 2, -3 };
+    for (int m = 0; m < 3; ++m) {
+        const ErrorMetric metric = ErrorMetric(m);
+        for (int noiseShape : shapes) {
+            S4Candidate cands[N_CANDIDATES];
+            int32_t errors[N_CANDIDATES], errorsScalar[N_CANDIDATES];
+            for (int i = 0; i < N_CANDIDATES; ++i) {
+                cands[i].table = S4ADPCM::getTable(i / S4ADPCM::State::N_PREDICTOR);
+                cands[i].predictor = i % S4ADPCM::State::N_PREDICTOR;
+            }
+            for (int i = 0; i < N_CANDIDATES; i += LANES) {
+                int n = std::min(int(LANES), N_CANDIDATES - i);
+                EncodeErrors(samples.data(), N, cands + i, n, metric, noiseShape, errors + i);
+                EncodeErrors(samples.data(), N, cands + i, n, metric, noiseShape, errorsScalar + i, false);
+            }
+            for (int i = 0; i < N_CANDIDATES; ++i) {
+                S4ADPCM::State encState(cands[i].table, cands[i].predictor);
+                S4ADPCM::encode4(samples.data(), N, enc.data(), &encState, noiseShape);
+                S4ADPCM::State decState(cands[i].table, cands[i].predictor);
+                decState.volumeShifted = 256 << 8;
+                S4ADPCM::decode4(enc.data(), N, 256, false, stereo.data(), &decState);
+                WavWriter::NarrowStereo32(stereo.data(), N, dec.data());
+                ErrorAccum accum(metric);
+                accum.add(samples.data(), dec.data(), N);
+                TEST(errors[i] == accum.result());
+                TEST(errorsScalar[i] == accum.result());
+            }
+        }
+    }
+    return true;
+}
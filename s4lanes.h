@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include "errormetric.h"
+
+// One S4 stream to decode.
+struct S4Job {
+    const uint8_t* compressed = 0;
+    int nSamples = 0;           // even
+    const int32_t* table = 0;   // S4ADPCM::getTable()
+    int predictor = 0;
+    int16_t* out = 0;           // nSamples
+};
+
+// One way to encode the samples, for S4Lanes::EncodeErrors().
+struct S4Candidate {
+    const int32_t* table = 0;   // S4ADPCM::getTable()
+    int predictor = 0;
+};
+
+/*
+    Decodes many independent S4 streams at once. decode4() can't be
+    vectorized within a stream, since every sample needs the prediction
+    and shift of the one before, but separate streams can run side by side,
+    one per SIMD lane: the state is kept as a structure of arrays, and the
+    STEP and delta table lookups are gathers. When a stream ends, its lane
+    takes the next one.
+
+    The output is the clamped 16 bit value: the same as ExpanderAD4 at
+    volume 256 with easing off, narrowed by WavWriter::NarrowStereo32().
+    This is for the tool; the device mixes its few voices with fillBuffer().
+*/
+class S4Lanes
+{
+public:
+    static const int LANES = 8;
+    static const int CHUNK = 256;   // samples per lane between checks for a finished stream
+
+    // The vector code runs if the CPU has AVX2. 'simd' false runs the same
+    // lanes without it, for testing.
+    static void Decode(const S4Job* jobs, int nJobs, bool simd = true);
+
+    // The encoder side: up to LANES candidate encodings of the same
+    // samples, in one pass over them. Each lane runs encode4() with its
+    // own table and predictor, and the reconstructed values go straight
+    // to an ErrorAccum. Nothing is written out; errors[i] is what errorS4()
+    // returns for candidate i. nSamples is even.
+    static void EncodeErrors(const int16_t* samples, int nSamples,
+        const S4Candidate* candidates, int nCandidates,
+        ErrorMetric metric, int noiseShape, int32_t* errors, bool simd = true);
+
+    static bool Test();
+};
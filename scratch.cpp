@@ -0,0 +1,129 @@
+#include "scratch.h"
+
+#include <assert.h>
+#include <string.h>
+#include <atomic>
+
+#ifdef _WIN32
+#   include <windows.h>
+#   include <psapi.h>
+#   pragma comment(lib, "psapi.lib")
+#else
+#   include <sys/resource.h>
+#endif
+
+#define TEST(x) { if (!(x)) { assert(false); return false; }}
+
+namespace {
+    std::atomic<int64_t> gAllocs(0);
+    std::atomic<int64_t> gReuses(0);
+    std::atomic<int64_t> gBytes(0);
+
+    // Sizes are rounded up, so nearby sizes share blocks.
+    const size_t GRANULE = 64 * 1024;
+}
+
+ScratchPool& ScratchPool::Thread()
+{
+    static thread_local ScratchPool pool;
+    return pool;
+}
+
+void* ScratchPool::acquire(size_t bytes)
+{
+    if (bytes == 0)
+        bytes = 1;
+
+    // Smallest free block that fits.
+    Block* best = 0;
+    for (Block& b : m_blocks) {
+        if (!b.inUse && b.size >= bytes && (!best || b.size < best->size))
+            best = &b;
+    }
+    if (best) {
+        gReuses++;
+    }
+    else {
+        // Replace the largest free block that is too small, or add one.
+        for (Block& b : m_blocks) {
+            if (!b.inUse && (!best || b.size > best->size))
+                best = &b;
+        }
+        if (!best) {
+            m_blocks.emplace_back();
+            best = &m_blocks.back();
+        }
+        size_t size = (bytes + GRANULE - 1) / GRANULE * GRANULE;
+        gBytes += int64_t(size) - int64_t(best->size);
+        best->mem.reset(new uint8_t[size + ALIGN - 1]);
+        best->data = (uint8_t*)((uintptr_t(best->mem.get()) + ALIGN - 1) & ~uintptr_t(ALIGN - 1));
+        best->size = size;
+        gAllocs++;
+    }
+    best->inUse = true;
+    return best->data;
+}
+
+void ScratchPool::release(void* p)
+{
+    for (Block& b : m_blocks) {
+        if (b.data == p) {
+            assert(b.inUse);
+            b.inUse = false;
+            return;
+        }
+    }
+    assert(false);
+}
+
+ScratchPool::Stats ScratchPool::GetStats()
+{
+    Stats stats;
+    stats.allocs = gAllocs;
+    stats.reuses = gReuses;
+    stats.bytes = gBytes;
+    return stats;
+}
+
+size_t ScratchPool::PeakRSS()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return pmc.PeakWorkingSetSize;
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+#ifdef __APPLE__
+        return size_t(usage.ru_maxrss);           // bytes on macOS
+#else
+        return size_t(usage.ru_maxrss) * 1024;    // kilobytes on Linux
+#endif
+    return 0;
+#endif
+}
+
+bool ScratchPool::Test()
+{
+    Stats before = GetStats();
+    const void* first = 0;
+    {
+        Scratch<int32_t> a(1000);
+        Scratch<uint8_t> b(100);
+        TEST(a.get() != (int32_t*)b.get());
+        TEST(uintptr_t(a.get()) % ALIGN == 0 && uintptr_t(b.get()) % ALIGN == 0);
+        memset(a.get(), 1, 4000);
+        first = a.get();
+    }
+    {
+        // Both blocks come back, and the bigger request gets the block that fits.
+        Scratch<int32_t> a(1000);
+        Scratch<uint8_t> b(10);
+        TEST(a.get() == first || b.get() == first);
+    }
+    Stats after = GetStats();
+    TEST(after.reuses - before.reuses >= 2);
+    TEST(PeakRSS() > 0);
+    return true;
+}
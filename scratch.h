@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+/*
+    Scratch memory for the build. Each thread has a pool of blocks that are
+    reused from one candidate encoding (and one file) to the next, instead
+    of a new and delete for every buffer. A pool keeps what it has been
+    given back, so a thread holds about its largest working set.
+*/
+class ScratchPool
+{
+public:
+    // The pool of the calling thread.
+    static ScratchPool& Thread();
+
+    static const size_t ALIGN = 16;
+
+    // At least 'bytes', ALIGN byte aligned (new[] alone only promises 8
+    // on some targets.)
+    void* acquire(size_t bytes);
+    void release(void* p);
+
+    struct Stats {
+        int64_t allocs = 0;     // blocks that had to be allocated
+        int64_t reuses = 0;     // requests met from a pool
+        int64_t bytes = 0;      // held by all the pools
+    };
+    static Stats GetStats();
+
+    // Peak resident memory of the process, in bytes. 0 if unknown.
+    static size_t PeakRSS();
+
+    static bool Test();
+
+private:
+    struct Block {
+        std::unique_ptr<uint8_t[]> mem;   // size + ALIGN - 1 bytes
+        uint8_t* data = 0;                  // in mem, aligned
+        size_t size = 0;
+        bool inUse = false;
+    };
+    std::vector<Block> m_blocks;
+};
+
+// A buffer of n T's from this thread's pool. Not initialized.
+template<class T>
+class Scratch
+{
+public:
+    explicit Scratch(size_t n) : m_p((T*)ScratchPool::Thread().acquire(n * sizeof(T))) {}
+    ~Scratch() { ScratchPool::Thread().release(m_p); }
+
+    T* get() const { return m_p; }
+    T& operator[](size_t i) const { return m_p[i]; }
+
+private:
+    Scratch(const Scratch&) = delete;
+    void operator=(const Scratch&) = delete;
+    T* m_p;
+};
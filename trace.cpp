@@ -0,0 +1,250 @@
+#include "trace.h"
+#include "enkits/TaskScheduler.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#define TEST(x) { if (!(x)) { assert(false); return false; }}
+
+namespace {
+    struct Event {
+        const char* name;
+        std::string arg;
+        int tid;
+        double ts;      // microseconds from Start()
+        double dur;
+    };
+
+    std::mutex gMutex;
+    std::vector<Event> gEvents;
+    std::map<int, std::string> gThreadNames;
+    std::atomic<bool> gEnabled(false);
+    std::chrono::steady_clock::time_point gStart;
+    std::atomic<int> gNextTid(0);
+
+    thread_local int tTid = -1;
+    thread_local double tIdleStart = -1;
+    thread_local double tWaitStart = -1;
+
+    double Now()
+    {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - gStart).count();
+    }
+
+    int ThreadId()
+    {
+        if (tTid < 0)
+            tTid = gNextTid++;
+        return tTid;
+    }
+
+    void Add(const char* name, const char* arg, double start)
+    {
+        Event e = { name, arg ? arg : "", ThreadId(), start, Now() - start };
+        std::lock_guard<std::mutex> lock(gMutex);
+        gEvents.push_back(std::move(e));
+    }
+
+    void AppendEscaped(std::string* out, const std::string& s)
+    {
+        for (char c : s) {
+            if (c == '"' || c == '\\') {
+                out->push_back('\\');
+                out->push_back(c);
+            }
+            else if ((unsigned char)c < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out->append(buf);
+            }
+            else {
+                out->push_back(c);
+            }
+        }
+    }
+
+    // The scheduler's callbacks. The thread number is the scheduler's; the
+    // trace uses its own ids, so the prefetch thread fits in too.
+    void OnThreadStart(uint32_t threadnum)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "worker %u", threadnum);
+        Trace::NameThread(name);
+    }
+    void OnSuspendStart(uint32_t) { tIdleStart = gEnabled ? Now() : -1; }
+    void OnSuspendStop(uint32_t)
+    {
+        if (gEnabled && tIdleStart >= 0)
+            Add("idle", 0, tIdleStart);
+        tIdleStart = -1;
+    }
+    void OnWaitStart(uint32_t) { tWaitStart = gEnabled ? Now() : -1; }
+    void OnWaitStop(uint32_t)
+    {
+        if (gEnabled && tWaitStart >= 0)
+            Add("wait", 0, tWaitStart);
+        tWaitStart = -1;
+    }
+}
+
+
+void Trace::Start()
+{
+    NameThread("main");
+    std::lock_guard<std::mutex> lock(gMutex);
+    gEvents.clear();
+    gStart = std::chrono::steady_clock::now();
+    gEnabled = true;
+}
+
+bool Trace::Enabled()
+{
+    return gEnabled;
+}
+
+void Trace::NameThread(const char* name)
+{
+    int tid = ThreadId();
+    std::lock_guard<std::mutex> lock(gMutex);
+    gThreadNames[tid] = name;
+}
+
+void Trace::Install(enki::ProfilerCallbacks* callbacks)
+{
+    callbacks->threadStart = OnThreadStart;
+    callbacks->waitForNewTaskSuspendStart = OnSuspendStart;
+    callbacks->waitForNewTaskSuspendStop = OnSuspendStop;
+    callbacks->waitForTaskCompleteStart = OnWaitStart;
+    callbacks->waitForTaskCompleteStop = OnWaitStop;
+}
+
+void Trace::Reset()
+{
+    gEnabled = false;
+    std::lock_guard<std::mutex> lock(gMutex);
+    gEvents.clear();
+}
+
+
+Trace::Scope::Scope(const char* name, const char* arg) : m_name(name), m_start(-1)
+{
+    if (gEnabled) {
+        if (arg)
+            m_arg = arg;
+        m_start = Now();
+    }
+}
+
+Trace::Scope::~Scope()
+{
+    if (m_start >= 0 && gEnabled)
+        Add(m_name, m_arg.c_str(), m_start);
+}
+
+
+std::string Trace::JSON()
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    std::string out = "{\"traceEvents\":[\n";
+    char buf[160];
+    // Only the threads that have events: the tests start and end threads too.
+    std::set<int> used;
+    for (const Event& e : gEvents)
+        used.insert(e.tid);
+    for (const auto& it : gThreadNames) {
+        if (!used.count(it.first))
+            continue;
+        snprintf(buf, sizeof(buf), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"", it.first);
+        out += buf;
+        AppendEscaped(&out, it.second);
+        out += "\"}},\n";
+    }
+    for (const Event& e : gEvents) {
+        snprintf(buf, sizeof(buf), "{\"name\":\"%s\",\"cat\":\"wav12ly\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.1f,\"dur\":%.1f",
+            e.name, e.tid, e.ts, e.dur);
+        out += buf;
+        if (!e.arg.empty()) {
+            out += ",\"args\":{\"file\":\"";
+            AppendEscaped(&out, e.arg);
+            out += "\"}";
+        }
+        out += "},\n";
+    }
+    // A closing entry, so every line above can end with a comma.
+    out += "{\"name\":\"end\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{}}\n]}\n";
+    return out;
+}
+
+
+bool Trace::Write(const char* path)
+{
+    const double wall = Now();
+    gEnabled = false;
+    std::string json = JSON();
+
+    FILE* fp = fopen(path, "wb");
+    bool okay = fp && fwrite(json.data(), json.size(), 1, fp) == 1;
+    if (fp && fclose(fp) != 0)
+        okay = false;
+    if (!okay) {
+        printf("Failed to write trace: %s\n", path);
+        return false;
+    }
+
+    // Time per phase, and how busy each thread was (not idle in the scheduler.)
+    std::lock_guard<std::mutex> lock(gMutex);
+    std::map<std::string, std::pair<double, int>> phases;
+    std::map<int, double> idle;
+    for (const Event& e : gEvents) {
+        auto& p = phases[e.name];
+        p.first += e.dur;
+        p.second++;
+        if (strcmp(e.name, "idle") == 0)
+            idle[e.tid] += e.dur;
+    }
+    printf("Trace: %d events over %.1f ms, written to %s\n", int(gEvents.size()), wall / 1000.0, path);
+    for (const auto& it : phases)
+        printf("  %-12s %10.1f ms %6d\n", it.first.c_str(), it.second.first / 1000.0, it.second.second);
+    for (const auto& it : gThreadNames) {
+        if (it.second.compare(0, 6, "worker") == 0)
+            printf("  %-12s %5.0f%% busy\n", it.second.c_str(), wall > 0 ? 100.0 * (1.0 - idle[it.first] / wall) : 0.0);
+    }
+    return true;
+}
+
+
+bool Trace::Test()
+{
+    {
+        Scope before("before");     // not recorded
+    }
+    Start();
+    TEST(Enabled());
+    {
+        Scope outer("outer");
+        Scope inner("inner", "dir\\file \"1\".wav");
+    }
+    std::string json = JSON();
+    Reset();
+    TEST(!Enabled());
+
+    TEST(json.find("\"before\"") == std::string::npos);
+    TEST(json.find("\"name\":\"outer\"") != std::string::npos);
+    TEST(json.find("\"name\":\"inner\"") != std::string::npos);
+    TEST(json.find("\"file\":\"dir\\\\file \\\"1\\\".wav\"") != std::string::npos);
+    TEST(json.find("\"args\":{\"name\":\"main\"}") != std::string::npos);
+    TEST(json.compare(0, 15, "{\"traceEvents\":") == 0);
+    TEST(json.compare(json.size() - 3, 3, "]}\n") == 0);
+    {
+        Scope after("after");       // stopped again
+    }
+    TEST(JSON().find("\"after\"") == std::string::npos);
+    return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+
+namespace enki { struct ProfilerCallbacks; }
+
+/*
+    Timings of the build, written as a Chrome trace (load it in
+    chrome://tracing or ui.perfetto.dev.) Nothing is recorded until
+    Start(); until then a Scope is one check of a flag.
+
+    The scheduler's profiler callbacks are hooked up by Install(), so the
+    trace also shows when each worker was idle, and the summary gives how
+    busy each thread was.
+*/
+class Trace
+{
+public:
+    static void Start();
+    static bool Enabled();
+    // Writes the JSON and prints a summary. Recording stops.
+    static bool Write(const char* path);
+    // Calls before Start() are fine; names are kept regardless.
+    static void NameThread(const char* name);
+    static void Install(enki::ProfilerCallbacks* callbacks);
+
+    // Times its own lifetime. 'name' has to outlive the trace (a literal);
+    // 'arg' (a file name, say) is copied.
+    class Scope
+    {
+    public:
+        Scope(const char* name, const char* arg = 0);
+        Scope(const char* name, const std::string& arg) : Scope(name, arg.c_str()) {}
+        ~Scope();
+
+    private:
+        const char* m_name;
+        std::string m_arg;
+        double m_start;
+    };
+
+    static std::string JSON();
+    static void Reset();
+    static bool Test();
+};
@@ -29,11 +29,13 @@
 
 using namespace wav12;
 
-void ExpanderAD4::init(::IStream* stream, const int32_t* table, int32_t predictor)
+void ExpanderAD4::init(::IStream* stream, const int32_t* table, int32_t predictor, int bits)
 {
     W12ASSERT(stream);
     W12ASSERT(table);
+    W12ASSERT(bits >= 2 && bits <= 4);
     m_stream = stream;
+    m_bits = bits;
     m_state.init(table, predictor);
     rewind();
 }
@@ -56,26 +58,67 @@ int ExpanderAD4::expand(int32_t *target, uint32_t nSamples, int32_t volume, bool
 
     assert((nSamples & 1) == 0);
 
-    uint32_t n = 0;
+    if (m_bits != 4)
+        return expandN(target, nSamples, volume, add);
+
+    return pull(target, nSamples, [&](const uint8_t* src, uint32_t n, int32_t* dst) {
+        S4ADPCM::decode4(src, n, volume, add, dst, &m_state);
+    });
+}
 
-    while(n < nSamples) {
-        int samplesWanted = std::min<int>(bytesToSamples(BUFFER_SIZE), nSamples - n);
-        int bytesWanted = samplesToBytes(samplesWanted);
-        uint32_t bytesFetched = m_stream->fetch(m_buffer, bytesWanted);
-        uint32_t samplesFetched = bytesToSamples(bytesFetched);
-        if (samplesFetched > nSamples - n)
-            samplesFetched = nSamples - n;  // because 2 samples a byte. The last one can be zero.
 
-        if (!bytesFetched)
+int ExpanderAD4::expandN(int32_t* target, uint32_t nSamples, int32_t volume, bool add)
+{
+    // Samples don't line up with bytes; the state keeps the bits left
+    // over from the last fetch. Only the bytes needed are fetched, and
+    // all of them are used.
+    uint32_t n = 0;
+    while (n < nSamples) {
+        int bitsWanted = int(nSamples - n) * m_bits - m_state.nBits;
+        int bytesWanted = std::min(int(BUFFER_SIZE), (bitsWanted + 7) / 8);
+        uint32_t bytesFetched = bytesWanted > 0 ? m_stream->fetch(m_buffer, bytesWanted) : 0;
+        uint32_t samples = std::min<uint32_t>(nSamples - n, (bytesFetched * 8 + m_state.nBits) / m_bits);
+        if (samples == 0)
             break;
 
-        S4ADPCM::decode4(m_buffer, samplesFetched, volume, add, target + intptr_t(n) * 2, &m_state);
-        n += samplesFetched;
+        S4ADPCM::decodeN(m_bits, m_buffer, samples, volume, add, target + intptr_t(n) * 2, &m_state);
+        n += samples;
     }
     return n;
 }
 
 
+void ExpanderIMA::init(::IStream* stream)
+{
+    W12ASSERT(stream);
+    m_stream = stream;
+    rewind();
+}
+
+void ExpanderIMA::rewind()
+{
+    m_state = IMAADPCM::State();
+    m_stream->rewind();
+}
+
+
+int ExpanderIMA::expand(int32_t* target, uint32_t nSamples, int32_t volume, bool add, bool overrideEasing)
+{
+    if (!m_stream)
+        return 0;
+
+    if (overrideEasing) {
+        m_state.volumeShifted = volume << 8;
+    }
+
+    assert((nSamples & 1) == 0);
+
+    return pull(target, nSamples, [&](const uint8_t* src, uint32_t n, int32_t* dst) {
+        IMAADPCM::decode(src, n, volume, add, dst, &m_state);
+    });
+}
+
+
 void ExpanderAD4::generateTestData(int nSamples, int16_t* data)
 {
     static const int32_t FREQ = 22050;
@@ -98,21 +141,27 @@ void ExpanderAD4::generateTestData(int nSamples, int16_t* data)
 }
 
 
-void ExpanderAD4::fillBuffer(int32_t* buffer, int nBufferSamples, ExpanderAD4* expanders, int nExpanders, const bool* loop, const int *volume, bool disableEasing)
+// Shared by both versions of fillBuffer(); 'get' returns expander i.
+template<typename GET>
+static void fillBufferT(int32_t* buffer, int nBufferSamples, GET get, int nExpanders, const bool* loop, const int* volume, bool disableEasing)
 {
     if (!buffer) return;
     if (nBufferSamples <= 0) return;
 
     for (int i = 0; i < nExpanders; ++i) {
-        ExpanderAD4* expander = expanders + i;
+        auto* expander = get(i);
 
         int n = 0;
         do {
             // 32 bit stereo buffer
             // annoying and inefficent, but that's what is working.
-            n += expander->expand(buffer + n * 2, nBufferSamples - n, volume[i], i > 0, disableEasing);
-            if (loop[i] && expander->done())
+            int got = expander->expand(buffer + n * 2, nBufferSamples - n, volume[i], i > 0, disableEasing);
+            n += got;
+            if (loop[i] && expander->done()) {
+                if (got == 0)
+                    break;  // an empty sound; rewinding would loop forever
                 expander->rewind();
+            }
         } while (n < nBufferSamples && loop[i]);
 
         if (i == 0) {
@@ -122,6 +171,16 @@ void ExpanderAD4::fillBuffer(int32_t* buffer, int nBufferSamples, ExpanderAD4* e
             }
         }
     }
+}
 
+
+void ExpanderAD4::fillBuffer(int32_t* buffer, int nBufferSamples, ExpanderAD4* expanders, int nExpanders, const bool* loop, const int *volume, bool disableEasing)
+{
+    fillBufferT(buffer, nBufferSamples, [&](int i) { return expanders + i; }, nExpanders, loop, volume, disableEasing);
 }
 
+
+void Expander::fillBuffer(int32_t* buffer, int nBufferSamples, Expander* const* expanders, int nExpanders, const bool* loop, const int* volume, bool disableEasing)
+{
+    fillBufferT(buffer, nBufferSamples, [&](int i) { return expanders[i]; }, nExpanders, loop, volume, disableEasing);
+}
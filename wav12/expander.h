@@ -24,6 +24,7 @@
 #define WAV_COMPRESSION
 
 #include "s4adpcm.h"
+#include "imaadpcm.h"
 #include "interface.h"
 
 #include <stdint.h>
@@ -32,21 +33,22 @@
 
 namespace wav12 {
 
-    class ExpanderAD4
+    // One sound being played, whatever its codec: what the mixer drives.
+    class Expander
     {
     public:
         static const int BUFFER_SIZE = 128;
 
-        ExpanderAD4() : m_state(nullptr, 0) {}
-        void init(IStream* stream, const int32_t* _table, int32_t _predictor);
+        virtual ~Expander() {}
 
         // Returns the number of samples it could expand. nSamples should be even.
         // Pulls samples from the IStream.
-        int expand(int32_t* target, uint32_t nSamples, int32_t volume, bool add, bool overrideEasing);
-
-        void rewind();
+        virtual int expand(int32_t* target, uint32_t nSamples, int32_t volume, bool add, bool overrideEasing) = 0;
+        virtual void rewind() = 0;
         bool done() const { return m_stream->done(); }
 
+        // For pull(): 4 bits per sample, as IMA and 4 bit S4 are. The 3 and
+        // 2 bit S4 modes don't line up with bytes, and use expandN().
         static int samplesToBytes(int n) {
             return (n + 1) / 2;
         }
@@ -55,6 +57,31 @@ namespace wav12 {
             return b * 2;
         }
 
+        // Fill a buffer from n expanders, of any codec. Will rewind() and loop as needed.
+        static void fillBuffer(int32_t* buffer, int bufferSamples,
+            Expander* const* expanders, int nExpanders,
+            const bool* loop, const int* volume,
+            bool disableEasing);
+
+    protected:
+        // Fetches from the stream a buffer at a time, and hands each to 'decode'.
+        template<typename DECODE>
+        int pull(int32_t* target, uint32_t nSamples, DECODE decode);
+
+        uint8_t m_buffer[BUFFER_SIZE];
+        IStream* m_stream = 0;
+    };
+
+    class ExpanderAD4 final : public Expander
+    {
+    public:
+        ExpanderAD4() : m_state(nullptr, 0) {}
+        // 'bits' is 4, 3, or 2. The table has to be for that mode (S4ADPCM::getTable(i, bits)).
+        void init(IStream* stream, const int32_t* _table, int32_t _predictor, int bits = 4);
+
+        int expand(int32_t* target, uint32_t nSamples, int32_t volume, bool add, bool overrideEasing) override;
+        void rewind() override;
+
         static void generateTestData(int nSamples, int16_t* data);
 
         // Fill a buffer from n exparenders. Will rewind() and loop as needed.
@@ -64,10 +91,43 @@ namespace wav12 {
             bool disableEasing);
 
     private:
-        uint8_t m_buffer[BUFFER_SIZE];
-        IStream* m_stream = 0;
+        int expandN(int32_t* target, uint32_t nSamples, int32_t volume, bool add);
+
         S4ADPCM::State m_state;
+        int m_bits = 4;
     };
+
+    class ExpanderIMA final : public Expander
+    {
+    public:
+        void init(IStream* stream);
+
+        int expand(int32_t* target, uint32_t nSamples, int32_t volume, bool add, bool overrideEasing) override;
+        void rewind() override;
+
+    private:
+        IMAADPCM::State m_state;
+    };
+
+    template<typename DECODE>
+    int Expander::pull(int32_t* target, uint32_t nSamples, DECODE decode)
+    {
+        uint32_t n = 0;
+        while (n < nSamples) {
+            int samplesWanted = std::min<int>(bytesToSamples(BUFFER_SIZE), nSamples - n);
+            int bytesWanted = samplesToBytes(samplesWanted);
+            uint32_t bytesFetched = m_stream->fetch(m_buffer, bytesWanted);
+            uint32_t samplesFetched = bytesToSamples(bytesFetched);
+            if (samplesFetched > nSamples - n)
+                samplesFetched = nSamples - n;  // because 2 samples a byte. The last one can be zero.
+
+            if (!bytesFetched)
+                break;
+
+            decode(m_buffer, samplesFetched, target + intptr_t(n) * 2);
+            n += samplesFetched;
+        }
+        return n;
+    }
 }
 #endif
-    
\ No newline at end of file
@@ -0,0 +1,73 @@
+/*
+  Copyright (c) Lee Thomason, Grinning Lizard Software
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#include "imaadpcm.h"
+
+const int8_t IMAADPCM::INDEX_TABLE[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8,
+};
+
+const int16_t IMAADPCM::STEPSIZE_TABLE[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+void IMAADPCM::decode(const uint8_t* p, int32_t nSamples,
+    int32_t volume,
+    bool add,
+    int32_t* out, State* state)
+{
+    W12ASSERT((nSamples & 1) == 0);
+    state->volumeTarget = volume << 8;
+
+    const uint8_t* end = p + nSamples / 2;
+    while (p < end) {
+        // High nibble first.
+        const int delta = (*p >> ((1 - state->high) << 2)) & 0x0f;
+        p += state->high;
+
+        const int32_t step = STEPSIZE_TABLE[state->index];
+        int32_t vpdiff = step >> 3;
+        if (delta & 4) vpdiff += step;
+        if (delta & 2) vpdiff += step >> 1;
+        if (delta & 1) vpdiff += step >> 2;
+        state->valprev += (delta & 8) ? -vpdiff : vpdiff;
+        state->valprev = fastClamp<int32_t>(state->valprev, SHRT_MIN, SHRT_MAX);
+        state->index = fastClamp<int32_t>(state->index + INDEX_TABLE[delta], 0, 88);
+
+        state->volumeShifted += VOLUME_EASING * fastSign(state->volumeTarget - state->volumeShifted);
+
+        int32_t s = S4ADPCM::sat_mult(state->valprev, state->volumeShifted);
+        out[0] = out[1] = add ? S4ADPCM::sat_add(s, out[0]) : s;
+        out += 2;
+
+        state->high = (~state->high) & 1;
+    }
+}
@@ -0,0 +1,57 @@
+/*
+  Copyright (c) Lee Thomason, Grinning Lizard Software
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to
+  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+  of the Software, and to permit persons to whom the Software is furnished to do
+  so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+#pragma once
+
+#include "s4adpcm.h"
+
+#include <stdint.h>
+
+/*
+    IMA (Intel/DVI) ADPCM decoder, for the files where it beats S4ADPCM on
+    error. Same 4 bits per sample, high nibble first, and the same output
+    as S4ADPCM::decode4(): 16.16 stereo with volume easing. The encoder is
+    the tool's encodeADPCM() (codec.cpp); the output matches its
+    decodeADPCM() exactly.
+*/
+class IMAADPCM
+{
+public:
+    struct State {
+        int high = false;
+        int32_t valprev = 0;
+        int32_t index = 0;
+        int32_t volumeShifted = 0;
+        int32_t volumeTarget = 0;
+    };
+
+    static void decode(const uint8_t* compressed,
+                       int32_t nSamples,
+                       int32_t volume, // 256 is neutral; normally 0-256. Above 256 can boost & clip.
+                       bool add,       // if true, add to the 'data' buffer, else write to it
+                       int32_t* samples, State* state);
+
+private:
+    static const int32_t VOLUME_EASING = 32;
+    static const int8_t INDEX_TABLE[16];
+    static const int16_t STEPSIZE_TABLE[89];
+};
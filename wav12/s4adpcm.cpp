@@ -73,18 +73,43 @@ const int32_t S4ADPCM::STEP[16] = {
 #endif
 };
 
-int S4ADPCM::encode4(const int16_t* data, int32_t nSamples, uint8_t* target, State* state)
+const int32_t S4ADPCM::DELTA_TABLE_3[N_TABLES_3][TABLE_SIZE_3] = {
+    {-1, 0, 0, 1, 2},
+    {-1, 0, 1, 1, 2},
+    {-1, -1, 0, 1, 2},
+};
+
+const int32_t S4ADPCM::STEP_3[8] = {
+    -8, -4, -2, 0, 2, 4, 8, 12
+};
+
+const int32_t S4ADPCM::DELTA_TABLE_2[N_TABLES_2][TABLE_SIZE_2] = {
+    {-1, 1},
+    {-1, 2},
+    {0, 1},
+};
+
+// No zero: the shift brings the steps down to +/- 1 in quiet parts.
+const int32_t S4ADPCM::STEP_2[4] = {
+    -3, -1, 1, 3
+};
+
+int S4ADPCM::encode4(const int16_t* data, int32_t nSamples, uint8_t* target, State* state, int32_t noiseShape)
 {
     W12ASSERT(STEP[ZERO_INDEX] == 0);
     W12ASSERT((nSamples & 1) == 0);     // even number. not sure the odd is handled?
     W12ASSERT(fastSign(5) == 1);
     W12ASSERT(fastSign(-287) == -1);
     W12ASSERT(fastSign(0) == 0);
+    W12ASSERT(noiseShape >= -MAX_NOISE_SHAPE && noiseShape <= MAX_NOISE_SHAPE);
 
     const uint8_t* start = target;
     for (int i = 0; i < nSamples; ++i) {
         const int32_t guess = state->guess();
         const int32_t mult = 1 << state->shift;
+        int32_t want = data[i];
+        if (noiseShape)
+            want = fastClamp<int32_t>(want - state->shapeErr * noiseShape / 4, SHRT_MIN, SHRT_MAX);
 
         // Search for minimum error. We are searching
         // for the best 'index' into the STEP table.
@@ -92,7 +117,7 @@ int S4ADPCM::encode4(const int16_t* data, int32_t nSamples, uint8_t* target, Sta
         uint8_t index = ZERO_INDEX;
         for (int j = 0; j < 16; ++j) {
             int32_t s = guess + mult * STEP[j];
-            int32_t e = abs(s - data[i]);
+            int32_t e = abs(s - want);
 
             // Tried to do read ahead to reduce error,
             // but in only made a very small improvement
@@ -110,9 +135,13 @@ int S4ADPCM::encode4(const int16_t* data, int32_t nSamples, uint8_t* target, Sta
         else
             *target = index;
 
-        state->push(guess + STEP[index] * mult);
+        const int32_t value = guess + STEP[index] * mult;
+        state->push(value);
         state->doShift(index);
         state->high = state->high ? 0 : 1;
+        // The decoder clamps, so the error is from the clamped value.
+        if (noiseShape)
+            state->shapeErr = fastClamp<int32_t>(value, SHRT_MIN, SHRT_MAX) - want;
     }
     if (state->high) target++;
     return int(target - start);
@@ -133,7 +162,7 @@ void S4ADPCM::decode4(const uint8_t* p, int32_t nSamples,
         p += state->high;
         const int32_t mult = 1 << state->shift;
         const int32_t guess = state->guess();
-        const int32_t value = guess + STEP[index] * mult;
+        const int32_t value = wrapAdd(guess, STEP[index] * mult);
 
         state->push(value);
 
@@ -151,3 +180,82 @@ void S4ADPCM::decode4(const uint8_t* p, int32_t nSamples,
     }
 }
 
+
+
+int S4ADPCM::encodeN(int bits, const int16_t* data, int32_t nSamples, uint8_t* target, State* state)
+{
+    W12ASSERT(bits == 3 || bits == 2);
+    const int32_t* step = bits == 3 ? STEP_3 : STEP_2;
+    const int nSteps = 1 << bits;
+
+    const uint8_t* start = target;
+    for (int i = 0; i < nSamples; ++i) {
+        const int32_t guess = state->guess();
+        const int32_t mult = 1 << state->shift;
+
+        int bestE = INT_MAX;
+        int index = 0;
+        for (int j = 0; j < nSteps; ++j) {
+            int32_t e = abs(guess + mult * step[j] - data[i]);
+            if (e < bestE) {
+                bestE = e;
+                index = j;
+                if (e == 0) break;
+            }
+        }
+        state->bitBuf |= uint32_t(index) << state->nBits;
+        state->nBits += bits;
+        while (state->nBits >= 8) {
+            *target++ = uint8_t(state->bitBuf);
+            state->bitBuf >>= 8;
+            state->nBits -= 8;
+        }
+
+        state->push(guess + step[index] * mult);
+        state->doShiftN(index, bits);
+    }
+    return int(target - start);
+}
+
+int S4ADPCM::flushN(uint8_t* target, State* state)
+{
+    if (state->nBits == 0)
+        return 0;
+    *target = uint8_t(state->bitBuf);
+    state->bitBuf = 0;
+    state->nBits = 0;
+    return 1;
+}
+
+void S4ADPCM::decodeN(int bits, const uint8_t* p, int32_t nSamples,
+    int32_t volume,
+    bool add,
+    int32_t* out, State* state)
+{
+    W12ASSERT(bits == 3 || bits == 2);
+    const int32_t* step = bits == 3 ? STEP_3 : STEP_2;
+    const uint32_t mask = (1 << bits) - 1;
+    state->volumeTarget = volume << 8;
+
+    for (int i = 0; i < nSamples; ++i) {
+        if (state->nBits < bits) {
+            state->bitBuf |= uint32_t(*p++) << state->nBits;
+            state->nBits += 8;
+        }
+        const int index = state->bitBuf & mask;
+        state->bitBuf >>= bits;
+        state->nBits -= bits;
+
+        const int32_t mult = 1 << state->shift;
+        const int32_t value = wrapAdd(state->guess(), step[index] * mult);
+        state->push(value);
+
+        state->volumeShifted += VOLUME_EASING * fastSign(state->volumeTarget - state->volumeShifted);
+
+        int32_t s = sat_mult(fastClamp<int32_t>(value, SHRT_MIN, SHRT_MAX), state->volumeShifted);
+        out[0] = out[1] = add ? sat_add(s, out[0]) : s;
+        out += 2;
+
+        state->doShiftN(index, bits);
+    }
+}
@@ -40,6 +40,12 @@ inline int32_t fastSign(int32_t x) {
     return int32_t((uint32_t(-x) >> 31) - (uint32_t(x) >> 31));
 }
 
+// Two's complement add, as the hardware does it. Only a corrupt stream
+// gets the predictor near overflow, and this keeps that case defined.
+inline int32_t wrapAdd(int32_t a, int32_t b) {
+    return int32_t(uint32_t(a) + uint32_t(b));
+}
+
 // I'd prefer std::clamp, but not confident of arduino tools
 template<typename T>
 inline T fastClamp(T x, T lo, T hi) {
@@ -88,6 +94,9 @@ class S4ADPCM
 public:
     static const int ZERO_INDEX = 8;
     static const int TABLE_SIZE = 9;
+    static const int ZERO_INDEX_3 = 3;
+    static const int TABLE_SIZE_3 = 5;
+    static const int TABLE_SIZE_2 = 2;
 
     struct State {
         static constexpr int32_t PREDICTOR = 2;
@@ -108,6 +117,9 @@ public:
         int32_t shift = 0;
         int32_t volumeShifted = 0;
         int32_t volumeTarget = 0;
+        uint32_t bitBuf = 0;    // 3 and 2 bit modes: bits read (or written) but not yet used
+        int32_t nBits = 0;
+        int32_t shapeErr = 0;   // encoder only: last quantization error, for noise shaping
 
         int32_t guess() const {
             // I have experimented and it is mysterious.
@@ -126,7 +138,11 @@ public:
             //  prev1 + (prev1 - prev2) * 3 / 4
             //  TotalError = 558  SimpleError = 18137 hum = 18.5 shh01 = 74.5
             //
-            return prev1 + (prev1 - prev2) * predictor / 4;
+            return predict(prev1, prev2, predictor);
+        }
+        static int32_t predict(int32_t prev1, int32_t prev2, int32_t predictor) {
+            const int32_t d = int32_t((uint32_t(prev1) - uint32_t(prev2)) * uint32_t(predictor));
+            return wrapAdd(prev1, d / 4);
         }
         inline void push(int32_t value) {
             prev2 = prev1;
@@ -140,9 +156,25 @@ public:
             int delta = abs(index - ZERO_INDEX); // 0 - 8
             shift = fastClamp(shift + table[delta], int32_t(0), SHIFT_LIMIT_4);
         }
+
+        // The 3 and 2 bit modes: 'table' is a DELTA_TABLE_3 or _2.
+        inline void doShiftN(int index, int bits) {
+            int delta = bits == 3 ? abs(index - ZERO_INDEX_3)       // 0 - 4
+                                  : (index == 0 || index == 3);     // 0 - 1
+            shift = fastClamp(shift + table[delta], int32_t(0), SHIFT_LIMIT_4);
+        }
     };
 
-    static int encode4(const int16_t* data, int32_t nSamples, uint8_t* compressed, State* state);
+    /*
+        noiseShape is error feedback, in quarters (-3 to 3): the last
+        quantization error is subtracted from the next target, so the
+        noise becomes e[n] - noiseShape/4 * e[n-1]. Positive moves the noise
+        up in frequency, negative moves it down. More noise overall, but
+        it can be put where it is masked. 0 is off. Only the encoder
+        changes; the stream is ordinary S4 for decode4().
+    */
+    static const int MAX_NOISE_SHAPE = 3;
+    static int encode4(const int16_t* data, int32_t nSamples, uint8_t* compressed, State* state, int32_t noiseShape = 0);
     static void decode4(const uint8_t *compressed,
                         int32_t nSamples,
                         int32_t volume, // 256 is neutral; normally 0-256. Above 256 can boost & clip.
@@ -154,10 +186,41 @@ public:
         return DELTA_TABLE_4[i];
     }
 
+    /*
+        3 and 2 bit modes, for sounds (hums, ambience) where the quality
+        of 4 bits isn't needed. Same predictor and shift scheme, with
+        their own STEP and DELTA tables. Samples are packed in a little
+        endian bit stream: 8 samples in 3 bytes, or 4 in 1 byte. Byte
+        boundaries don't have to line up with calls; the State carries
+        the left over bits. encodeN() returns the whole bytes written,
+        and flushN() writes the last partial byte (0 or 1 bytes.)
+    */
+    static int encodeN(int bits, const int16_t* data, int32_t nSamples, uint8_t* compressed, State* state);
+    static int flushN(uint8_t* compressed, State* state);
+    static void decodeN(int bits,
+                        const uint8_t* compressed,
+                        int32_t nSamples,
+                        int32_t volume,
+                        bool add,
+                        int32_t* samples, State* state);
+
+    static int numTables(int bits) {
+        return bits == 4 ? N_TABLES : bits == 3 ? N_TABLES_3 : N_TABLES_2;
+    }
+    static const int32_t* getTable(int i, int bits) {
+        assert(i >= 0 && i < numTables(bits));
+        return bits == 4 ? DELTA_TABLE_4[i] : bits == 3 ? DELTA_TABLE_3[i] : DELTA_TABLE_2[i];
+    }
+    // Samples are padded to a multiple of this, so the bytes come out even.
+    static int sampleGroup(int bits) {
+        return bits == 4 ? 2 : bits == 3 ? 8 : 4;
+    }
+
 private:
-    static const int32_t SHIFT_LIMIT_4 = 14;
     static const int32_t VOLUME_EASING = 32;    // 8, 16, 32, 64? initial test on powerOn sound seemed 32 was good.
 
+public:
+    // Also used by the IMA decoder.
     inline static int32_t sat_mult(int32_t a, int32_t b)
     {
         return (int32_t) fastClamp<int64_t>(int64_t(a) * int64_t(b), INT32_MIN, INT32_MAX);
@@ -188,4 +251,13 @@ public:
     static const int N_TABLES = 6;
     static const int32_t DELTA_TABLE_4[N_TABLES][TABLE_SIZE];
     static const int32_t STEP[16];
+    static const int32_t SHIFT_LIMIT_4 = 14;
+
+    static const int N_TABLES_3 = 3;
+    static const int32_t DELTA_TABLE_3[N_TABLES_3][TABLE_SIZE_3];
+    static const int32_t STEP_3[8];
+
+    static const int N_TABLES_2 = 3;
+    static const int32_t DELTA_TABLE_2[N_TABLES_2][TABLE_SIZE_2];
+    static const int32_t STEP_2[4];
 };
@@ -1,4 +1,5 @@
 #include <stdint.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <memory.h>
 #include <string.h>
@@ -13,13 +14,23 @@
 
 extern "C" {
 #include "wave_reader.h"
-#include "wave_writer.h"
 }
 
 #include "tinyxml2.h"
 #include "memimage.h"
 #include "wavutil.h"
 #include "codec.h"
+#include "imagefit.h"
+#include "preprocess.h"
+#include "imagepatch.h"
+#include "prefetch.h"
+#include "scratch.h"
+#include "errormetric.h"
+#include "s4lanes.h"
+#include "trace.h"
+#include "cyclemodel.h"
+#include "golden.h"
+#include "buildplan.h"
 #include "enkits/TaskScheduler.h"
 
 #include "./wav12/expander.h"
@@ -28,50 +39,44 @@ using namespace wav12;
 using namespace tinyxml2;
 
 bool runTest(wave_reader* wr);
-int parseXML(const std::vector<std::string>& files, const std::string& inputPath, bool textFile);
 
-void saveOut(const char* fname, const int32_t* stereo, int nSamples)
+int parseXML(const std::vector<std::string>& files, const BuildOptions& options);
+int verifyText(const char* name);
+int diffImages(const char* oldName, const char* newName, const char* patchName);
+int inspectImage(const char* name, const char* outPath, const std::vector<std::string>& select);
+
+bool readFile(const char* name, std::vector<uint8_t>* data)
 {
-    int16_t* s16 = new int16_t[nSamples];
-    for (int i = 0; i < nSamples; ++i) {
-        s16[i] = stereo[i * 2] / 65536;
+    FILE* fp = fopen(name, "rb");
+    if (!fp) {
+        printf("Failed to open: %s\n", name);
+        return false;
     }
-
-    wave_writer_format writeFormat = { 1, 22050, 16 };
-    wave_writer_error error = WW_NO_ERROR;
-    wave_writer* ww = wave_writer_open(fname, &writeFormat, &error);
-    wave_writer_put_samples(ww, nSamples, (void*)s16);
-    wave_writer_close(ww, &error);
-
-    delete[] s16;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    data->resize(size > 0 ? size : 0);
+    size_t n = data->empty() ? 0 : fread(data->data(), data->size(), 1, fp);
+    fclose(fp);
+    return n == 1;
 }
 
-void compressAndCalcErrorADPCM(const int16_t* samples, int nSamples, int32_t* aveError2)
+// IMA ADPCM at the same 4 bits per sample, for comparison.
+int32_t errorADPCM(const int16_t* samples, int nSamples, ErrorMetric metric)
 {
-    int nCompressed = nSamples / 2;
-    uint8_t* compressed = new uint8_t[nCompressed];
-
     CodecState state = { 0, 0 };
-    encodeADPCM(&state, samples, nSamples, compressed);
-
-    int16_t* mono = new int16_t[nSamples];
-    state.index = 0;
-    state.valprev = 0;
-    decodeADPCM(&state, compressed, nSamples, mono);
-
-    if (aveError2) {
-        int64_t error2 = 0;
-        for (int i = 0; i < nSamples; ++i) {
-            int16_t s0 = samples[i];
-            int16_t s1 = mono[i];
-            int64_t d = int64_t(s0) - int64_t(s1);
-            error2 += d * d;
-        }
-        *aveError2 = int32_t(error2 / nSamples);
-    }
-
-    delete[] compressed;
-    delete[] mono;
+    if (metric == ErrorMetric::MSE)
+        return int32_t(errorADPCM(&state, samples, nSamples) / nSamples);
+
+    // The other metrics need the decoded samples.
+    Scratch<uint8_t> compressed(nSamples / 2);
+    Scratch<int16_t> decoded(nSamples);
+    encodeADPCM(&state, samples, nSamples, compressed.get());
+    state.init();
+    decodeADPCM(&state, compressed.get(), nSamples, decoded.get());
+    ErrorAccum accum(metric);
+    accum.add(samples, decoded.get(), nSamples);
+    return accum.result();
 }
 
 void printTable(const int* t)
@@ -88,13 +93,14 @@ void printTable(const int* t)
         t[8]);
 }
 
-void optimizeTable(const int16_t* samples, int nSamples)
+void optimizeTable(const int16_t* samples, int nSamples, ErrorMetric metric)
 {
     W12ASSERT((nSamples & 1) == 0);
     int nCompressed = nSamples / 2;
 
     int table[S4ADPCM::TABLE_SIZE] = { -1, 0, 0, 0, 1, 1, 1, 2, 2 };
     int32_t* stereo = new int32_t[nSamples * 2];
+    int16_t* decoded = new int16_t[nSamples];
     uint8_t* compressed = new uint8_t[nCompressed];
     int bestError = INT_MAX;
 
@@ -121,28 +127,65 @@ void optimizeTable(const int16_t* samples, int nSamples)
 
         ExpanderAD4::fillBuffer(stereo, nSamples, &expander, 1, &loop, &volume, true);
 
-        int64_t error2 = 0;
-        for (int i = 0; i < nSamples; ++i) {
-            int16_t s0 = samples[i];
-            int16_t s1 = int16_t(stereo[i * 2] / 65536);
-            int64_t d = int64_t(s0) - int64_t(s1);
-            error2 += d * d;
-        }
-        int32_t aveError2 = int32_t(error2 / nSamples);
-        if (aveError2 < bestError) {
-            bestError = aveError2;
+        WavWriter::NarrowStereo32(stereo, nSamples, decoded);
+        ErrorAccum accum(metric);
+        accum.add(samples, decoded, nSamples);
+        int32_t err = accum.result();
+        if (err < bestError) {
+            bestError = err;
 
-            printf("ave-err=%d ", bestError);
+            printf("%s=%d ", ErrorMetricName(metric), bestError);
             printTable(table);
             printf("\n");
         }
     }
     delete[] stereo;
+    delete[] decoded;
     delete[] compressed;
 }
 
 #define USE_MT() 1
 
+enki::TaskScheduler& taskScheduler()
+{
+    static enki::TaskScheduler scheduler;
+    static bool initialized = false;
+    if (!initialized) {
+        // The trace callbacks do nothing unless tracing has started.
+        enki::TaskSchedulerConfig config;
+        Trace::Install(&config.profilerCallbacks);
+        scheduler.Initialize(config);
+        initialized = true;
+    }
+    return scheduler;
+}
+
+// printf(), or added to 'log' if there is one.
+static void report(std::string* log, const char* format, ...)
+{
+    char buf[512];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (log)
+        log->append(buf);
+    else
+        fputs(buf, stdout);
+}
+
+struct ADPCMTask : enki::ITaskSet
+{
+    const int16_t* samples = 0;
+    int nSamples = 0;
+    ErrorMetric metric = ErrorMetric::MSE;
+    int32_t aveError2 = 0;
+    void ExecuteRange(enki::TaskSetPartition range_, uint32_t threadnum_) override {
+        Trace::Scope scope("ima");
+        aveError2 = errorADPCM(samples, nSamples, metric);
+    }
+};
+
 struct CompressTask : enki::ITaskSet
 {
     EncodedStream es;
@@ -150,111 +193,281 @@ struct CompressTask : enki::ITaskSet
     int nSamples = 0;
     int table = 0;
     int predictor = 0;
+    int bits = 4;
+    ErrorMetric metric = ErrorMetric::MSE;
+    int noiseShape = 0;
     void ExecuteRange(enki::TaskSetPartition range_, uint32_t threadnum_) override {
-        this->es = compressS4(samples, nSamples, table, predictor);
+        Trace::Scope scope("lowbits");
+        es.nSamples = nSamples;
+        es.table = table;
+        es.predictor = predictor;
+        es.aveError2 = errorS4(samples, nSamples, table, predictor, bits, metric, noiseShape);
     }
 };
 
-EncodedStream compressGroup(const int16_t* samples, int nSamples)
+// S4Lanes::LANES of the 4 bit candidates, in one pass.
+struct CandidateTask : enki::ITaskSet
 {
-    static constexpr int32_t N = S4ADPCM::N_TABLES * S4ADPCM::State::N_PREDICTOR;
-#if USE_MT()
-    CompressTask esArr[N];
-
-    static enki::TaskScheduler taskScheduler;
-    static bool initialized = false;
-    if (!initialized) {
-        taskScheduler.Initialize();
-        initialized = true;
+    const int16_t* samples = 0;
+    int nSamples = 0;
+    const S4Candidate* candidates = 0;
+    int nCandidates = 0;
+    ErrorMetric metric = ErrorMetric::MSE;
+    int noiseShape = 0;
+    int32_t* errors = 0;
+    void ExecuteRange(enki::TaskSetPartition range_, uint32_t threadnum_) override {
+        Trace::Scope scope("candidates");
+        S4Lanes::EncodeErrors(samples, nSamples, candidates, nCandidates, metric, noiseShape, errors);
     }
-#else
-    EncodedStream esArr[N];
-#endif
+};
 
-    int32_t errADPCM = 0;
-    compressAndCalcErrorADPCM(samples, nSamples, &errADPCM);
+EncodedStream compressIMA(const int16_t* samples, int nSamples)
+{
+    W12ASSERT((nSamples & 1) == 0);
+    EncodedStream es;
+    es.nSamples = nSamples;
+    es.nCompressed = nSamples / 2;
+    es.codec = MemUnit::CODEC_IMA;
+    es.compressed = std::make_unique<uint8_t[]>(es.nCompressed);
+
+    CodecState state = { 0, 0 };
+    encodeADPCM(&state, samples, nSamples, es.compressed.get());
+    es.aveError2 = errorADPCM(samples, nSamples, ErrorMetric::MSE);
+    return es;
+}
 
-    for (int table = 0; table < S4ADPCM::N_TABLES; table++) {
-        for (int pre = 0; pre < S4ADPCM::State::N_PREDICTOR; pre++) {
-            int i = table * S4ADPCM::State::N_PREDICTOR + pre;
+// The best table and predictor of a 3 or 2 bit mode. Returns its error.
+static int32_t bestLowBits(const int16_t* samples, int nSamples, int bits, int* table, int* predictor)
+{
+    static constexpr int32_t MAX_N = S4ADPCM::N_TABLES * S4ADPCM::State::N_PREDICTOR;
+    const int n = S4ADPCM::numTables(bits) * S4ADPCM::State::N_PREDICTOR;
+    W12ASSERT(n <= MAX_N);
 #if USE_MT()
-            esArr[i].samples = samples;
-            esArr[i].nSamples = nSamples;
-            esArr[i].table = table;
-            esArr[i].predictor = pre;
-            taskScheduler.AddTaskSetToPipe(&esArr[i]);
+    CompressTask esArr[MAX_N];
+    for (int i = 0; i < n; ++i) {
+        esArr[i].samples = samples;
+        esArr[i].nSamples = nSamples;
+        esArr[i].table = i / S4ADPCM::State::N_PREDICTOR;
+        esArr[i].predictor = i % S4ADPCM::State::N_PREDICTOR;
+        esArr[i].bits = bits;
+        taskScheduler().AddTaskSetToPipe(&esArr[i]);
+    }
+    for (int i = 0; i < n; ++i)
+        taskScheduler().WaitforTask(&esArr[i], enki::TASK_PRIORITY_HIGH);
 #else
-            esArr[i] = compressS4(samples, nSamples, table, pre);
-#endif
-        }
+    EncodedStream esArr[MAX_N];
+    for (int i = 0; i < n; ++i) {
+        esArr[i].table = i / S4ADPCM::State::N_PREDICTOR;
+        esArr[i].predictor = i % S4ADPCM::State::N_PREDICTOR;
+        esArr[i].aveError2 = errorS4(samples, nSamples, esArr[i].table, esArr[i].predictor, bits);
     }
-#if USE_MT()
-    taskScheduler.WaitforAll();
 #endif
-
     int32_t bestErr = std::numeric_limits<int32_t>::max();
-    int best = 0;
-    for (int i = 0; i < N; ++i) {
+    for (int i = 0; i < n; ++i) {
 #if USE_MT()
         const EncodedStream& es = esArr[i].es;
 #else
         const EncodedStream& es = esArr[i];
 #endif
-        printf("Table=%d Predictor=%d Error: %10d ADPCM: %d\n", es.table, es.predictor, es.aveError2, errADPCM);
         if (es.aveError2 < bestErr) {
             bestErr = es.aveError2;
-            best = i;
+            *table = es.table;
+            *predictor = es.predictor;
         }
     }
+    return bestErr;
+}
+
+EncodedStream compressGroup(const int16_t* samples, int nSamples, const CompressOptions& options, std::string* log)
+{
+    const bool tryADPCM = options.tryADPCM;
+    const int maxError = options.maxError;
+    const ErrorMetric metric = options.metric;
+
+    static constexpr int32_t N = S4ADPCM::N_TABLES * S4ADPCM::State::N_PREDICTOR;
+    S4Candidate candidates[N];
+    int32_t errors[N];
+    for (int i = 0; i < N; ++i) {
+        candidates[i].table = S4ADPCM::getTable(i / S4ADPCM::State::N_PREDICTOR);
+        candidates[i].predictor = i % S4ADPCM::State::N_PREDICTOR;
+    }
+
+    // IMA ADPCM is a candidate too, and runs alongside the S4 ones.
 #if USE_MT()
-    return std::move(esArr[best].es);
+    ADPCMTask adpcmTask;
+    adpcmTask.samples = samples;
+    adpcmTask.nSamples = nSamples;
+    adpcmTask.metric = metric;
+    if (tryADPCM)
+        taskScheduler().AddTaskSetToPipe(&adpcmTask);
 #else
-    return std::move(esArr[best]);
+    int32_t errADPCM = tryADPCM ? errorADPCM(samples, nSamples, metric) : 0;
 #endif
+
+    // With AVX2, up to LANES candidates run in one pass over the samples;
+    // they are spread so every thread gets some. Without it, a lane costs
+    // a candidate's worth of work, so each candidate is its own task.
+#if USE_MT()
+    const int nThreads = int(taskScheduler().GetNumTaskThreads());
+    const int perTask = CpuHasAVX2() ? std::min(int(S4Lanes::LANES), std::max(1, (N + nThreads - 1) / nThreads)) : 1;
+    CandidateTask tasks[N];
+#else
+    const int perTask = S4Lanes::LANES;
+#endif
+    int nTasks = 0;
+    for (int first = 0; first < N; first += perTask, ++nTasks) {
+        const int n = std::min(perTask, N - first);
+#if USE_MT()
+        tasks[nTasks].samples = samples;
+        tasks[nTasks].nSamples = nSamples;
+        tasks[nTasks].candidates = candidates + first;
+        tasks[nTasks].nCandidates = n;
+        tasks[nTasks].metric = metric;
+        tasks[nTasks].noiseShape = options.noiseShape;
+        tasks[nTasks].errors = errors + first;
+        taskScheduler().AddTaskSetToPipe(&tasks[nTasks]);
+#else
+        S4Lanes::EncodeErrors(samples, nSamples, candidates + first, n, metric, options.noiseShape, errors + first);
+#endif
+    }
+#if USE_MT()
+    // Only these tasks, running only high priority work meanwhile: files
+    // are low priority, so a thread doesn't start a second one here.
+    for (int t = 0; t < nTasks; ++t)
+        taskScheduler().WaitforTask(&tasks[t], enki::TASK_PRIORITY_HIGH);
+    taskScheduler().WaitforTask(&adpcmTask, enki::TASK_PRIORITY_HIGH);
+    int32_t errADPCM = adpcmTask.aveError2;
+#endif
+
+    int32_t bestErr = std::numeric_limits<int32_t>::max();
+    int best = 0;
+    for (int i = 0; i < N; ++i) {
+        const int table = i / S4ADPCM::State::N_PREDICTOR;
+        const int predictor = i % S4ADPCM::State::N_PREDICTOR;
+        if (tryADPCM)
+            report(log, "Table=%d Predictor=%d %s: %10d ADPCM: %d\n", table, predictor, ErrorMetricName(metric), errors[i], errADPCM);
+        else
+            report(log, "Table=%d Predictor=%d %s: %10d\n", table, predictor, ErrorMetricName(metric), errors[i]);
+        if (errors[i] < bestErr) {
+            bestErr = errors[i];
+            best = i;
+        }
+    }
+
+    // If 2 or 3 bits keep the error under maxError (RMS), use the fewest.
+    // maxError is always MSE; the 4 bit errors are a quick lower bound when
+    // they are too.
+    const int64_t maxError2 = int64_t(maxError) * int64_t(maxError);
+    const bool lowBits = metric != ErrorMetric::MSE || std::min(bestErr, tryADPCM ? errADPCM : bestErr) <= maxError2;
+    if (maxError > 0 && lowBits) {
+        for (int bits = 2; bits <= 3; ++bits) {
+            int table = 0, predictor = 0;
+            int32_t err = bestLowBits(samples, nSamples, bits, &table, &predictor);
+            report(log, "%d bit: table=%d predictor=%d error=%d (max %lld)\n", bits, table, predictor, err, (long long)maxError2);
+            if (err <= maxError2) {
+                Trace::Scope scope("encode");
+                return compressS4(samples, nSamples, table, predictor, bits);
+            }
+        }
+    }
+
+    // Only the candidates' errors were kept; encode the winner for real.
+    Trace::Scope scope("encode");
+    if (tryADPCM && errADPCM < bestErr) {
+        report(log, "IMA ADPCM wins: error %d vs %d\n", errADPCM, bestErr);
+        return compressIMA(samples, nSamples);
+    }
+    return compressS4(samples, nSamples, best / S4ADPCM::State::N_PREDICTOR, best % S4ADPCM::State::N_PREDICTOR, 4, options.noiseShape);
 }
 
 
-EncodedStream compressS4(const int16_t* samples, int nSamples, int table, int32_t predictor)
+// Error of the decoded S4 data vs. the source. Decodes a block at a time,
+// so the only memory is one small stereo buffer.
+static int32_t errorOfS4(const int16_t* samples, int nSamples, const uint8_t* compressed, int nCompressed, int table, int predictor, int bits, ErrorMetric metric)
+{
+    static const int BLOCK = 4096;
+    Scratch<int32_t> stereo(BLOCK * 2);
+    Scratch<int16_t> decoded(BLOCK);
+
+    MemStream memStream0(compressed, nCompressed);
+    memStream0.set(0, nCompressed);
+    ExpanderAD4 expander;
+    expander.init(&memStream0, S4ADPCM::getTable(table, bits), predictor, bits);
+
+    ErrorAccum accum(metric);
+    for (int pos = 0; pos < nSamples; pos += BLOCK) {
+        int n = std::min(BLOCK, nSamples - pos);
+        n = expander.expand(stereo.get(), n, 256, false, true);
+        WavWriter::NarrowStereo32(stereo.get(), n, decoded.get());
+        accum.add(samples + pos, decoded.get(), n);
+    }
+    return accum.result();
+}
+
+// The 3 and 2 bit modes need a multiple of 8 or 4 samples; repeats the
+// last sample to get there. Returns the samples to encode.
+static const int16_t* padSamples(const int16_t* samples, int* nSamples, int bits, std::vector<int16_t>* padded)
+{
+    const int group = S4ADPCM::sampleGroup(bits);
+    if (*nSamples % group == 0)
+        return samples;
+    padded->assign(samples, samples + *nSamples);
+    while (padded->size() % group)
+        padded->push_back(padded->back());
+    *nSamples = int(padded->size());
+    return padded->data();
+}
+
+
+EncodedStream compressS4(const int16_t* samples, int nSamples, int table, int32_t predictor, int bits, int noiseShape)
 {
     W12ASSERT((nSamples & 1) == 0);
-    int nCompressed = nSamples / 2;
+    std::vector<int16_t> padded;
+    samples = padSamples(samples, &nSamples, bits, &padded);
+    int nCompressed = (nSamples * bits + 7) / 8;
 
-    const int* pTable = S4ADPCM::getTable(table);
+    const int* pTable = S4ADPCM::getTable(table, bits);
     S4ADPCM::State state(pTable, predictor);
     state.predictor = predictor;
     auto compressed = std::make_unique<uint8_t[]>(nCompressed);
 
-    S4ADPCM::encode4(samples, nSamples, compressed.get(), &state);
-
-    auto stereo = std::make_unique<int32_t[]>(nSamples * 2);
+    if (bits == 4)
+        S4ADPCM::encode4(samples, nSamples, compressed.get(), &state, noiseShape);
+    else {
+        int n = S4ADPCM::encodeN(bits, samples, nSamples, compressed.get(), &state);
+        S4ADPCM::flushN(compressed.get() + n, &state);
+    }
+    int32_t aveError2 = errorOfS4(samples, nSamples, compressed.get(), nCompressed, table, predictor, bits, ErrorMetric::MSE);
 
-    MemStream memStream0(compressed.get(), nCompressed);
-    memStream0.set(0, nCompressed);
-    ExpanderAD4 expander;
-    expander.init(&memStream0, pTable, predictor);
-    const int volume = 256;
-    bool loop = false;
+    EncodedStream es{
+        nSamples,
+        nCompressed,
+        table,
+        predictor,
+        aveError2,
+        std::move(compressed),
+    };
+    es.codec = bits == 3 ? MemUnit::CODEC_S3 : bits == 2 ? MemUnit::CODEC_S2 : MemUnit::CODEC_S4;
+    return es;
+}
 
-    ExpanderAD4::fillBuffer(stereo.get(), nSamples, &expander, 1, &loop, &volume, true);
 
-    int64_t error2 = 0;
-    for (int i = 0; i < nSamples; ++i) {
-        int16_t s0 = samples[i];
-        int16_t s1 = int16_t(stereo.get()[i * 2] / 65536);
-        int64_t d = int64_t(s0) - int64_t(s1);
-        error2 += d * d;
+int32_t errorS4(const int16_t* samples, int nSamples, int table, int predictor, int bits, ErrorMetric metric, int noiseShape)
+{
+    W12ASSERT((nSamples & 1) == 0);
+    std::vector<int16_t> padded;
+    samples = padSamples(samples, &nSamples, bits, &padded);
+    int nCompressed = (nSamples * bits + 7) / 8;
+
+    S4ADPCM::State state(S4ADPCM::getTable(table, bits), predictor);
+    Scratch<uint8_t> compressed(nCompressed);
+    if (bits == 4)
+        S4ADPCM::encode4(samples, nSamples, compressed.get(), &state, noiseShape);
+    else {
+        int n = S4ADPCM::encodeN(bits, samples, nSamples, compressed.get(), &state);
+        S4ADPCM::flushN(compressed.get() + n, &state);
     }
-    int32_t aveError2 = int32_t(error2 / nSamples);
-    
-    return EncodedStream{
-        nSamples,
-		nCompressed,
-		table,
-		predictor,
-		aveError2,
-		std::move(compressed),
-		std::move(stereo),
-	};
+    return errorOfS4(samples, nSamples, compressed.get(), nCompressed, table, predictor, bits, metric);
 }
 
 void runTest(const int16_t* samplesIn, int nSamplesIn, int tolerance)
@@ -280,7 +493,6 @@ void runTest(const int16_t* samplesIn, int nSamplesIn, int tolerance)
                 // Compression
                 uint32_t nCompressed = nSamplesIn / 2;
                 uint8_t* compressed = new uint8_t[nSamplesIn];
-                int64_t error = 0;
                 S4ADPCM::State state(S4ADPCM::getTable(0), S4ADPCM::State::PREDICTOR);
                 S4ADPCM::encode4(samplesIn, nSamplesIn, compressed, &state);
 
@@ -366,8 +578,25 @@ int16_t* covert44to22(int nSamples, int16_t* data, int* nSamplesOut)
 
 int main(int argc, const char* argv[])
 {
+    // 'test' runs the slow tests too, and stops.
+    const bool testAll = argc == 2 && strcmp(argv[1], "test") == 0;
     Manifest::Test();
-    MemImageUtil::Test();
+    MemImageUtil::Test(testAll);
+    ImageFit::Test();
+    ImagePatch::Test();
+    WavWriter::Test();
+    WavPrefetch::Test();
+    ScratchPool::Test();
+    ErrorAccum::Test();
+    Preprocess::Test();
+    testBase64();
+    testExpanders();
+    testNoiseShape();
+    S4Lanes::Test();
+    Trace::Test();
+    CycleModel::Test();
+    Golden::Test();
+    BuildPlan::Test();
 
     int16_t TEST_1[12] = { 0, 10, 20, 30, 40, 50, 60, 70, 80, 90, 100, 110 };
     int16_t TEST_2[12] = { 0, 10, -20, 30, -40, 50, -60, 70, -80, 90, -100, 110 };
@@ -378,26 +607,157 @@ int main(int argc, const char* argv[])
     runTest(TEST_2, 12, 300);
     runTest(TEST_3, 12, 30);
     runTest(TEST_4, 18, 200);
+    if (testAll) {
+        printf("Tests passed.\n");
+        return 0;
+    }
 
     if (argc < 2) {
         printf("Usage:\n");
         printf("    wav12 filename                Runs tests on 'filename'\n");
         printf("    wav12 xmlFile <options>       Creates memory image.\n");
+        printf("    wav12 test                    Runs all the tests, including the slow ones.\n");
+        printf("    wav12 verify textFile         Checks a text image (either format.)\n");
+        printf("    wav12 diff old new [patch]    Lists what changed between two images, and writes a patch.\n");
+        printf("    wav12 inspect image [-d path] [dir[/file]...]\n");
+        printf("                                  Lists the contents of an image. With -d, decodes the\n");
+        printf("                                  (selected) files to 'path'dir_file.wav\n");
+        printf("    wav12 golden [-w goldenFile wav...] [-c goldenFile]\n");
+        printf("                                  Bitstream conformance. With -w, writes the golden vectors of\n");
+        printf("                                  the WAVs (every codec, table, and predictor); -c checks every\n");
+        printf("                                  kernel against them. Alone, prints the built in table.\n");
+        printf("    wav12 cycles [-isa m0plus|m4|esp32] [-codec s4|s3|s2|ima] [-voices n] [-buffer samples]\n");
+        printf("                 [-mhz n] [-cpu percent]\n");
+        printf("                                  Estimates the worst case device cycles per buffer for 1 to n\n");
+        printf("                                  voices, and how many fit in 'percent' (default 50) of the CPU.\n");
         printf("Options:\n");
         printf("    -t, write text file.\n");
+        printf("    -f, write framed text file: per line sequence numbers and CRC32s.\n");
         printf("    -i, base input path for file leading.\n");
+        printf("    -b, budget: the image must fit in this many bytes (k and m suffixes work.)\n");
+        printf("        Files are trimmed, loops shortened, and optional files dropped to fit.\n");
+        printf("    -q, quality: files that stay under this RMS error are stored at 3 or 2 bits per sample.\n");
+        printf("        The maxerr attribute of <File> overrides it.\n");
+        printf("    -metric mse|emphasis|segsnr, how the candidate encodings are compared. Default mse.\n");
+        printf("        emphasis weights high frequency error; segsnr weights error in quiet passages.\n");
+        printf("    -shape, noise shaping of S4, -3 to 3. Positive moves the noise up in frequency,\n");
+        printf("        negative moves it down. Default 0 (off.) The shape attribute of <File> overrides it.\n");
+        printf("    -noadpcm, only use S4; don't try IMA ADPCM for each file.\n");
+        printf("    -trace, write a Chrome trace (chrome://tracing) of the build to this file, and\n");
+        printf("        print the time per phase and how busy each thread was. --trace works too.\n");
+        printf("    -p, previous image: unchanged files keep their address, so the patch is small.\n");
+        printf("    -trim, default level at or below which leading and trailing samples are trimmed.\n");
+        printf("    -dc, default to removing DC offset.\n");
+        printf("    -fade, default fade (in msec) at trimmed ends.\n");
+        printf("    The defaults can be overridden by the trim, dc, and fade attributes of <File>.\n");
         return 1;
     }
 
-    bool writeText = false;
-    std::string inputPath = "";
+    if (strcmp(argv[1], "verify") == 0 && argc > 2) {
+        return verifyText(argv[2]);
+    }
+    if (strcmp(argv[1], "diff") == 0 && argc > 3) {
+        return diffImages(argv[2], argv[3], argc > 4 ? argv[4] : 0);
+    }
+    if (strcmp(argv[1], "inspect") == 0 && argc > 2) {
+        const char* outPath = 0;
+        std::vector<std::string> select;
+        for (int i = 3; i < argc; ++i) {
+            if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+                outPath = argv[++i];
+            else
+                select.push_back(argv[i]);
+        }
+        return inspectImage(argv[2], outPath, select);
+    }
+    if (strcmp(argv[1], "golden") == 0) {
+        if (argc > 3 && strcmp(argv[2], "-w") == 0)
+            return Golden::WriteFile(argv[3], std::vector<std::string>(argv + 4, argv + argc));
+        if (argc > 3 && strcmp(argv[2], "-c") == 0)
+            return Golden::CheckFile(argv[3]);
+        Golden::PrintTable();
+        return 0;
+    }
+    if (strcmp(argv[1], "cycles") == 0) {
+        const CycleCosts* costs = 0;
+        int codec = MemUnit::CODEC_S4;
+        int voices = 8, bufferSamples = 256, mhz = 0, cpu = 50;
+        for (int i = 2; i + 1 < argc; i += 2) {
+            if (strcmp(argv[i], "-isa") == 0) {
+                costs = CycleModel::FindCosts(argv[i + 1]);
+                if (!costs) {
+                    printf("Unknown isa: %s\n", argv[i + 1]);
+                    return 1;
+                }
+            }
+            else if (strcmp(argv[i], "-codec") == 0) {
+                codec = MemUnit::CodecFromName(argv[i + 1]);
+                if (codec < 0) {
+                    printf("Unknown codec: %s\n", argv[i + 1]);
+                    return 1;
+                }
+            }
+            else if (strcmp(argv[i], "-voices") == 0) voices = atoi(argv[i + 1]);
+            else if (strcmp(argv[i], "-buffer") == 0) bufferSamples = atoi(argv[i + 1]);
+            else if (strcmp(argv[i], "-mhz") == 0) mhz = atoi(argv[i + 1]);
+            else if (strcmp(argv[i], "-cpu") == 0) cpu = atoi(argv[i + 1]);
+        }
+        if (voices < 1 || bufferSamples < 2 || (bufferSamples & 1)) {
+            printf("Needs at least 1 voice, and an even buffer size.\n");
+            return 1;
+        }
+        CycleModel::Report(costs, codec, voices, bufferSamples, mhz, cpu);
+        return 0;
+    }
+
+    BuildOptions options;
 
     for (int i = 2; i < argc; ++i) {
         if (strcmp(argv[i], "-t") == 0) {
-            writeText = true;
+            options.textFile = true;
+        }
+        if (strcmp(argv[i], "-f") == 0) {
+            options.textFile = true;
+            options.framedText = true;
+        }
+        if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            options.inputPath = argv[i + 1];
+        }
+        if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            char* end = 0;
+            options.budget = strtoll(argv[i + 1], &end, 10);
+            if (*end == 'k' || *end == 'K') options.budget *= 1024;
+            if (*end == 'm' || *end == 'M') options.budget *= 1024 * 1024;
+        }
+        if (strcmp(argv[i], "-q") == 0 && i + 1 < argc) {
+            options.compress.maxError = atoi(argv[i + 1]);
+        }
+        if (strcmp(argv[i], "-metric") == 0 && i + 1 < argc) {
+            if (!ParseErrorMetric(argv[i + 1], &options.compress.metric)) {
+                printf("Unknown metric: %s\n", argv[i + 1]);
+                return 1;
+            }
+        }
+        if (strcmp(argv[i], "-shape") == 0 && i + 1 < argc) {
+            options.compress.noiseShape = atoi(argv[i + 1]);
+        }
+        if (strcmp(argv[i], "-noadpcm") == 0) {
+            options.compress.tryADPCM = false;
+        }
+        if ((strcmp(argv[i], "-trace") == 0 || strcmp(argv[i], "--trace") == 0) && i + 1 < argc) {
+            options.trace = argv[i + 1];
+        }
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            options.previous = argv[i + 1];
         }
-        if (strcmp(argv[i], "-i") == 0) {
-            inputPath = argv[i + 1];
+        if (strcmp(argv[i], "-trim") == 0 && i + 1 < argc) {
+            options.pre.trimLevel = atoi(argv[i + 1]);
+        }
+        if (strcmp(argv[i], "-dc") == 0) {
+            options.pre.removeDC = true;
+        }
+        if (strcmp(argv[i], "-fade") == 0 && i + 1 < argc) {
+            options.pre.fadeMSec = atoi(argv[i + 1]);
         }
     }
 
@@ -408,25 +768,34 @@ int main(int argc, const char* argv[])
         }
     }
     if (!xmlFiles.empty()) {
-        int rc = parseXML(xmlFiles, inputPath, writeText);
+        if (!options.trace.empty())
+            Trace::Start();
+        int rc = parseXML(xmlFiles, options);
+        if (!options.trace.empty() && !Trace::Write(options.trace.c_str()) && rc == 0)
+            rc = 1;
         return rc;
     }
 
-    wave_reader_error error;
+    wave_reader_error error = WR_NO_ERROR;
     wave_reader* wr = wave_reader_open(argv[1], &error);
+    if (!wr) {
+        printf("Failed to open: %s\n", argv[1]);
+        return 1;
+    }
 
     int format = wave_reader_get_format(wr);
     int nChannels = wave_reader_get_num_channels(wr);
     int rate = wave_reader_get_sample_rate(wr);
-    int nSamples = wave_reader_get_num_samples(wr);
 
     printf("Format=%d channels=%d rate=%d\n", format, nChannels, rate);
 
     if (format != 1
         || nChannels != 1
-        || rate != 22050)
+        || rate != 22050
+        || wave_reader_get_sample_bits(wr) != 16)
     {
-        printf("Input must be 22050 Hz Mono\n");
+        printf("Input must be 22050 Hz 16 bit Mono\n");
+        wave_reader_close(wr);
         return 1;
     }
 
@@ -465,7 +834,6 @@ int rotateZero(int16_t* data, int nSamples)
 
 bool runTest(wave_reader* wr)
 {
-    const int format = wave_reader_get_format(wr);
     const int nChannels = wave_reader_get_num_channels(wr);
     const int rate = wave_reader_get_sample_rate(wr);
     int nSamples = wave_reader_get_num_samples(wr);
@@ -485,19 +853,21 @@ bool runTest(wave_reader* wr)
         printf("Can't test nChannels=%d and rate=%d\n", nChannels, rate);
     }
     
-    //optimizeTable(data, nSamples);
+    //optimizeTable(data, nSamples, ErrorMetric::MSE);
 
     EncodedStream es = compressGroup(data, nSamples);
 
     {
-        saveOut("testPost.wav", es.stereo.get(), nSamples);
-
-        int32_t* loopStereo = new int32_t[nSamples * 2 * 4];
-        for (int i = 0; i < 4; ++i) {
-            memcpy(loopStereo + nSamples * 2 * i, es.stereo.get(), nSamples * 2 * sizeof(int32_t));
+        WavWriter writer;
+        if (writer.open("testPost.wav")) {
+            writer.put(es);
+            writer.close();
+        }
+        if (writer.open("testPostLoop.wav")) {
+            for (int i = 0; i < 4; ++i)
+                writer.put(es);
+            writer.close();
         }
-        saveOut("testPostLoop.wav", loopStereo, nSamples * 4);
-        delete[] loopStereo;
     }
     printf("Best table=%d predictor=%d error=%d\n", es.table, es.predictor, es.aveError2);
     delete[] data;
@@ -505,173 +875,568 @@ bool runTest(wave_reader* wr)
 }
 
 
-uint8_t ParseOneHex(char c)
+// Converts the WAV to 22050 Hz, and sets up the samples for compression.
+// 'pre', if not null, gets what the preprocessing did, and the rotation is
+// reported; it's null when fitBudget() reads the file again. The report
+// goes to 'log' if there is one.
+int readFileJob(FileJob& job, PcmFile& pcm, PreprocessResult* pre, std::string* log)
 {
-    c = tolower(c);
-    if (c >= 'a' && c <= 'f') return 10 + (c - 'a');
-    return c - '0';
+    if (pcm.error != WR_NO_ERROR) {
+        report(log, "Failed to open: %s\n", job.fullPath.c_str());
+        return pcm.error;
+    }
+    if (pcm.format != 1 || pcm.nChannels != 1 || pcm.bits != 16 || !(pcm.rate == 22050 || pcm.rate == 44100)) {
+        report(log, "Input '%s' must be 22050/44100 Hz 16 bit Mono, freq=%d channels=%d bits=%d\n", job.fname.c_str(), pcm.rate, pcm.nChannels, pcm.bits);
+        return 100;
+    }
+
+    job.samples = std::move(pcm.samples);
+    if (pcm.rate == 44100) {
+        Trace::Scope scope("resample");
+        // In place: sample i is written after 2i and 2i+1 are read.
+        int n22 = int(job.samples.size()) / 2;
+        for (int i = 0; i < n22; ++i)
+            job.samples[i] = int16_t((job.samples[i * 2] + job.samples[i * 2 + 1]) / 2);
+        job.samples.resize(n22);
+    }
+
+    {
+        Trace::Scope scope("preprocess");
+        PreprocessResult result = Preprocess::Apply(job.samples, job.pre, job.looping);
+        if (pre)
+            *pre = result;
+    }
+    int nSamples = int(job.samples.size());
+    if (nSamples == 0) {
+        report(log, "Input '%s' has no samples\n", job.fname.c_str());
+        return 100;
+    }
+
+    if (nSamples & 1) {
+        job.samples.push_back(job.samples.back());
+    }
+    if (job.looping) {
+        Trace::Scope scope("rotate");
+        int r = rotateZero(job.samples.data(), int(job.samples.size()));
+        if (pre)
+            report(log, "%s rotated %d samples.\n", job.fname.c_str(), r);
+    }
+    return 0;
 }
 
-uint8_t ParseOneHex(const char* in)
+// The fitter's view of a file, while its samples are in memory.
+static FitItem fitItem(const FileJob& job)
 {
-    return ParseOneHex(in[0]) * 16 + ParseOneHex(in[1]);
+    FitItem item;
+    item.samples = job.samples.data();
+    item.nSamples = int(job.samples.size());
+    item.aveError2 = job.es.aveError2;
+    item.codec = job.es.codec;
+    item.looping = job.looping;
+    item.optional = job.optional;
+    item.priority = job.priority;
+    return item;
 }
 
-void ParseHex(const char* in, uint8_t* r, uint8_t* g, uint8_t* b)
+// Trades quality for size until the sound data fits in the budget. The
+// options were made as each file was compressed; a file that is cut is
+// read again to encode it.
+int fitBudget(std::vector<DirJob>& dirs, int64_t budget)
 {
-    *r = ParseOneHex(in + 0);
-    *g = ParseOneHex(in + 2);
-    *b = ParseOneHex(in + 4);
+    std::vector<FileJob*> jobs;
+    std::vector<std::vector<FitChoice>> options;
+    for (DirJob& dir : dirs) {
+        for (FileJob& job : dir.files) {
+            options.push_back(std::move(job.fit));
+            jobs.push_back(&job);
+        }
+    }
+
+    std::vector<FitChoice> choices;
+    bool fits = ImageFit::Fit(options, budget, &choices);
+
+    int64_t before = 0, after = 0;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        FileJob& job = *jobs[i];
+        const FitChoice& c = choices[i];
+        before += job.es.nCompressed;
+        after += c.bytes;
+        if (c.kind == FitChoice::FULL)
+            continue;
+
+        printf("Fit: %-12s %-12s %7d -> %7d bytes  ave-err %7.1f -> %7.1f\n",
+            job.name.c_str(), ImageFit::KindName(c.kind),
+            job.es.nCompressed, c.bytes,
+            sqrtf((float)job.es.aveError2),
+            c.nSamples ? sqrtf(float(c.cost / (c.nSamples * (int64_t)std::max(job.priority, 1)))) : 0.0f);
+
+        if (c.kind == FitChoice::DROP) {
+            job.es = EncodedStream();
+        }
+        else if (c.nSamples <= 0) {
+            // Only a drop can be empty; compressGroup() needs samples.
+            printf("ERROR %s can't be cut to %d samples\n", job.name.c_str(), c.nSamples);
+            return 1;
+        }
+        else {
+            PcmFile pcm = PcmFile::Read(job.fullPath);
+            int rc = readFileJob(job, pcm, 0, 0);
+            if (rc)
+                return rc;
+            job.samples.resize(c.nSamples);
+            job.es = compressGroup(job.samples.data(), c.nSamples, job.compress);
+            job.samples = std::vector<int16_t>();
+        }
+    }
+    printf("Fit: sound data %lld -> %lld bytes, budget %lld\n", (long long)before, (long long)after, (long long)budget);
+    if (!fits) {
+        printf("ERROR can not fit in to %lld bytes\n", (long long)budget);
+        return 1;
+    }
+    return 0;
 }
 
-int parseXML(const std::vector<std::string>& files, const std::string& inputPath, bool textFile)
+// Reads, compresses, and makes the fit options for one file. Files are low
+// priority, so a thread waiting on the tasks of a file only helps with the
+// high priority work of the files already started.
+struct FileTask : enki::ITaskSet
+{
+    FileJob* job = 0;
+    PcmFile pcm;
+    bool fit = false;
+    int rc = 0;
+    std::string log;    // printed in schedule order, so files don't mix
+
+    FileTask() { m_Priority = enki::TASK_PRIORITY_LOW; }
+
+    void ExecuteRange(enki::TaskSetPartition range_, uint32_t threadnum_) override {
+        Trace::Scope scope("file", job->fname);
+        PreprocessResult pre;
+        rc = readFileJob(*job, pcm, &pre, &log);
+        pcm = PcmFile();
+        if (rc)
+            return;
+        {
+            Trace::Scope compress("compress");
+            job->es = compressGroup(job->samples.data(), int(job->samples.size()), job->compress, &log);
+        }
+        if (pre.leading || pre.trailing || pre.dc) {
+            // The bytes saved depend on the codec, so this is after compression.
+            const int bits = MemUnit::CodecBits(job->es.codec);
+            report(&log, "%s trimmed %d leading and %d trailing samples (%d bytes), removed dc=%d\n",
+                job->fname.c_str(), pre.leading, pre.trailing,
+                int((int64_t(pre.leading + pre.trailing) * bits + 7) / 8), pre.dc);
+        }
+        if (fit)
+            job->fit = ImageFit::Options(fitItem(*job));
+        // Only the encoding is kept; fitBudget() reads the file again if it needs to.
+        job->samples = std::vector<int16_t>();
+    }
+};
+
+int parseXML(const std::vector<std::string>& files, const BuildOptions& options)
 {
     MemImageUtil image;
-    std::string imageFileName;
     int64_t totalError = 0;
     int64_t simpleError = 0;
 
-    for (const std::string& filename : files) {
-        XMLDocument doc;
-        doc.LoadFile(filename.c_str());
+    // All of the XML, and every WAV header, is checked before anything is compressed.
+    BuildPlan plan;
+    if (!plan.load(files, options, &taskScheduler())) {
+        for (const std::string& e : plan.errors)
+            printf("%s\n", e.c_str());
+        printf("ERROR %d problem(s) in the input; nothing was built.\n", int(plan.errors.size()));
+        return 1;
+    }
+    const std::string& imageFileName = plan.imageName;
+    std::vector<DirJob>& dirs = plan.dirs;
+    for (int i = 0; i < plan.nPalette; ++i)
+        image.writePalette(i, plan.palette[i]);
+
+    // Compress largest first, reading ahead of the compression, which is
+    // the slow part. A file per thread is in flight, plus one so there is
+    // always another to start; their logs are printed in this order. The
+    // image is still written in XML order.
+    const std::vector<FileJob*> order = plan.schedule();
+    const int nOrder = int(order.size());
+    const int window = int(taskScheduler().GetNumTaskThreads()) + 1;
+    std::vector<std::string> paths;
+    for (const FileJob* job : order)
+        paths.push_back(job->fullPath);
+    WavPrefetch prefetch(paths, window);
+
+    // ITaskSets can't be moved, so a ring of them, reused in turn.
+    std::unique_ptr<FileTask[]> tasks(new FileTask[window]);
+    int started = 0, finished = 0;
+    int rc = 0;
+    while (finished < started || (started < nOrder && rc == 0)) {
+        if (started < nOrder && rc == 0 && started - finished < window) {
+            FileTask& task = tasks[started % window];
+            task.job = order[started];
+            task.pcm = prefetch.take(started);
+            task.fit = options.budget > 0;
+            task.rc = 0;
+            task.log.clear();
+            taskScheduler().AddTaskSetToPipe(&task);
+            ++started;
+            continue;
+        }
+        // After an error, the files in flight are finished, then it stops.
+        FileTask& task = tasks[finished % window];
+        taskScheduler().WaitforTask(&task);
+        fputs(task.log.c_str(), stdout);
+        if (task.rc && rc == 0)
+            rc = task.rc;
+        ++finished;
+    }
+    if (rc)
+        return rc;
+    plan.copySame();
+
+    if (options.budget > 0) {
+        // The budget is for the whole image; take out the overhead of the tables.
+        int nUnits = 0;
+        for (const DirJob& dir : dirs)
+            nUnits += 1 + int(dir.files.size());
+        Trace::Scope scope("fit");
+        int rc = fitBudget(dirs, options.budget - MemImage::DataAddr(nUnits));
+        if (rc)
+            return rc;
+    }
+
+    for (DirJob& dir : dirs) {
+        image.addDir(dir.name.c_str());
+        for (FileJob& job : dir.files) {
+            const EncodedStream& es = job.es;
+            if (es.nSamples == 0)
+                continue;   // dropped
+            totalError += int64_t(es.aveError2) * int64_t(es.nSamples);
+            simpleError += int64_t(es.aveError2);
+
+            if (!dir.postPath.empty()) {
+                // Decoded from the image data: nothing is kept around for this.
+                std::string f = dir.postPath + job.fname;
+                Trace::Scope scope("post", job.fname);
+                WavWriter writer;
+                if (writer.open(f.c_str())) {
+                    writer.put(es);
+                    writer.close();
+                }
+            }
+            image.addFile(job.name.c_str(), es.compressed.get(), es.nCompressed, es.table, es.predictor, es.aveError2, es.codec);
+        }
+    }
+
+    image.writeDesc(imageFileName.c_str());
 
-        if (doc.Error()) {
-            printf("XML error: %s\n", doc.ErrorName());
+    if (!options.previous.empty()) {
+        std::vector<uint8_t> previous;
+        if (!readFile(options.previous.c_str(), &previous))
             return 1;
+        image.setPrevious(previous.data(), uint32_t(previous.size()));
+    }
+
+    image.dumpConsole();
+    printf("TotalError = %lld  SimpleError = %lld\n", totalError / int64_t(1'000'000'000), simpleError / 1000);
+    printf("Num Dirs=%d Files=%d\n", image.getNumDirs(), image.getNumFiles());
+    ScratchPool::Stats scratch = ScratchPool::GetStats();
+    printf("Memory: peak=%dk scratch=%dk (%d allocations, %d reuses)\n",
+        int(ScratchPool::PeakRSS() / 1024), int(scratch.bytes / 1024), int(scratch.allocs), int(scratch.reuses));
+    {
+        Trace::Scope scope("write");
+        image.write((imageFileName + ".bin").c_str());
+        if (options.textFile) {
+            image.writeText((imageFileName + ".txt").c_str(), options.framedText);
         }
+    }
+    return 0;
+}
 
-        const char* rootName = doc.RootElement()->Name();
-        if (rootName && strcmp(rootName, "Config") == 0) {
 
-            int nPalette = 0;
+int verifyText(const char* name)
+{
+    std::vector<uint8_t> text;
+    if (!readFile(name, &text))
+        return 1;
 
-            if (doc.RootElement()->Attribute("name")) {
-                imageFileName += "_";
-                imageFileName += doc.RootElement()->Attribute("name");
-            }
-            else {
-                imageFileName += "_config";
+    std::vector<uint8_t> image;
+    std::vector<int> badLines;
+    bool okay = MemImageUtil::ParseText((const char*)text.data(), text.size(), &image, &badLines);
+
+    for (int line : badLines)
+        printf("Bad line: %d\n", line);
+    if (!okay) {
+        printf("Text image '%s' failed verification (%d bad lines.)\n", name, int(badLines.size()));
+        return 1;
+    }
+
+    Manifest manifest;
+    if (!manifest.load(image.data(), uint32_t(image.size()))) {
+        printf("Text image '%s' decoded, but the image is not valid.\n", name);
+        return 1;
+    }
+    printf("Text image '%s' okay: %d bytes, version %d, %d dirs, %d files.\n",
+        name, int(image.size()), manifest.version(), manifest.numDir(), manifest.numFile());
+    return 0;
+}
+
+
+int diffImages(const char* oldName, const char* newName, const char* patchName)
+{
+    std::vector<uint8_t> oldImage, newImage;
+    if (!readFile(oldName, &oldImage) || !readFile(newName, &newImage))
+        return 1;
+
+    Manifest oldM, newM;
+    if (!oldM.load(oldImage.data(), uint32_t(oldImage.size())) || !newM.load(newImage.data(), uint32_t(newImage.size()))) {
+        printf("Not a valid image.\n");
+        return 1;
+    }
+
+    // Units by directory and name; a unit has changed if its entry or its data has.
+    for (int d = 0; d < newM.numDir(); ++d) {
+        const MemUnit& dir = newM.getUnit(d);
+        char dirName[MemUnit::NAME_ALLOC] = { 0 };
+        memcpy(dirName, dir.name, MemUnit::NAME_LEN);
+        int start = 0, n = 0;
+        newM.dirRange(d, &start, &n);
+        for (int i = start; i < start + n; ++i) {
+            const MemUnit& unit = newM.getUnit(i);
+            char fileName[MemUnit::NAME_ALLOC] = { 0 };
+            memcpy(fileName, unit.name, MemUnit::NAME_LEN);
+
+            int oldIndex = oldM.getFile(dirName, fileName);
+            const char* status = "added";
+            if (oldIndex >= 0) {
+                const MemUnit& old = oldM.getUnit(oldIndex);
+                bool sameData = old.size == unit.size
+                    && memcmp(oldImage.data() + old.offset, newImage.data() + unit.offset, unit.size) == 0;
+                if (!sameData)
+                    status = "changed";
+                else if (old.offset != unit.offset)
+                    status = "moved";
+                else if (old.table != unit.table || old.predictor != unit.predictor || old.codec != unit.codec)
+                    status = "changed";
+                else
+                    status = 0;
             }
+            if (status)
+                printf("  %8s/%-8s %s\n", dirName, fileName, status);
+        }
+    }
+    for (int d = 0; d < oldM.numDir(); ++d) {
+        char dirName[MemUnit::NAME_ALLOC] = { 0 };
+        memcpy(dirName, oldM.getUnit(d).name, MemUnit::NAME_LEN);
+        int start = 0, n = 0;
+        oldM.dirRange(d, &start, &n);
+        for (int i = start; i < start + n; ++i) {
+            char fileName[MemUnit::NAME_ALLOC] = { 0 };
+            memcpy(fileName, oldM.getUnit(i).name, MemUnit::NAME_LEN);
+            if (newM.getFile(dirName, fileName) < 0)
+                printf("  %8s/%-8s removed\n", dirName, fileName);
+        }
+    }
 
-            for (const XMLElement* palElement = doc.RootElement()->FirstChildElement("Palette");
-                palElement;
-                palElement = palElement->NextSiblingElement("Palette"))
-            {
-                MemPalette pal;
-                int font = 0;
-                palElement->QueryIntAttribute("font", &font);
-                pal.soundFont = font;
-                const char* bc = palElement->Attribute("bc");
-                const char* ic = palElement->Attribute("ic");
-                ParseHex(bc, &pal.bladeColor.r, &pal.bladeColor.g, &pal.bladeColor.b);
-                ParseHex(ic, &pal.impactColor.r, &pal.impactColor.g, &pal.impactColor.b);
-                image.writePalette(nPalette, pal);
-
-                ++nPalette;
+    std::vector<uint8_t> patch;
+    ImagePatch::Diff(oldImage.data(), uint32_t(oldImage.size()), newImage.data(), uint32_t(newImage.size()), &patch);
+    PatchHeader header;
+    memcpy(&header, patch.data(), sizeof(header));
+    printf("Patch: %d ranges, %d bytes (%dk), image %d bytes (%dk)\n",
+        int(header.numRanges), int(patch.size()), int(patch.size() / 1024),
+        int(newImage.size()), int(newImage.size() / 1024));
+
+    if (patchName) {
+        FILE* fp = fopen(patchName, "wb");
+        if (!fp) {
+            printf("Failed to open: %s\n", patchName);
+            return 1;
+        }
+        fwrite(patch.data(), patch.size(), 1, fp);
+        fclose(fp);
+    }
+    return 0;
+}
+
+
+// Decodes units [first, first + count) of 'units' to 'pcm'. A batch of S4
+// units goes through S4Lanes; anything else is one unit through its Expander.
+struct DecodeTask : enki::ITaskSet
+{
+    const uint8_t* image = 0;
+    uint32_t imageSize = 0;
+    const MemUnit* units = 0;
+    std::vector<int16_t>* pcm = 0;
+    int first = 0;
+    int count = 0;
+
+    void ExecuteRange(enki::TaskSetPartition range_, uint32_t threadnum_) override {
+        for (int i = first; i < first + count; ++i)
+            pcm[i].resize(units[i].numSamples());
+
+        if (units[first].codec == MemUnit::CODEC_S4) {
+            S4Job jobs[BATCH];
+            for (int i = 0; i < count; ++i) {
+                const MemUnit& unit = units[first + i];
+                jobs[i].compressed = image + unit.offset;
+                jobs[i].nSamples = unit.numSamples();
+                jobs[i].table = S4ADPCM::getTable(unit.table);
+                jobs[i].predictor = unit.predictor;
+                jobs[i].out = pcm[first + i].data();
             }
-            assert(nPalette == 8);
+            S4Lanes::Decode(jobs, count);
+            return;
         }
-        else {
-            for (const XMLElement* dirElement = doc.RootElement()->FirstChildElement();
-                dirElement;
-                dirElement = dirElement->NextSiblingElement())
-            {
-                const char* p = dirElement->Attribute("path");
-                std::string stdDirName = p;
-                std::string fontName = stdDirName;
-                if (dirElement->Attribute("name")) {
-                    fontName = dirElement->Attribute("name");
-                }
-                image.addDir(fontName.c_str());
-                const char* post = dirElement->Attribute("post");
-                std::string postPath;
-                if (post) {
-                    postPath = post;
-                    postPath.append("/");
-                }
 
-                if (!imageFileName.empty()) {
-                    imageFileName += "_";
-                }
-                imageFileName += fontName;
-
-                for (const XMLElement* fileElement = dirElement->FirstChildElement();
-                    fileElement;
-                    fileElement = fileElement->NextSiblingElement())
-                {
-                    const char* fname = fileElement->Attribute("path");
-                    const char* extension = strrchr(fname, '.');
-                    std::string stdfname;
-                    stdfname.append(fname, extension);
-
-                    std::string fullPath = inputPath;
-                    fullPath += stdDirName;
-                    fullPath += '/';
-                    fullPath += fname;
-
-                    int loopFade = 0;
-                    fileElement->QueryIntAttribute("loopFade", &loopFade);
-                    bool rotateToZero = false;
-                    fileElement->QueryBoolAttribute("looping", &rotateToZero);
-
-                    wave_reader_error wrErr = WR_NO_ERROR;
-                    wave_reader* wr = wave_reader_open(fullPath.c_str(), &wrErr);
-                    if (wrErr != WR_NO_ERROR) {
-                        printf("Failed to open: %s\n", fullPath.c_str());
-                        return wrErr;
-                    }
+        W12ASSERT(count == 1);
+        const MemUnit& unit = units[first];
+        const int nSamples = unit.numSamples();
+        std::unique_ptr<int32_t[]> stereo(new int32_t[nSamples * 2]);
+        MemStream memStream(image, imageSize);
+        memStream.set(unit.offset, unit.size);
+        ExpanderAD4 expanderAD4;
+        ExpanderIMA expanderIMA;
+        Expander* expander = &expanderAD4;
+        if (unit.codec == MemUnit::CODEC_IMA) {
+            expanderIMA.init(&memStream);
+            expander = &expanderIMA;
+        }
+        else {
+            int bits = MemUnit::CodecBits(unit.codec);
+            expanderAD4.init(&memStream, S4ADPCM::getTable(unit.table, bits), unit.predictor, bits);
+        }
+        const int volume = 256;
+        bool loop = false;
+        Expander::fillBuffer(stereo.get(), nSamples, &expander, 1, &loop, &volume, true);
+        WavWriter::NarrowStereo32(stereo.get(), nSamples, pcm[first].data());
+    }
 
-                    int format = wave_reader_get_format(wr);
-                    int nChannels = wave_reader_get_num_channels(wr);
-                    int rate = wave_reader_get_sample_rate(wr);
-                    int nSamples = wave_reader_get_num_samples(wr);
+    static const int BATCH = S4Lanes::LANES * 2;
+};
 
-                    if (format != 1 || nChannels != 1 || !(rate == 22050 || rate == 44100)) {
-                        printf("Input '%s' must be 22050/44100 Hz Mono, freq=%d channels=%d\n", fname, rate, nChannels);
-                        return 100;
-                    }
+int inspectImage(const char* name, const char* outPath, const std::vector<std::string>& select)
+{
+    std::vector<uint8_t> image;
+    if (!readFile(name, &image))
+        return 1;
+    const uint32_t imageSize = uint32_t(image.size());
 
-                    int16_t* data = new int16_t[nSamples + 1];  // allocate extra in case we need to tack on.
-                    wave_reader_get_samples(wr, nSamples, data);
-                    if (rate == 44100) {
-                        data = covert44to22(nSamples, data, &nSamples);
-                    }
-                    if (nSamples & 1) {
-                        data[nSamples] = data[nSamples - 1];
-                        nSamples++;
-                    }
-                    if (rotateToZero) {
-                        int r = rotateZero(data, nSamples);
-                        printf("%s rotated %d samples.\n", fname, r);
-                    }
-                    EncodedStream es = compressGroup(data, nSamples);
-                    totalError += int64_t(es.aveError2) * int64_t(nSamples);
-                    simpleError += int64_t(es.aveError2);
+    Manifest manifest;
+    if (!manifest.load(image.data(), imageSize)) {
+        printf("'%s' is not a valid image.\n", name);
+        return 1;
+    }
 
-                    if (post) {
-                        std::string f = postPath + fname;
-                        saveOut(f.c_str(), es.stereo.get(), nSamples);
-                    }
-                    image.addFile(stdfname.c_str(), es.compressed.get(), es.nCompressed, es.table, es.predictor, es.aveError2);
+    char desc[MemImage::SIZE_DESC + 1] = { 0 };
+    if (manifest.descAddr() + MemImage::SIZE_DESC <= imageSize)
+        memcpy(desc, image.data() + manifest.descAddr(), MemImage::SIZE_DESC);
+    printf("Image '%s': %d bytes, version %d, %d dirs, %d files\n",
+        name, int(imageSize), manifest.version(), manifest.numDir(), manifest.numFile());
+    printf("Description=%s\n", desc);
+
+    for (int i = 0; i < MemPalette::NUM_PALETTES; ++i) {
+        MemPalette palette;
+        if (manifest.paletteAddr(i) + sizeof(MemPalette) > imageSize)
+            break;
+        memcpy(&palette, image.data() + manifest.paletteAddr(i), sizeof(MemPalette));
+        printf("  %d font=%d bc=%02x%02x%02x ic=%02x%02x%02x\n",
+            i,
+            palette.soundFont,
+            palette.bladeColor.r, palette.bladeColor.g, palette.bladeColor.b,
+            palette.impactColor.r, palette.impactColor.g, palette.impactColor.b);
+    }
 
-                    delete[] data;
-                    wave_reader_close(wr);
-                }
+    // List everything; decode what is selected (all of it, if nothing is.)
+    std::vector<MemUnit> units;
+    std::vector<std::string> names;
+    for (int d = 0; d < manifest.numDir(); ++d) {
+        char dirName[MemUnit::NAME_ALLOC] = { 0 };
+        memcpy(dirName, manifest.getUnit(d).name, MemUnit::NAME_LEN);
+        if (!dirName[0])
+            continue;
+        printf("Dir: %s\n", dirName);
+
+        int start = 0, n = 0;
+        manifest.dirRange(d, &start, &n);
+        for (int i = start; i < start + n; ++i) {
+            const MemUnit& unit = manifest.getUnit(i);
+            char fileName[MemUnit::NAME_ALLOC] = { 0 };
+            memcpy(fileName, unit.name, MemUnit::NAME_LEN);
+            printf("   %8s at %8d size=%6d (%3dk) time=%6dms %-3s table=%2d predictor=%2d\n",
+                fileName, int(unit.offset), int(unit.size), int(unit.size / 1024),
+                int(unit.timeInMSec()), MemUnit::CodecName(unit.codec), unit.table, unit.predictor);
+
+            std::string path = std::string(dirName) + "/" + fileName;
+            bool selected = select.empty();
+            for (const std::string& s : select)
+                selected = selected || s == dirName || s == path;
+            if (outPath && selected && unit.size) {
+                units.push_back(unit);
+                names.push_back(std::string(outPath) + dirName + "_" + fileName + ".wav");
             }
         }
     }
+    if (units.empty())
+        return 0;
+
+    // S4 units first, so they can be batched for the lanes decoder.
+    std::vector<int> order(units.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = int(i);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        return (units[a].codec == MemUnit::CODEC_S4) > (units[b].codec == MemUnit::CODEC_S4);
+    });
+    {
+        std::vector<MemUnit> sortedUnits;
+        std::vector<std::string> sortedNames;
+        for (int i : order) {
+            sortedUnits.push_back(units[i]);
+            sortedNames.push_back(names[i]);
+        }
+        units.swap(sortedUnits);
+        names.swap(sortedNames);
+    }
+    const int nFiles = int(units.size());
+    std::vector<std::vector<int16_t>> pcm(nFiles);
+
+    // ITaskSets can't be moved, so allocate for the most tasks up front.
+    std::unique_ptr<DecodeTask[]> tasks(new DecodeTask[nFiles]);
+    int nTasks = 0;
+    for (int i = 0; i < nFiles; ) {
+        DecodeTask& task = tasks[nTasks++];
+        task.image = image.data();
+        task.imageSize = imageSize;
+        task.units = units.data();
+        task.pcm = pcm.data();
+        task.first = i;
+        task.count = 1;
+        if (units[i].codec == MemUnit::CODEC_S4) {
+            while (task.count < DecodeTask::BATCH && i + task.count < nFiles && units[i + task.count].codec == MemUnit::CODEC_S4)
+                task.count++;
+        }
+        i += task.count;
+    }
 
-    image.writeDesc(imageFileName.c_str());
-
-    image.dumpConsole();
-    printf("TotalError = %lld  SimpleError = %lld\n", totalError / int64_t(1'000'000'000), simpleError / 1000);
-    printf("Num Dirs=%d/%d Files=%d/%d\n", image.getNumDirs(), MemImage::NUM_DIR, image.getNumFiles(), MemImage::NUM_FILES);
-    if (image.getNumDirs() > MemImage::NUM_DIR)
-        printf("ERROR too many directories\n");
-    if (image.getNumFiles() > MemImage::NUM_FILES)
-        printf("ERROR too many files\n");
-    if (textFile) {
-        image.writeText((imageFileName + ".txt").c_str());
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < nTasks; ++i)
+        taskScheduler().AddTaskSetToPipe(&tasks[i]);
+    taskScheduler().WaitforAll();
+    auto end = std::chrono::high_resolution_clock::now();
+
+    int64_t nSamples = 0, nBytes = 0;
+    for (int i = 0; i < nFiles; ++i) {
+        WavWriter writer;
+        if (writer.open(names[i].c_str())) {
+            writer.put(pcm[i].data(), int(pcm[i].size()));
+            writer.close();
+        }
+        nSamples += units[i].numSamples();
+        nBytes += units[i].size;
     }
+
+    double sec = std::chrono::duration<double>(end - start).count();
+    if (sec <= 0) sec = 1e-9;
+    printf("Decoded %d files, %lld samples (%.1f sec of audio) in %.2f ms: %.1f Msamples/sec, %.1f MB/sec compressed\n",
+        nFiles, (long long)nSamples, nSamples / 22050.0, sec * 1000.0,
+        nSamples / sec / 1e6, nBytes / sec / (1024.0 * 1024.0));
     return 0;
 }
@@ -21,11 +21,41 @@
 */
 
 #include "manifest.h"
+#include "../wav12/interface.h"
+#include "../wav12/s4adpcm.h"
 #include <memory.h>
+#include <string.h>
 #include <assert.h>
 
 #define TEST(x) { if (!(x)) { assert(false); return false; }}
 
+const char* MemUnit::CodecName(int codec)
+{
+    switch (codec) {
+    case CODEC_S4: return "s4";
+    case CODEC_IMA: return "ima";
+    case CODEC_S3: return "s3";
+    case CODEC_S2: return "s2";
+    default: return "?";
+    }
+}
+
+int MemUnit::CodecFromName(const char* name)
+{
+    for (int c = 0; c < NUM_CODECS; ++c) {
+        const char* a = CodecName(c);
+        const char* b = name;
+        // The names are lower case letters and digits.
+        while (*a && (*a == *b || (*b >= 'A' && *b <= 'Z' && *a == *b - 'A' + 'a'))) {
+            ++a;
+            ++b;
+        }
+        if (*a == 0 && *b == 0)
+            return c;
+    }
+    return -1;
+}
+
 uint32_t MemUnit::nameHash(uint32_t h) const
 {
     for (int i = 0; i < NAME_LEN; ++i) {
@@ -37,6 +67,40 @@ uint32_t MemUnit::nameHash(uint32_t h) const
     return h;
 }
 
+uint32_t MemUnit::KeyHash(uint64_t key, uint32_t h)
+{
+    // Same hash as nameHash(), so KeyHash(nameKey(), h) == nameHash(h)
+    char n[NAME_LEN];
+    memcpy(n, &key, NAME_LEN);
+    for (int i = 0; i < NAME_LEN; ++i) {
+        h = ((h << 5) + h) ^ n[i];
+    }
+    return h;
+}
+
+uint64_t MemUnit::nameKey() const
+{
+    static_assert(sizeof(uint64_t) == NAME_LEN, "name is one 64 bit key");
+    uint64_t key;
+    memcpy(&key, name, NAME_LEN);
+    return key;
+}
+
+bool MemUnit::NameKey(const char* n, uint64_t* key)
+{
+    if (n == 0 || *n == 0)
+        return false;
+
+    char buf[NAME_LEN] = { 0 };
+    for (int i = 0; n[i]; ++i) {
+        if (i == NAME_LEN)
+            return false;
+        buf[i] = n[i];
+    }
+    memcpy(key, buf, NAME_LEN);
+    return true;
+}
+
 bool MemUnit::nameMatch(const char* n) const
 {
     if (n == 0 || *n == 0 || *name == 0)
@@ -54,58 +118,298 @@ bool MemUnit::nameMatch(const char* n) const
 }
 
 
+namespace {
+    // Lets an image in memory be read through the same path as SPI flash.
+    class MemoryReader : public IMemory {
+    public:
+        MemoryReader(const uint8_t* data, uint32_t size) : m_data(data), m_size(size) {}
+
+        virtual void readMemory(uint32_t addr, uint8_t* data, uint32_t len) {
+            memset(data, 0, len);
+            if (addr < m_size) {
+                uint32_t n = len < m_size - addr ? len : m_size - addr;
+                memcpy(data, m_data + addr, n);
+            }
+        }
+        virtual int32_t memorySize() { return int32_t(m_size); }
+
+    private:
+        const uint8_t* m_data;
+        uint32_t m_size;
+    };
+}
+
+// A file's table and predictor have to exist, or the expander would read
+// past the tables.
+static bool ValidCoding(const MemUnit& unit)
+{
+    if (unit.codec >= MemUnit::NUM_CODECS)
+        return false;
+    if (unit.codec == MemUnit::CODEC_IMA)
+        return true;
+    return unit.table < S4ADPCM::numTables(MemUnit::CodecBits(unit.codec))
+        && unit.predictor < S4ADPCM::State::N_PREDICTOR;
+}
+
 Manifest::Manifest()
 {
-    memset(image.unit, 0, MemImage::SIZE_MEMUNITS);
+}
+
+Manifest::Manifest(void* buffer, uint32_t size) : m_buffer((uint8_t*)buffer), m_bufferSize(size)
+{
+}
+
+Manifest::~Manifest()
+{
+    clear();
+}
+
+static uint32_t IndexSize(int numUnits)
+{
+    uint32_t size = 16;
+    while (size < uint32_t(numUnits) * 2)
+        size *= 2;
+    return size;
+}
+
+uint32_t Manifest::BufferSize(int numUnits)
+{
+    return uint32_t(numUnits) * sizeof(MemUnit) + IndexSize(numUnits) * sizeof(uint16_t);
+}
+
+bool Manifest::reserve(int numUnits)
+{
+    const uint32_t bytes = BufferSize(numUnits);
+    uint8_t* mem = m_buffer;
+    if (!mem) {
+        m_alloc = new uint8_t[bytes];
+        mem = m_alloc;
+    }
+    else if (bytes > m_bufferSize) {
+        return false;
+    }
+    // sizeof(MemUnit) is a multiple of 4, so the index is aligned too.
+    m_unit = (MemUnit*)mem;
+    m_index = (uint16_t*)(mem + numUnits * sizeof(MemUnit));
+    m_indexSize = IndexSize(numUnits);
+    return true;
+}
+
+void Manifest::clear()
+{
+    delete[] m_alloc;
+    m_alloc = nullptr;
+    m_unit = nullptr;
+    m_index = nullptr;
+    m_version = 0;
+    m_numDir = 0;
+    m_numUnits = 0;
+    m_indexSize = 0;
+    m_descAddr = 0;
+    m_paletteAddr = 0;
+}
+
+bool Manifest::load(const uint8_t* data, uint32_t size)
+{
+    MemoryReader reader(data, size);
+    return load(&reader);
+}
+
+bool Manifest::load(IMemory* memory)
+{
+    clear();
+
+    MemImage header;
+    memory->readMemory(0, (uint8_t*)&header, sizeof(header));
+
+    bool okay = false;
+    if (header.magic == MemImage::MAGIC)
+        okay = loadV2(memory, header);
+    else
+        okay = loadV1(memory);
+
+    if (!okay) {
+        clear();
+        return false;
+    }
+
+    // Sanity check the dirs, so that dirRange() can be trusted.
+    for (int d = 0; d < m_numDir; ++d) {
+        const MemUnit& dir = m_unit[d];
+        if (dir.size && (dir.offset < uint32_t(m_numDir) || dir.offset > uint32_t(m_numUnits) || dir.size > m_numUnits - dir.offset)) {
+            clear();
+            return false;
+        }
+    }
+    buildIndex();
+    return true;
+}
+
+bool Manifest::loadV1(IMemory* memory)
+{
+    if (memory->memorySize() < int32_t(MemImageV1::SIZE_BASE))
+        return false;
+
+    m_version = 1;
+    m_numDir = MemImageV1::NUM_DIR;
+    m_numUnits = MemImageV1::NUM_MEMUNITS;
+    m_descAddr = MemImageV1::SIZE_MEMUNITS;
+    m_paletteAddr = MemImageV1::SIZE_MEMUNITS + MemImageV1::SIZE_DESC;
+    if (!reserve(m_numUnits))
+        return false;
+
+    // One unit at a time, so there is no need for a v1 sized buffer.
+    for (int i = 0; i < m_numUnits; ++i) {
+        MemUnitV1 v1;
+        memory->readMemory(i * sizeof(MemUnitV1), (uint8_t*)&v1, sizeof(v1));
+
+        MemUnit& unit = m_unit[i];
+        memset(&unit, 0, sizeof(unit));
+        memcpy(unit.name, v1.name, MemUnit::NAME_LEN);
+        unit.offset = v1.offset;
+        unit.size = v1.size;
+        unit.table = v1.table;
+        unit.predictor = v1.predictor;
+
+        const uint32_t size = uint32_t(memory->memorySize());
+        if (i >= m_numDir && (unit.offset > size || unit.size > size - unit.offset || !ValidCoding(unit)))
+            return false;
+    }
+    return true;
+}
+
+bool Manifest::loadV2(IMemory* memory, const MemImage& header)
+{
+    const uint32_t numUnits = uint32_t(header.numDir) + header.numFile;
+    if (header.version != MemImage::VERSION
+        || numUnits > uint32_t(MAX_UNITS)
+        || header.size < MemImage::DataAddr(numUnits)
+        || header.size > uint32_t(memory->memorySize()))
+    {
+        return false;
+    }
+
+    m_version = header.version;
+    m_numDir = header.numDir;
+    m_numUnits = int(numUnits);
+    m_descAddr = MemImage::DESC_ADDR;
+    m_paletteAddr = MemImage::PALETTE_ADDR;
+    if (!reserve(m_numUnits))
+        return false;
+    memory->readMemory(MemImage::UNIT_ADDR, (uint8_t*)m_unit, numUnits * sizeof(MemUnit));
+
+    for (int i = m_numDir; i < m_numUnits; ++i) {
+        if (m_unit[i].offset > header.size || m_unit[i].size > header.size - m_unit[i].offset)
+            return false;
+        if (!ValidCoding(m_unit[i]))
+            return false;
+    }
+    return true;
 }
 
 const MemUnit& Manifest::getUnit(int id) const
 {
+    static const MemUnit EMPTY = { { 0 }, 0, 0, 0, 0, 0, 0 };
+    if (m_numUnits == 0) return EMPTY;
+
     if (id < 0) id = 0;
-    if (id >= MemImage::NUM_MEMUNITS) id = MemImage::NUM_MEMUNITS - 1;
-    return image.unit[id];
+    if (id >= m_numUnits) id = m_numUnits - 1;
+    return m_unit[id];
+}
+
+void Manifest::addIndex(int id, uint32_t parent)
+{
+    const MemUnit& unit = m_unit[id];
+    if (unit.name[0] == 0)
+        return;
+
+    // Linear probing. Duplicate names hash to the same chain, so the
+    // first one added is found first, same as a linear search.
+    const uint32_t mask = m_indexSize - 1;
+    uint32_t slot = unit.nameHash(parent) & mask;
+    while (m_index[slot]) {
+        slot = (slot + 1) & mask;
+    }
+    m_index[slot] = uint16_t(id + 1);
 }
 
-int Manifest::find(const char* name, int start, int n) const
+void Manifest::buildIndex()
 {
-    for(int i=0; i<n; ++i) {
-        if (image.unit[i + start].nameMatch(name)) {
-            return i + start;
+    memset(m_index, 0, m_indexSize * sizeof(uint16_t));
+
+    // Dirs are hashed with a parent of numDir, files with the parent dir.
+    for (int d = 0; d < m_numDir; ++d) {
+        addIndex(d, m_numDir);
+    }
+    for (int d = 0; d < m_numDir; ++d) {
+        if (m_unit[d].name[0] == 0)
+            continue;
+        int start = 0, count = 0;
+        dirRange(d, &start, &count);
+        for (int i = 0; i < count; ++i) {
+            addIndex(start + i, d);
         }
     }
+}
+
+int Manifest::find(const char* name, uint32_t parent, int start, int n) const
+{
+    uint64_t key = 0;
+    if (!m_index || !MemUnit::NameKey(name, &key))
+        return -1;
+
+    const uint32_t mask = m_indexSize - 1;
+    uint32_t slot = MemUnit::KeyHash(key, parent) & mask;
+    while (m_index[slot]) {
+        int id = m_index[slot] - 1;
+        if (id >= start && id < start + n && m_unit[id].nameKey() == key)
+            return id;
+        slot = (slot + 1) & mask;
+    }
     return -1;
 }
 
 int Manifest::getDir(const char* name) const
 {
-    int dir = find(name, 0, MemImage::NUM_DIR);
+    int dir = find(name, m_numDir, 0, m_numDir);
     return dir;
 }
 
 void Manifest::dirRange(int dir, int* start, int* count) const
 {
+    *start = 0;
+    *count = 0;
+    if (m_numDir == 0) return;
+
     if (dir < 0) dir = 0;
-    if (dir >= MemImage::NUM_DIR) dir = MemImage::NUM_DIR - 1;
+    if (dir >= m_numDir) dir = m_numDir - 1;
 
-    *start = image.unit[dir].offset;   // gah. ugly. need to fix in the generator.
-    *count = image.unit[dir].size;
+    *start = m_unit[dir].offset;   // gah. ugly. need to fix in the generator.
+    *count = m_unit[dir].size;
 }
 
 int Manifest::getFile(int dir, const char* fname) const
 {
-    if (dir < 0 || dir >= MemImage::NUM_DIR)
+    if (dir < 0 || dir >= m_numDir)
         return -1;
 
     int start = 0;
     int count = 0;
     dirRange(dir, &start, &count);
 
-    return find(fname, start, count);
+    return find(fname, dir, start, count);
 }
 
 
 bool Manifest::Test()
 {
+    for (int c = 0; c < MemUnit::NUM_CODECS; ++c)
+        TEST(MemUnit::CodecFromName(MemUnit::CodecName(c)) == c);
+    TEST(MemUnit::CodecFromName("IMA") == MemUnit::CODEC_IMA);
+    TEST(MemUnit::CodecFromName("S3") == MemUnit::CODEC_S3);
+    TEST(MemUnit::CodecFromName("s") == -1);
+    TEST(MemUnit::CodecFromName("s44") == -1);
+    TEST(MemUnit::CodecFromName("") == -1);
     {
         MemUnit mu;
         memset(&mu, 0, sizeof(mu));
@@ -119,6 +423,87 @@ bool Manifest::Test()
         TEST(mu.nameMatch("12345678"));
         TEST(!mu.nameMatch("12345678a"));
         TEST(!mu.nameMatch("1234567"));
+
+        uint64_t key = 0;
+        TEST(MemUnit::NameKey("12345678", &key));
+        TEST(key == mu.nameKey());
+        TEST(MemUnit::KeyHash(key, 7) == mu.nameHash(7));
+        TEST(!MemUnit::NameKey("123456789", &key));
+        TEST(!MemUnit::NameKey("", &key));
+    }
+    {
+        // A version 1 image, including the same file name in different
+        // directories. (Version 2 is tested by MemImageUtil.)
+        static const int NUM_DIR = MemImageV1::NUM_DIR;
+        uint8_t* data = new uint8_t[MemImageV1::SIZE_BASE + 16];
+        memset(data, 0, MemImageV1::SIZE_BASE + 16);
+        MemUnitV1* unit = ((MemImageV1*)data)->unit;
+
+        memcpy(unit[0].name, "font0", 5);
+        unit[0].offset = NUM_DIR;
+        unit[0].size = 3;
+        memcpy(unit[1].name, "font1", 5);
+        unit[1].offset = NUM_DIR + 3;
+        unit[1].size = 2;
+        memcpy(unit[NUM_DIR + 0].name, "hum", 3);
+        memcpy(unit[NUM_DIR + 1].name, "swing01", 7);
+        memcpy(unit[NUM_DIR + 2].name, "clash012", 8);
+        memcpy(unit[NUM_DIR + 3].name, "clash012", 8);
+        memcpy(unit[NUM_DIR + 4].name, "hum", 3);
+        unit[NUM_DIR + 4].offset = MemImageV1::SIZE_BASE;
+        unit[NUM_DIR + 4].size = 16;
+        unit[NUM_DIR + 4].table = 5;
+        unit[NUM_DIR + 4].predictor = 3;
+
+        Manifest m;
+        TEST(m.load(data, MemImageV1::SIZE_BASE + 16));
+        TEST(m.version() == 1);
+        TEST(m.numDir() == NUM_DIR);
+        TEST(m.descAddr() == MemImageV1::SIZE_MEMUNITS);
+        TEST(m.getDir("font0") == 0);
+        TEST(m.getDir("font1") == 1);
+        TEST(m.getDir("font2") < 0);
+        TEST(m.getDir("hum") < 0);
+        TEST(m.getFile("font0", "hum") == NUM_DIR + 0);
+        TEST(m.getFile("font0", "clash012") == NUM_DIR + 2);
+        TEST(m.getFile("font1", "clash012") == NUM_DIR + 3);
+        TEST(m.getFile("font1", "hum") == NUM_DIR + 4);
+        TEST(m.getFile("font1", "swing01") < 0);
+        TEST(m.getFile("font0", "clash0123") < 0);
+        TEST(m.getFile("font0", "") < 0);
+
+        const MemUnit& hum = m.getUnit(m.getFile("font1", "hum"));
+        TEST(hum.offset == MemImageV1::SIZE_BASE);
+        TEST(hum.size == 16);
+        TEST(hum.table == 5);
+        TEST(hum.predictor == 3);
+
+        // Too short to be either version.
+        TEST(!m.load(data, 100));
+        TEST(m.getDir("font0") < 0);
+
+        // A file past the end, or with a table that doesn't exist.
+        TEST(!m.load(data, MemImageV1::SIZE_BASE + 15));
+        unit[NUM_DIR + 4].table = S4ADPCM::N_TABLES;
+        TEST(!m.load(data, MemImageV1::SIZE_BASE + 16));
+        unit[NUM_DIR + 4].table = 5;
+        TEST(m.load(data, MemImageV1::SIZE_BASE + 16));
+
+        // Dir pointing outside the units.
+        unit[1].size = 200;
+        TEST(!m.load(data, MemImageV1::SIZE_BASE + 16));
+        unit[1].size = 2;
+
+        // In the caller's buffer: the same, and too small is an error.
+        static uint32_t buffer[1024];
+        TEST(Manifest::BufferSize(MemImageV1::NUM_MEMUNITS) <= sizeof(buffer));
+        Manifest fixed(buffer, Manifest::BufferSize(MemImageV1::NUM_MEMUNITS));
+        TEST(fixed.load(data, MemImageV1::SIZE_BASE + 16));
+        TEST(fixed.getFile("font1", "hum") == NUM_DIR + 4);
+        TEST((const void*)&fixed.getUnit(0) == (const void*)buffer);
+        Manifest small(buffer, Manifest::BufferSize(MemImageV1::NUM_MEMUNITS) - 1);
+        TEST(!small.load(data, MemImageV1::SIZE_BASE + 16));
+        delete[] data;
     }
 
     return true;
@@ -25,26 +25,64 @@
 #include <stdint.h>
 #include <cstddef>
 
+class IMemory;
+
 struct MemUnit {
     static constexpr int NAME_LEN = 8;
     static constexpr int NAME_ALLOC = NAME_LEN + 1; // not used here, but amount to allocate if you need to null-terminate
 
     char name[NAME_LEN];   // NOT null terminated, but 0-filled.
-    uint32_t offset;
-    uint32_t size : 24;     // if needed, an extra sample is added so that size==nSamples
-    uint32_t table : 4;     // 0-15 to select table
-    uint32_t predictor : 3; // 0-4 
-    uint32_t pad : 1;
+    uint32_t offset;       // dir: id of the first file unit. file: address in the image.
+    uint32_t size;         // dir: number of files. file: bytes. if needed, an extra sample is added so that size==nSamples
+    uint8_t table;         // 0-15 to select table
+    uint8_t predictor;     // 0-4
+    uint8_t codec;         // CODEC_*. Was padding (always 0), so older images are S4.
+    uint8_t pad;
+
+    enum {
+        CODEC_S4,           // S4ADPCM, with 'table' and 'predictor'
+        CODEC_IMA,          // IMA ADPCM; 'table' and 'predictor' are unused
+        CODEC_S3,           // S4ADPCM 3 bit mode
+        CODEC_S2,           // S4ADPCM 2 bit mode
+        NUM_CODECS
+    };
+    static int CodecBits(int codec) {
+        return codec == CODEC_S3 ? 3 : codec == CODEC_S2 ? 2 : 4;
+    }
 
-    uint32_t numSamples() const { return size * 2; }
+    uint32_t numSamples() const { return uint32_t(uint64_t(size) * 8 / CodecBits(codec)); }
     uint32_t timeInMSec() const {
-        return numSamples() * 100 / 2205;
+        return uint32_t(uint64_t(numSamples()) * 100 / 2205);
     }
     bool nameMatch(const char* n) const;
     uint32_t nameHash(uint32_t h) const;
+
+    // The 8 bytes of the name as one value, so a match is a single compare.
+    uint64_t nameKey() const;
+    // Converts 'n' to the key it would have as a name. Returns false if 'n'
+    // can't be a name (empty or longer than NAME_LEN).
+    static bool NameKey(const char* n, uint64_t* key);
+    static uint32_t KeyHash(uint64_t key, uint32_t h);
+
+    // "s4", "ima", "s3", "s2"
+    static const char* CodecName(int codec);
+    // The CODEC_* with that name, in any case; -1 if there isn't one.
+    static int CodecFromName(const char* name);
+};
+
+static_assert(sizeof(MemUnit) == 20, "20 byte MemUnit");
+
+// The unit of the original (version 1) image: 24 bit sizes. Only used to read old images.
+struct MemUnitV1 {
+    char name[MemUnit::NAME_LEN];
+    uint32_t offset;
+    uint32_t size : 24;
+    uint32_t table : 4;
+    uint32_t predictor : 3;
+    uint32_t pad : 1;
 };
 
-static_assert(sizeof(MemUnit) == 16, "16 byte MemUnit");
+static_assert(sizeof(MemUnitV1) == 16, "16 byte MemUnitV1");
 
 struct MemPalette {
     static constexpr int NUM_PALETTES = 8;
@@ -59,7 +97,8 @@ struct MemPalette {
     RGB impactColor = { 0, 0, 0 };
 };
 
-struct MemImage {
+// Version 1 image: fixed tables, 4 dirs and 92 files.
+struct MemImageV1 {
     static const int NUM_DIR = 4;
     static const int NUM_FILES = 96 - NUM_DIR;
     static const int NUM_MEMUNITS = NUM_DIR + NUM_FILES;
@@ -67,21 +106,86 @@ struct MemImage {
     static const size_t SIZE_DESC = 64;                                                 // null filled terminated string. Follows the MemUnits.
     static const size_t SIZE_PALETTE = MemPalette::NUM_PALETTES * sizeof(MemPalette);   // palettes - follows the description
     
-    static const size_t SIZE_MEMUNITS = NUM_MEMUNITS * sizeof(MemUnit);
+    static const size_t SIZE_MEMUNITS = NUM_MEMUNITS * sizeof(MemUnitV1);
     static const size_t SIZE_BASE = SIZE_MEMUNITS + SIZE_DESC + SIZE_PALETTE;
 
-    MemUnit unit[NUM_MEMUNITS];
+    MemUnitV1 unit[NUM_MEMUNITS];
+};
+
+/*
+    Version 2 image. The layout is:
+        MemImage        header
+        description     SIZE_DESC
+        palettes        SIZE_PALETTE
+        MemUnit         numDir dirs, then numFile files
+        data            sound data, addressed by MemUnit::offset
+
+    The magic number starts with 0xff, which can't be the first character
+    of a v1 directory name, so the two versions can be told apart.
+*/
+struct MemImage {
+    static const uint32_t MAGIC = 0x323157ff;   // 0xff 'W' '1' '2'
+    static const uint16_t VERSION = 2;
+
+    static const size_t SIZE_DESC = 64;
+    static const size_t SIZE_PALETTE = MemPalette::NUM_PALETTES * sizeof(MemPalette);
+    static const size_t SIZE_HEADER = 16;
+
+    static const uint32_t DESC_ADDR = SIZE_HEADER;
+    static const uint32_t PALETTE_ADDR = DESC_ADDR + SIZE_DESC;
+    static const uint32_t UNIT_ADDR = PALETTE_ADDR + SIZE_PALETTE;
+
+    static uint32_t DataAddr(uint32_t numUnits) { return UNIT_ADDR + numUnits * sizeof(MemUnit); }
+
+    uint32_t magic;
+    uint16_t version;
+    uint16_t numDir;
+    uint32_t numFile;
+    uint32_t size;      // total size of the image, in bytes
 };
 
+static_assert(sizeof(MemImage) == MemImage::SIZE_HEADER, "16 byte MemImage header");
+static_assert(MemImage::UNIT_ADDR % 4 == 0, "MemUnits are aligned");
 
+
+/*
+    The directory of an image. Since the unit table has a variable size,
+    this replaces getBasePtr() and the fixed MemImage block the SPI reader
+    used to fill: load() reads what it needs through IMemory.
+
+    The units and the name index need BufferSize(numUnits) bytes. On a
+    device, give it a buffer (static, sized for the largest image it will
+    take) and load() never allocates. Without one, load() allocates what
+    the image needs with new[].
+*/
 class Manifest
 {
     public:
+        // Limited by the 16 bit entries of the index.
+        static const int MAX_UNITS = 0xfffe;
+
         Manifest();
-        // Used by the SPI readed to initialize the block of memory.
-        MemImage* getBasePtr() { return &image; }
-        static uint32_t DescAddr() { return MemImage::SIZE_MEMUNITS; }
-        static uint32_t PaletteAddr(int index) { return MemImage::SIZE_MEMUNITS + MemImage::SIZE_DESC + index * sizeof(MemPalette); }
+        // 'buffer' (4 byte aligned) is used for the units and the index, in
+        // place of new[]. An image that needs more than 'size' fails to load.
+        Manifest(void* buffer, uint32_t size);
+        ~Manifest();
+
+        // Bytes of buffer needed for an image of 'numUnits' dirs and files.
+        static uint32_t BufferSize(int numUnits);
+
+        // Reads the directory, file, and palette info (not the sound data)
+        // from a version 1 or 2 image. Returns false if the image isn't
+        // recognized, or doesn't fit the buffer. The IMemory version is
+        // used by the SPI reader.
+        bool load(IMemory* memory);
+        bool load(const uint8_t* data, uint32_t size);
+
+        int version() const { return m_version; }
+        int numDir() const { return m_numDir; }
+        int numFile() const { return m_numUnits - m_numDir; }
+        int numUnits() const { return m_numUnits; }
+        uint32_t descAddr() const { return m_descAddr; }
+        uint32_t paletteAddr(int index) const { return m_paletteAddr + index * sizeof(MemPalette); }
 
         const MemUnit& getUnit(int id) const;
         
@@ -92,11 +196,35 @@ class Manifest
         }
 
         void dirRange(int dir, int* start, int* count) const;
-        static bool Test();
 
-    private:        
-        int find(const char* name, int start, int n) const;
+        static bool Test();
 
-        MemImage image;
+    private:
+        Manifest(const Manifest&) = delete;
+        void operator=(const Manifest&) = delete;
+
+        void clear();
+        // Points m_unit and m_index at room for 'numUnits'.
+        bool reserve(int numUnits);
+        bool loadV1(IMemory* memory);
+        bool loadV2(IMemory* memory, const MemImage& header);
+
+        // Builds the hash index used by getDir() and getFile().
+        void buildIndex();
+        void addIndex(int id, uint32_t parent);
+        int find(const char* name, uint32_t parent, int start, int n) const;
+
+        int m_version = 0;
+        int m_numDir = 0;
+        int m_numUnits = 0;
+        uint32_t m_descAddr = 0;
+        uint32_t m_paletteAddr = 0;
+        MemUnit* m_unit = nullptr;
+
+        uint32_t m_indexSize = 0;       // power of 2, at least twice the units to keep probes short
+        uint16_t* m_index = nullptr;    // unit id + 1; 0 is an empty slot
+
+        uint8_t* m_buffer = nullptr;    // the caller's, if there is one
+        uint32_t m_bufferSize = 0;
+        uint8_t* m_alloc = nullptr;     // else allocated by load()
 };
-
@@ -40,7 +40,7 @@ read_int32_b(FILE *fp, int *out)
     if ((result=read_byte(fp, &c)) != 1) return result;
     if ((result=read_byte(fp, &d)) != 1) return result;
 
-    *out = (a<<24) | (b<<16) | (c<<8) | (d<<0);
+    *out = (int)(((unsigned)a<<24) | (b<<16) | (c<<8) | (d<<0));
     return 1;
 }
 
@@ -55,7 +55,7 @@ read_int32_l(FILE *fp, int *out)
     if ((result=read_byte(fp, &c)) != 1) return result;
     if ((result=read_byte(fp, &d)) != 1) return result;
 
-    *out = (d<<24) | (c<<16) | (b<<8) | (a<<0);
+    *out = (int)(((unsigned)d<<24) | (c<<16) | (b<<8) | (a<<0));
     return 1;
 }
 
@@ -76,7 +76,8 @@ static int
 read_wave_chunk(struct wave_reader *wr, wave_reader_error *error)
 {
     int result;
-    int sub1_id, sub1_len, sub2_id, sub2_len, byte_rate, block_align;
+    int sub1_id, sub1_len, sub2_id, sub2_len, byte_rate, block_align, frame_bytes;
+    long pos, end;
 
     if ((result=read_int32_b(wr->fp, &sub1_id)) != 1) {
         *error = result == 0 ? WR_BAD_CONTENT : WR_IO_ERROR;
@@ -123,22 +124,59 @@ read_wave_chunk(struct wave_reader *wr, wave_reader_error *error)
         return 0;
     }
 
-    if ((result=read_int32_b(wr->fp, &sub2_id)) != 1) {
-        *error = result == 0 ? WR_BAD_CONTENT : WR_IO_ERROR;
+    if (sub1_len < 16 || wr->num_channels <= 0 || wr->sample_bits <= 0
+        || wr->sample_bits > 32 || wr->sample_bits % 8 != 0) {
+        *error = WR_BAD_CONTENT;
         return 0;
     }
 
-    if (sub2_id != FOUR_CC('d','a','t','a')) {
-        *error = WR_BAD_CONTENT;
+    frame_bytes = wr->num_channels * wr->sample_bits / 8;
+
+    /* The rest of a longer fmt chunk (WAVE_FORMAT_EXTENSIBLE), and the pad byte. */
+    if (fseek(wr->fp, (long)(sub1_len - 16) + (sub1_len & 1), SEEK_CUR) == -1) {
+        *error = WR_IO_ERROR;
         return 0;
     }
 
-    if ((result=read_int32_l(wr->fp, &sub2_len)) != 1) {
-        *error = result == 0 ? WR_BAD_CONTENT : WR_IO_ERROR;
+    /* Other chunks (LIST, fact) can come before the data. */
+    for (;;) {
+        if ((result=read_int32_b(wr->fp, &sub2_id)) != 1) {
+            *error = result == 0 ? WR_BAD_CONTENT : WR_IO_ERROR;
+            return 0;
+        }
+
+        if ((result=read_int32_l(wr->fp, &sub2_len)) != 1) {
+            *error = result == 0 ? WR_BAD_CONTENT : WR_IO_ERROR;
+            return 0;
+        }
+
+        if (sub2_len < 0) {
+            *error = WR_BAD_CONTENT;
+            return 0;
+        }
+
+        if (sub2_id == FOUR_CC('d','a','t','a')) {
+            break;
+        }
+
+        if (fseek(wr->fp, (long)sub2_len + (sub2_len & 1), SEEK_CUR) == -1) {
+            *error = WR_IO_ERROR;
+            return 0;
+        }
+    }
+
+    /* No more than the file holds, so a bad length can't ask for a huge buffer. */
+    pos = ftell(wr->fp);
+    if (pos < 0 || fseek(wr->fp, 0, SEEK_END) == -1 || (end = ftell(wr->fp)) < 0
+        || fseek(wr->fp, pos, SEEK_SET) == -1) {
+        *error = WR_IO_ERROR;
         return 0;
     }
+    if (sub2_len > end - pos) {
+        sub2_len = (int)(end - pos);
+    }
 
-    wr->num_samples = sub2_len / (wr->num_channels * wr->sample_bits / 8);
+    wr->num_samples = sub2_len / frame_bytes;
 
     return 1;
 }
@@ -148,12 +186,18 @@ skip(struct wave_reader *wr, wave_reader_error *error)
 {
     int len;
 
-    if (!read_int32_l(wr->fp, &len)) {
+    if (read_int32_l(wr->fp, &len) != 1) {
         *error = WR_IO_ERROR;
         return 0;
     }
 
-    if (fseek(wr->fp, len, SEEK_CUR) == -1) {
+    /* A negative length would go backwards, and maybe loop forever. */
+    if (len < 0) {
+        *error = WR_BAD_CONTENT;
+        return 0;
+    }
+
+    if (fseek(wr->fp, (long)len + (len & 1), SEEK_CUR) == -1) {
         *error = WR_IO_ERROR;
         return 0;
     }
@@ -163,12 +207,29 @@ skip(struct wave_reader *wr, wave_reader_error *error)
 
 struct wave_reader *
 wave_reader_open(const char *filename, wave_reader_error *error)
+{
+    FILE *fp;
+
+    assert(filename != NULL);
+    assert(error != NULL);
+
+    fp = fopen(filename, "rb");
+    if (!fp) {
+        *error = WR_OPEN_ERROR;
+        return NULL;
+    }
+
+    return wave_reader_open_file(fp, error);
+}
+
+struct wave_reader *
+wave_reader_open_file(FILE *fp, wave_reader_error *error)
 {
     int root_id, root_len, format_id;
     int continue_reading = 1;
     struct wave_reader *wr = NULL;
 
-    assert(filename != NULL);
+    assert(fp != NULL);
     assert(error != NULL);
 
     wr = (struct wave_reader *)calloc(1, sizeof(struct wave_reader));
@@ -176,14 +237,9 @@ wave_reader_open(const char *filename, wave_reader_error *error)
         *error = WR_ALLOC_ERROR;
         goto alloc_error;
     }
+    wr->fp = fp;
 
-    wr->fp = fopen(filename, "rb");
-    if (!wr->fp) {
-        *error = WR_OPEN_ERROR;
-        goto open_error;
-    }
-
-    if (!read_int32_b(wr->fp, &root_id)) {
+    if (read_int32_b(wr->fp, &root_id) != 1) {
         *error = WR_IO_ERROR;
         goto reading_error;
     }
@@ -193,13 +249,13 @@ wave_reader_open(const char *filename, wave_reader_error *error)
         goto reading_error;
     }
 
-    if (!read_int32_l(wr->fp, &root_len)) {
+    if (read_int32_l(wr->fp, &root_len) != 1) {
         *error = WR_IO_ERROR;
         goto reading_error;
     }
 
     while (continue_reading) {
-        if (!read_int32_b(wr->fp, &format_id)) {
+        if (read_int32_b(wr->fp, &format_id) != 1) {
             *error = WR_IO_ERROR;
             goto reading_error;
         }
@@ -221,10 +277,9 @@ wave_reader_open(const char *filename, wave_reader_error *error)
     return wr;
 
 reading_error:
-    fclose(wr->fp);
-open_error:
     free(wr);
 alloc_error:
+    fclose(fp);
 
     return NULL;
 }
@@ -286,6 +341,10 @@ wave_reader_get_samples(struct wave_reader *wr, int n, void *buf)
     assert(wr != NULL);
     assert(buf != NULL);
 
+    if (n < 0) {
+        return -1;
+    }
+
     ret = (int) fread(buf, wr->num_channels * wr->sample_bits / 8, n, wr->fp);
     if (ret < n && ferror(wr->fp)) {
         return -1;
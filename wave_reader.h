@@ -1,6 +1,8 @@
 #ifndef WAVE_READER_H
 #define WAVE_READER_H
 
+#include <stdio.h>
+
 typedef enum {
     WR_NO_ERROR = 0,
     WR_OPEN_ERROR,
@@ -12,6 +14,8 @@ typedef enum {
 typedef struct wave_reader wave_reader;
 
 wave_reader *wave_reader_open(const char *filename, wave_reader_error *error);
+/* Reads from an open file (or fmemopen() buffer); the reader owns it, and closes it. */
+wave_reader *wave_reader_open_file(FILE *fp, wave_reader_error *error);
 void wave_reader_close(wave_reader *wr);
 int wave_reader_get_format(wave_reader *wr);
 int wave_reader_get_num_channels(wave_reader *wr);
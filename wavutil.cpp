@@ -1,8 +1,15 @@
 #include "wavutil.h"
 #include "./wav12/expander.h"
+#include "./wav12util/manifest.h"
+#include "codec.h"
 
 #include <assert.h>
 #include <string.h>
+#include <limits.h>
+#include <chrono>
+#include <filesystem>
+
+#define TEST(x) { if (!(x)) { assert(false); return false; }}
 
 MemStream::MemStream(const uint8_t *data, uint32_t size)
 {
@@ -13,8 +20,59 @@ MemStream::MemStream(const uint8_t *data, uint32_t size)
     m_pos = 0;
 }
 
+#if (W12_AVX2() || W12_SSSE3()) && defined(_MSC_VER)
+#   include <intrin.h>
+#endif
+
+bool CpuHasSSSE3()
+{
+#if W12_SSSE3() && defined(_MSC_VER)
+    static const bool has = [] {
+        int info[4] = { 0 };
+        __cpuid(info, 1);
+        return (info[2] & (1 << 9)) != 0;
+    }();
+    return has;
+#elif W12_SSSE3()
+    static const bool has = __builtin_cpu_supports("ssse3") != 0;
+    return has;
+#else
+    return false;
+#endif
+}
+
+bool CpuHasAVX2()
+{
+#if W12_AVX2() && defined(_MSC_VER)
+    static const bool has = [] {
+        int info[4] = { 0 };
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+        __cpuid(info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+        // The OS has to save the ymm registers.
+        if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+            return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    }();
+    return has;
+#elif W12_AVX2()
+    static const bool has = __builtin_cpu_supports("avx2") != 0;
+    return has;
+#else
+    return false;
+#endif
+}
+
 void MemStream::set(uint32_t addr, uint32_t size)
 {
+    // Never past the end of the data, whatever the image says.
+    const uint32_t total = uint32_t(m_data_end - m_data);
+    if (addr > total) addr = total;
+    if (size > total - addr) size = total - addr;
     m_addr = addr;
     m_size = size;
     m_pos = 0;
@@ -36,43 +94,346 @@ uint32_t MemStream::fetch(uint8_t *buffer, uint32_t nBytes)
     return nBytes;
 }
 
-char base64BitsToChar(int b)
+bool WavWriter::open(const char* name, int sampleRate)
+{
+    close();
+    m_fp = fopen(name, "wb");
+    if (!m_fp) {
+        printf("Failed to open: %s\n", name);
+        return false;
+    }
+    if (!m_buffer)
+        m_buffer.reset(new uint8_t[BUFFER_SIZE]);
+    m_pos = HEADER_SIZE;    // filled in by close()
+    m_flushed = false;
+    m_error = false;
+    m_nSamples = 0;
+    m_sampleRate = sampleRate;
+    return true;
+}
+
+
+int16_t* WavWriter::reserve(int* nSamples)
+{
+    if (m_pos == BUFFER_SIZE)
+        flush();
+    int room = (BUFFER_SIZE - m_pos) / 2;
+    if (*nSamples > room)
+        *nSamples = room;
+    int16_t* target = (int16_t*)(m_buffer.get() + m_pos);
+    m_pos += *nSamples * 2;
+    m_nSamples += *nSamples;
+    return target;
+}
+
+
+void WavWriter::flush()
+{
+    if (m_pos && fwrite(m_buffer.get(), m_pos, 1, m_fp) != 1)
+        m_error = true;
+    m_pos = 0;
+    m_flushed = true;
+}
+
+
+void WavWriter::put(const int16_t* mono, int nSamples)
+{
+    while (nSamples > 0) {
+        int n = nSamples;
+        int16_t* target = reserve(&n);
+        memcpy(target, mono, n * 2);
+        mono += n;
+        nSamples -= n;
+    }
+}
+
+
+void WavWriter::putStereo32(const int32_t* stereo, int nSamples)
+{
+    while (nSamples > 0) {
+        int n = nSamples;
+        int16_t* target = reserve(&n);
+        NarrowStereo32(stereo, n, target);
+        stereo += n * 2;
+        nSamples -= n;
+    }
+}
+
+
+void WavWriter::putExpanded(wav12::Expander& expander, int nSamples)
+{
+    static const int CHUNK = 4096;
+    int32_t stereo[CHUNK * 2];
+
+    while (nSamples > 0) {
+        int n = nSamples < CHUNK ? nSamples : CHUNK;
+        n = expander.expand(stereo, n, 256, false, true);
+        if (n == 0)
+            break;
+        putStereo32(stereo, n);
+        nSamples -= n;
+    }
+}
+
+
+void WavWriter::putS4(const uint8_t* compressed, int nBytes, int table, int predictor, int bits)
 {
-    if (b >= 0 && b < 26)
-        return 'A' + b;
-    if (b >= 26 && b < 52)
-        return 'a' + (b - 26);
-    if (b >= 52 && b < 62)
-        return '0' + (b - 52);
-    if (b == 62)
-        return '+';
-    if (b == 63)
-        return '-';
-    return 0;
+    MemStream memStream(compressed, nBytes);
+    memStream.set(0, nBytes);
+    wav12::ExpanderAD4 expander;
+    expander.init(&memStream, S4ADPCM::getTable(table, bits), predictor, bits);
+    putExpanded(expander, int(int64_t(nBytes) * 8 / bits));
 }
 
-int base64CharToBits(char c)
+
+void WavWriter::putIMA(const uint8_t* compressed, int nBytes)
 {
-    if (c >= 'A' && c <= 'Z')
-        return c - 'A';
-    if (c >= 'a' && c <= 'z')
-        return c - 'a' + 26;
-    if (c >= '0' && c <= '9')
-        return c - '0' + 52;
-    if (c == '+')
-        return 62;
-    if (c == '-')
-        return 63;
-    return 0;
+    MemStream memStream(compressed, nBytes);
+    memStream.set(0, nBytes);
+    wav12::ExpanderIMA expander;
+    expander.init(&memStream);
+    putExpanded(expander, wav12::Expander::bytesToSamples(nBytes));
 }
 
+
+void WavWriter::put(const EncodedStream& es)
+{
+    if (es.codec == MemUnit::CODEC_IMA)
+        putIMA(es.compressed.get(), es.nCompressed);
+    else
+        putS4(es.compressed.get(), es.nCompressed, es.table, es.predictor, MemUnit::CodecBits(es.codec));
+}
+
+
+void WavWriter::writeHeader(uint8_t* t) const
+{
+    const uint32_t dataSize = m_nSamples * 2;
+    const uint32_t riffSize = dataSize + HEADER_SIZE - 8;
+    const uint32_t fmtSize = 16;
+    const uint16_t format = 1;      // PCM
+    const uint16_t nChannels = 1;
+    const uint32_t sampleRate = m_sampleRate;
+    const uint32_t byteRate = m_sampleRate * 2;
+    const uint16_t blockAlign = 2;
+    const uint16_t bits = 16;
+
+    memcpy(t + 0, "RIFF", 4);
+    memcpy(t + 4, &riffSize, 4);
+    memcpy(t + 8, "WAVE", 4);
+    memcpy(t + 12, "fmt ", 4);
+    memcpy(t + 16, &fmtSize, 4);
+    memcpy(t + 20, &format, 2);
+    memcpy(t + 22, &nChannels, 2);
+    memcpy(t + 24, &sampleRate, 4);
+    memcpy(t + 28, &byteRate, 4);
+    memcpy(t + 32, &blockAlign, 2);
+    memcpy(t + 34, &bits, 2);
+    memcpy(t + 36, "data", 4);
+    memcpy(t + 40, &dataSize, 4);
+}
+
+
+bool WavWriter::close()
+{
+    if (!m_fp)
+        return true;
+
+    if (!m_flushed) {
+        // Everything is still in the buffer: header and all in one write.
+        writeHeader(m_buffer.get());
+        flush();
+    }
+    else {
+        flush();
+        uint8_t header[HEADER_SIZE];
+        writeHeader(header);
+        if (fseek(m_fp, 0, SEEK_SET) != 0 || fwrite(header, HEADER_SIZE, 1, m_fp) != 1)
+            m_error = true;
+    }
+    if (fclose(m_fp) != 0)
+        m_error = true;
+    m_fp = 0;
+    return !m_error;
+}
+
+
+void WavWriter::NarrowStereo32(const int32_t* stereo, int nSamples, int16_t* out)
+{
+    int i = 0;
+#if W12_SSE2()
+    // Division by 65536 rounds towards zero: add 65535 to negative values before the shift.
+    const __m128i bias = _mm_set1_epi32(0xffff);
+    for (; i + 8 <= nSamples; i += 8) {
+        __m128i v[4];
+        for (int k = 0; k < 4; ++k) {
+            __m128i x = _mm_loadu_si128((const __m128i*)(stereo + i * 2 + k * 4));
+            x = _mm_add_epi32(x, _mm_and_si128(_mm_srai_epi32(x, 31), bias));
+            x = _mm_srai_epi32(x, 16);
+            // Left channel (lanes 0 and 2) to the low half.
+            v[k] = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 1, 2, 0));
+        }
+        __m128i lo = _mm_unpacklo_epi64(v[0], v[1]);
+        __m128i hi = _mm_unpacklo_epi64(v[2], v[3]);
+        // The values are in range, so saturation doesn't change anything.
+        _mm_storeu_si128((__m128i*)(out + i), _mm_packs_epi32(lo, hi));
+    }
+#endif
+    for (; i < nSamples; ++i)
+        out[i] = int16_t(stereo[i * 2] / 65536);
+}
+
+
+TempDir::TempDir()
+{
+    std::error_code ec;
+    std::filesystem::path base = std::filesystem::temp_directory_path(ec);
+    if (ec)
+        return;
+    // Unique to this run, so runs side by side don't share files.
+    uint64_t stamp = uint64_t(std::chrono::steady_clock::now().time_since_epoch().count());
+    for (int i = 0; i < 100; ++i) {
+        std::filesystem::path p = base / ("wav12ly-" + std::to_string(stamp + i));
+        if (std::filesystem::create_directory(p, ec)) {
+            m_dir = p.string();
+            m_dir += char(std::filesystem::path::preferred_separator);
+            return;
+        }
+    }
+}
+
+TempDir::~TempDir()
+{
+    if (!m_dir.empty()) {
+        std::error_code ec;
+        std::filesystem::remove_all(m_dir, ec);
+    }
+}
+
+
+bool WavWriter::Test()
+{
+    static const int N = 37;
+    int32_t stereo[N * 2];
+    int16_t out[N];
+    uint32_t r = 1;
+    for (int i = 0; i < N; ++i) {
+        r = r * 1103515245 + 12345;
+        int32_t v = int32_t(r);
+        if (i == 3) v = -65535;     // rounds to 0
+        if (i == 4) v = -65536;
+        if (i == 5) v = -65537;
+        if (i == 6) v = SHRT_MIN * 65536;
+        if (i == 7) v = SHRT_MAX * 65536 + 65535;
+        stereo[i * 2] = v;
+        stereo[i * 2 + 1] = v == INT32_MIN ? INT32_MAX : -v;  // -INT32_MIN overflows
+    }
+    WavWriter::NarrowStereo32(stereo, N, out);
+    for (int i = 0; i < N; ++i)
+        TEST(out[i] == int16_t(stereo[i * 2] / 65536));
+    TEST(out[3] == 0 && out[4] == -1 && out[5] == -1);
+    TEST(out[6] == SHRT_MIN && out[7] == SHRT_MAX);
+    return true;
+}
+
+
+// Alphabet is standard base64, except '-' instead of '/'.
+// Bits are packed little endian: the first char is the low 6 bits of the first byte.
+static const char BASE64_CHARS[65] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+-";
+
+struct Base64DecodeTable {
+    uint8_t bits[256];
+    Base64DecodeTable() {
+        // Unknown characters decode as 0, same as always.
+        memset(bits, 0, sizeof(bits));
+        for (int i = 0; i < 64; ++i)
+            bits[(uint8_t)BASE64_CHARS[i]] = uint8_t(i);
+    }
+};
+static const Base64DecodeTable BASE64_DECODE;
+
+#if W12_SSSE3()
+// 12 bytes in, 16 chars out.
+W12_TARGET_SSSE3 static inline __m128i encodeBase64x16(__m128i in)
+{
+    // Spread each 3 bytes over a 32 bit lane, then move each 6 bits to its own byte.
+    const __m128i v = _mm_shuffle_epi8(in, _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1));
+    __m128i bits = _mm_and_si128(v, _mm_set1_epi32(0x3f));
+    bits = _mm_or_si128(bits, _mm_and_si128(_mm_slli_epi32(v, 2), _mm_set1_epi32(0x3f00)));
+    bits = _mm_or_si128(bits, _mm_and_si128(_mm_slli_epi32(v, 4), _mm_set1_epi32(0x3f0000)));
+    bits = _mm_or_si128(bits, _mm_and_si128(_mm_slli_epi32(v, 6), _mm_set1_epi32(0x3f000000)));
+
+    // Map 0-63 to the alphabet by adding an offset per range:
+    //   0-25 -> 13, 26-51 -> 0, 52-61 -> 1-10, 62 -> 11, 63 -> 12
+    const __m128i OFFSET = _mm_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '-' - 63, 'A', 0, 0);
+    __m128i index = _mm_subs_epu8(bits, _mm_set1_epi8(51));
+    const __m128i less26 = _mm_cmpgt_epi8(_mm_set1_epi8(26), bits);
+    index = _mm_or_si128(index, _mm_and_si128(less26, _mm_set1_epi8(13)));
+    return _mm_add_epi8(bits, _mm_shuffle_epi8(OFFSET, index));
+}
+
+W12_TARGET_SSSE3 static inline __m128i inRange(__m128i c, char lo, char hi)
+{
+    return _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8(lo - 1)), _mm_cmpgt_epi8(_mm_set1_epi8(hi + 1), c));
+}
+
+// 16 chars in, 12 bytes out (in the low bytes.)
+W12_TARGET_SSSE3 static inline __m128i decodeBase64x16(__m128i c)
+{
+    __m128i bits = _mm_and_si128(inRange(c, 'A', 'Z'), _mm_sub_epi8(c, _mm_set1_epi8('A')));
+    bits = _mm_or_si128(bits, _mm_and_si128(inRange(c, 'a', 'z'), _mm_sub_epi8(c, _mm_set1_epi8('a' - 26))));
+    bits = _mm_or_si128(bits, _mm_and_si128(inRange(c, '0', '9'), _mm_add_epi8(c, _mm_set1_epi8(52 - '0'))));
+    bits = _mm_or_si128(bits, _mm_and_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('+')), _mm_set1_epi8(62)));
+    bits = _mm_or_si128(bits, _mm_and_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('-')), _mm_set1_epi8(63)));
+
+    // c0 + c1 * 64, c2 + c3 * 64 in 16 bits, then the pairs in to 24 bits.
+    const __m128i pairs = _mm_maddubs_epi16(bits, _mm_set1_epi16(0x4001));
+    const __m128i v = _mm_madd_epi16(pairs, _mm_set1_epi32(0x10000001));
+    return _mm_shuffle_epi8(v, _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1));
+}
+
+// The blocks of 12 bytes it can; returns the bytes done. Reads 16 bytes to use 12.
+W12_TARGET_SSSE3 static int encodeBase64SSSE3(const uint8_t* src, int nBytes, char* t)
+{
+    int i = 0;
+    for (; i + 16 <= nBytes; i += 12) {
+        __m128i in = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)t, encodeBase64x16(in));
+        t += 16;
+    }
+    return i;
+}
+
+// The blocks of 12 bytes it can; returns the bytes done.
+W12_TARGET_SSSE3 static int decodeBase64SSSE3(const uint8_t* p, int nBytes, uint8_t* dst)
+{
+    int i = 0;
+    for (; i + 12 <= nBytes; i += 12) {
+        __m128i out = decodeBase64x16(_mm_loadu_si128((const __m128i*)p));
+        _mm_storel_epi64((__m128i*)(dst + i), out);
+        uint32_t last = uint32_t(_mm_cvtsi128_si32(_mm_srli_si128(out, 8)));
+        memcpy(dst + i + 8, &last, 4);
+        p += 16;
+    }
+    return i;
+}
+#endif
+
 void encodeBase64(const uint8_t* src, int nBytes, char* dst, bool writeNull)
 {
     // base64 - 6 bits per char of output
     // every 3 bytes (24 bits) is 4 char
 
     char* t = dst;
-    for (int i = 0; i < nBytes; i += 3) {
+    int i = 0;
+#if W12_SSSE3()
+    if (CpuHasSSSE3()) {
+        i = encodeBase64SSSE3(src, nBytes, t);
+        t += i / 3 * 4;
+    }
+#endif
+    for (; i < nBytes; i += 3) {
         uint32_t accum = 0;
         accum = src[i];
         if (i + 1 < nBytes)
@@ -80,10 +441,10 @@ void encodeBase64(const uint8_t* src, int nBytes, char* dst, bool writeNull)
         if (i + 2 < nBytes)
             accum |= src[i + 2] << 16;
 
-        *t++ = base64BitsToChar(accum & 63);
-        *t++ = base64BitsToChar((accum >> 6) & 63);
-        *t++ = base64BitsToChar((accum >> 12) & 63);
-        *t++ = base64BitsToChar((accum >> 18) & 63);
+        *t++ = BASE64_CHARS[accum & 63];
+        *t++ = BASE64_CHARS[(accum >> 6) & 63];
+        *t++ = BASE64_CHARS[(accum >> 12) & 63];
+        *t++ = BASE64_CHARS[(accum >> 18) & 63];
     }
     if (writeNull)
         *t = 0;
@@ -91,13 +452,21 @@ void encodeBase64(const uint8_t* src, int nBytes, char* dst, bool writeNull)
 
 void decodeBase64(const char* src, int nBytes, uint8_t* dst)
 {
-    const char* p = src;
-    for (int i = 0; i < nBytes; i += 3) {
+    const uint8_t* p = (const uint8_t*)src;
+    const uint8_t* bits = BASE64_DECODE.bits;
+    int i = 0;
+#if W12_SSSE3()
+    if (CpuHasSSSE3()) {
+        i = decodeBase64SSSE3(p, nBytes, dst);
+        p += i / 3 * 4;
+    }
+#endif
+    for (; i < nBytes; i += 3) {
         uint32_t accum = 0;
-        accum = base64CharToBits(*p++);
-        accum |= base64CharToBits(*p++) << 6;
-        accum |= base64CharToBits(*p++) << 12;
-        accum |= base64CharToBits(*p++) << 18;
+        accum = bits[*p++];
+        accum |= bits[*p++] << 6;
+        accum |= bits[*p++] << 12;
+        accum |= bits[*p++] << 18;
 
         dst[i] = accum & 0xff;
         if (i + 1 < nBytes) dst[i + 1] = (accum >> 8) & 0xff;
@@ -105,6 +474,187 @@ void decodeBase64(const char* src, int nBytes, uint8_t* dst)
     }
 }
 
+bool testExpanders()
+{
+    static const int N = 1000;
+    int16_t samples[N];
+    wav12::ExpanderAD4::generateTestData(N, samples);
+    for (int i = 0; i < N; ++i)
+        samples[i] = int16_t(samples[i] * (i % 300) / 300);     // some transients
+
+    // IMA: the device decoder matches the reference one, in any size of
+    // piece, and the fused error matches the decode.
+    uint8_t ima[N / 2];
+    int16_t ref[N];
+    CodecState state = { 0, 0 };
+    encodeADPCM(&state, samples, N, ima);
+    state.init();
+    decodeADPCM(&state, ima, N, ref);
+
+    int64_t error2 = 0;
+    for (int i = 0; i < N; ++i)
+        error2 += int64_t(samples[i] - ref[i]) * int64_t(samples[i] - ref[i]);
+    state.init();
+    TEST(errorADPCM(&state, samples, N) == error2);
+
+    MemStream imaStream(ima, N / 2);
+    imaStream.set(0, N / 2);
+    wav12::ExpanderIMA expIMA;
+    expIMA.init(&imaStream);
+    int32_t stereo[N * 2];
+    for (int pos = 0, piece = 2; pos < N; pos += piece, piece += 2) {
+        piece = std::min(piece, N - pos);
+        TEST(expIMA.expand(stereo + pos * 2, piece, 256, false, true) == piece);
+    }
+    for (int i = 0; i < N; ++i)
+        TEST(stereo[i * 2] / 65536 == ref[i] && stereo[i * 2 + 1] == stereo[i * 2]);
+
+    // Mixed codecs through one fillBuffer().
+    uint8_t s4[N / 2];
+    S4ADPCM::State s4State(S4ADPCM::getTable(0), S4ADPCM::State::PREDICTOR);
+    S4ADPCM::encode4(samples, N, s4, &s4State);
+    MemStream s4Stream(s4, N / 2);
+    s4Stream.set(0, N / 2);
+    wav12::ExpanderAD4 expAD4;
+    expAD4.init(&s4Stream, S4ADPCM::getTable(0), S4ADPCM::State::PREDICTOR);
+
+    int32_t mixed[N * 2], s4Only[N * 2];
+    const bool loop[2] = { false, false };
+    const int volume[2] = { 128, 128 };
+    wav12::ExpanderAD4::fillBuffer(s4Only, N, &expAD4, 1, loop, volume, true);
+    expAD4.rewind();
+    expIMA.rewind();
+    wav12::Expander* both[2] = { &expAD4, &expIMA };
+    wav12::Expander::fillBuffer(mixed, N, both, 2, loop, volume, true);
+    for (int i = 0; i < N; ++i)
+        TEST(mixed[i * 2] == s4Only[i * 2] + ref[i] * 128 * 256);
+
+    // 3 and 2 bits: the expander, in pieces that split bytes, matches one decodeN().
+    for (int bits = 2; bits <= 3; ++bits) {
+        for (int t = 0; t < S4ADPCM::numTables(bits); ++t) {
+            uint8_t packed[N * 3 / 8];
+            const int nBytes = N * bits / 8;
+            S4ADPCM::State encState(S4ADPCM::getTable(t, bits), S4ADPCM::State::PREDICTOR);
+            TEST(S4ADPCM::encodeN(bits, samples, N, packed, &encState) == nBytes);
+            TEST(S4ADPCM::flushN(packed + nBytes, &encState) == 0);
+
+            // Encoded in pieces that split bytes, and flushed, it's the same.
+            uint8_t pieces[N * 3 / 8 + 1];
+            S4ADPCM::State pieceState(S4ADPCM::getTable(t, bits), S4ADPCM::State::PREDICTOR);
+            int nPieces = 0;
+            for (int pos = 0, piece = 1; pos < N; pos += piece, piece += 5) {
+                piece = std::min(piece, N - pos);
+                nPieces += S4ADPCM::encodeN(bits, samples + pos, piece, pieces + nPieces, &pieceState);
+            }
+            nPieces += S4ADPCM::flushN(pieces + nPieces, &pieceState);
+            TEST(nPieces == nBytes && memcmp(pieces, packed, nBytes) == 0);
+
+            int32_t once[N * 2];
+            S4ADPCM::State decState(S4ADPCM::getTable(t, bits), S4ADPCM::State::PREDICTOR);
+            decState.volumeShifted = 256 << 8;
+            S4ADPCM::decodeN(bits, packed, N, 256, false, once, &decState);
+
+            MemStream stream(packed, nBytes);
+            stream.set(0, nBytes);
+            wav12::ExpanderAD4 exp;
+            exp.init(&stream, S4ADPCM::getTable(t, bits), S4ADPCM::State::PREDICTOR, bits);
+            for (int pos = 0, piece = 2; pos < N; pos += piece, piece += 6) {
+                piece = std::min(piece, N - pos);
+                TEST(exp.expand(stereo + pos * 2, piece, 256, false, true) == piece);
+            }
+            TEST(exp.done());
+            for (int i = 0; i < N; ++i)
+                TEST(stereo[i * 2] == once[i * 2]);
+        }
+    }
+    return true;
+}
+
+bool testNoiseShape()
+{
+    static const int N = 4000;
+    int16_t samples[N];
+    wav12::ExpanderAD4::generateTestData(N, samples);
+    uint32_t r = 3;
+    for (int i = 0; i < N; ++i) {
+        r = r * 1103515245 + 12345;
+        samples[i] = int16_t(samples[i] / 2 + int32_t(r >> 20) - 2048);    // some broadband content
+    }
+
+    // The shaped streams decode with the plain decoder, and the share of
+    // high frequency noise (as the pre-emphasis metric sees it) goes up
+    // with the shape.
+    int32_t prevRatio = -1;
+    for (int shape = -S4ADPCM::MAX_NOISE_SHAPE; shape <= S4ADPCM::MAX_NOISE_SHAPE; ++shape) {
+        uint8_t compressed[N / 2];
+        S4ADPCM::State encState(S4ADPCM::getTable(0), S4ADPCM::State::PREDICTOR);
+        TEST(S4ADPCM::encode4(samples, N, compressed, &encState, shape) == N / 2);
+        if (shape == 0) {
+            uint8_t plain[N / 2];
+            S4ADPCM::State plainState(S4ADPCM::getTable(0), S4ADPCM::State::PREDICTOR);
+            S4ADPCM::encode4(samples, N, plain, &plainState);
+            TEST(memcmp(plain, compressed, N / 2) == 0);
+        }
+
+        int32_t stereo[N * 2];
+        int16_t decoded[N];
+        S4ADPCM::State decState(S4ADPCM::getTable(0), S4ADPCM::State::PREDICTOR);
+        decState.volumeShifted = 256 << 8;
+        S4ADPCM::decode4(compressed, N, 256, false, stereo, &decState);
+        WavWriter::NarrowStereo32(stereo, N, decoded);
+
+        ErrorAccum mse(ErrorMetric::MSE), emphasis(ErrorMetric::EMPHASIS);
+        mse.add(samples, decoded, N);
+        emphasis.add(samples, decoded, N);
+        TEST(mse.result() > 0);
+        int32_t ratio = int32_t(int64_t(emphasis.result()) * 1000 / mse.result());
+        TEST(ratio > prevRatio);
+        prevRatio = ratio;
+    }
+    return true;
+}
+
+bool testBase64()
+{
+    {
+        const uint8_t in[3] = { 0x01, 0x00, 0xff };
+        char out[5];
+        encodeBase64(in, 3, out, true);
+        TEST(strcmp(out, "BAw-") == 0);
+    }
+    // All the lengths around the SIMD block size, and every byte value.
+    uint8_t bytes[300];
+    char chars[401];
+    uint8_t back[300];
+    for (int i = 0; i < 300; ++i)
+        bytes[i] = uint8_t(i * 37 + (i >> 3));
+    for (int n = 0; n < 300; ++n) {
+        encodeBase64(bytes, n, chars, true);
+        TEST(strlen(chars) == size_t((n + 2) / 3 * 4));
+        // The same chars as 6 bits at a time, whichever path ran.
+        for (int i = 0; i < (n + 2) / 3 * 4; ++i) {
+            uint32_t accum = 0;
+            for (int k = 0; k < 3; ++k) {
+                int b = i / 4 * 3 + k;
+                if (b < n)
+                    accum |= bytes[b] << (k * 8);
+            }
+            TEST(chars[i] == BASE64_CHARS[(accum >> (i % 4 * 6)) & 63]);
+        }
+        memset(back, 0xcd, sizeof(back));
+        decodeBase64(chars, n, back);
+        TEST(memcmp(bytes, back, n) == 0);
+        if (n < 300)
+            TEST(back[n] == 0xcd);
+    }
+    TEST(crc32((const uint8_t*)"123456789", 9) == 0xcbf43926);
+
+    // Unknown characters are zero.
+    decodeBase64("*A*A*A*A*A*A*A*A*A*A*A*A", 18, back);
+    for (int i = 0; i < 18; ++i)
+        TEST(back[i] == 0);
+    return true;
+}
 
 uint32_t hash32(const char* v, const char* end, uint32_t h)
 {
@@ -113,3 +663,25 @@ uint32_t hash32(const char* v, const char* end, uint32_t h)
     }
     return h;
 }
+
+
+uint32_t crc32(const uint8_t* data, size_t n, uint32_t crc)
+{
+    struct Table {
+        uint32_t t[256];
+        Table() {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k)
+                    c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+                t[i] = c;
+            }
+        }
+    };
+    static const Table table;
+
+    crc = ~crc;
+    for (size_t i = 0; i < n; ++i)
+        crc = table.t[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
@@ -1,9 +1,12 @@
 #pragma once
 
 #include <memory>
+#include <string>
 #include <stdint.h>
+#include <stdio.h>
 #include "./wav12/interface.h"
 #include "./wav12/expander.h"
+#include "errormetric.h"
 
 struct EncodedStream {
     int nSamples = 0;
@@ -12,12 +15,28 @@ struct EncodedStream {
     int predictor = 0;
     int32_t aveError2 = 0;
     std::unique_ptr<uint8_t[]> compressed;
-    std::unique_ptr<int32_t[]> stereo;
+    int codec = 0;              // MemUnit::CODEC_*
 };
 
-EncodedStream compressS4(const int16_t* samples, int nSamples, int table, int predictor);
+// 'bits' is 4, or 3 or 2 for the smaller modes (samples are padded to fit them.)
+// noiseShape only applies to 4 bits; see S4ADPCM::encode4().
+EncodedStream compressS4(const int16_t* samples, int nSamples, int table, int predictor, int bits = 4, int noiseShape = 0);
+// The error of compressS4() by 'metric', using scratch memory for the encoding.
+int32_t errorS4(const int16_t* samples, int nSamples, int table, int predictor, int bits = 4, ErrorMetric metric = ErrorMetric::MSE, int noiseShape = 0);
 
-EncodedStream compressGroup(const int16_t* samples, int nSamples);
+// How compressGroup() chooses the encoding of a file.
+struct CompressOptions {
+    bool tryADPCM = true;       // IMA ADPCM is a candidate codec
+    int maxError = 0;           // if > 0, use 3 or 2 bits when they stay under this RMS error
+    ErrorMetric metric = ErrorMetric::MSE;  // how the candidates are compared
+    int noiseShape = 0;         // S4 error feedback, -3 to 3; see S4ADPCM::encode4()
+};
+
+// Picks the codec, table, and predictor with the lowest error by the
+// options' metric. The returned aveError2 is always MSE. It waits only on
+// its own tasks, so files can be compressed side by side; the report goes
+// to 'log' if there is one, so their output isn't mixed.
+EncodedStream compressGroup(const int16_t* samples, int nSamples, const CompressOptions& options = CompressOptions(), std::string* log = 0);
 
 class MemStream : public IStream
 {
@@ -37,9 +56,139 @@ protected:
     uint32_t m_pos = 0;
 };
 
+// SSSE3 paths for the base64 codec. Like the AVX2 kernels (below), they are
+// compiled on any x86 and picked at run time, by CpuHasSSSE3().
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#   include <tmmintrin.h>
+#   define W12_SSSE3() 1
+#else
+#   define W12_SSSE3() 0
+#endif
+
+#if W12_SSSE3() && defined(__GNUC__) && !defined(__SSSE3__)
+#   define W12_TARGET_SSSE3 __attribute__((target("ssse3")))
+#else
+#   define W12_TARGET_SSSE3
+#endif
+
+// True if the CPU runs SSSE3 code.
+bool CpuHasSSSE3();
+
+// SSE2 is always there on x64; MSVC doesn't define __SSE2__ though.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   include <emmintrin.h>
+#   define W12_SSE2() 1
+#else
+#   define W12_SSE2() 0
+#endif
+
+// The AVX2 kernels are compiled on any x86, and picked at run time by
+// CpuHasAVX2(), so the tool doesn't need /arch:AVX2 or -mavx2 to use them.
+// gcc and clang want the target on each function that uses the
+// intrinsics; MSVC compiles them as is.
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#   include <immintrin.h>
+#   define W12_AVX2() 1
+#else
+#   define W12_AVX2() 0
+#endif
+
+#if W12_AVX2() && defined(__GNUC__) && !defined(__AVX2__)
+#   define W12_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#   define W12_TARGET_AVX2
+#endif
+
+// True if the CPU (and OS) run AVX2 code.
+bool CpuHasAVX2();
+
+/*
+    Writes a 16 bit mono WAV file through a large buffer: one fwrite per
+    BUFFER_SIZE bytes, and a small file (header included) is a single
+    write. Takes 16 bit mono, the 16.16 stereo the expander writes, or S4
+    data to decode.
+*/
+class WavWriter
+{
+public:
+    static const int BUFFER_SIZE = 256 * 1024;
+    static const int HEADER_SIZE = 44;
+
+    WavWriter() {}
+    ~WavWriter() { close(); }
+
+    bool open(const char* name, int sampleRate = 22050);
+    void put(const int16_t* mono, int nSamples);
+    // The left channel of stereo[], each sample / 65536.
+    void putStereo32(const int32_t* stereo, int nSamples);
+    // Decodes (with ExpanderAD4 or ExpanderIMA, at neutral volume) and writes.
+    void putS4(const uint8_t* compressed, int nBytes, int table, int predictor, int bits = 4);
+    void putIMA(const uint8_t* compressed, int nBytes);
+    void put(const EncodedStream& es);
+    // Writes the header and anything buffered. Returns false if any write failed.
+    bool close();
+
+    // out[i] = int16_t(stereo[i*2] / 65536)
+    static void NarrowStereo32(const int32_t* stereo, int nSamples, int16_t* out);
+    static bool Test();
+
+private:
+    WavWriter(const WavWriter&) = delete;
+    void operator=(const WavWriter&) = delete;
+
+    int16_t* reserve(int* nSamples);
+    void putExpanded(wav12::Expander& expander, int nSamples);
+    void flush();
+    void writeHeader(uint8_t* target) const;
+
+    FILE* m_fp = 0;
+    std::unique_ptr<uint8_t[]> m_buffer;
+    int m_pos = 0;              // bytes used in m_buffer
+    bool m_flushed = false;     // has anything been written to the file
+    bool m_error = false;
+    uint32_t m_nSamples = 0;
+    int m_sampleRate = 22050;
+};
+
+/*
+    A new directory under the system temp directory, removed with
+    everything in it when this goes out of scope. For the tests that need
+    files: nothing is written to the working directory, and a TEST() that
+    returns early still cleans up.
+*/
+class TempDir
+{
+public:
+    TempDir();
+    ~TempDir();
+
+    // False if the directory couldn't be made.
+    bool ok() const { return !m_dir.empty(); }
+    // The directory, ending in a separator.
+    const std::string& dir() const { return m_dir; }
+    // 'name' in the directory.
+    std::string path(const char* name) const { return m_dir + name; }
+
+private:
+    TempDir(const TempDir&) = delete;
+    void operator=(const TempDir&) = delete;
+
+    std::string m_dir;
+};
+
+// 4 chars for every 3 bytes (rounded up).
+inline int base64Size(int nBytes) { return (nBytes + 2) / 3 * 4; }
+// 'target' needs room for base64Size(nBytes), plus the null.
 void encodeBase64(const uint8_t* bytes, int nBytes, char* target, bool writeNull);
+// Reads exactly base64Size(nBytes) chars; the caller checks 'src' has that many.
 void decodeBase64(const char* src, int nBytes, uint8_t* dst);
+bool testBase64();
+// IMA decode matches the reference decoder; S4 and IMA mix through Expander::fillBuffer().
+bool testExpanders();
+bool testNoiseShape();
 uint32_t hash32(const char* v, const char* end, uint32_t h = 0);
+// Standard (zlib / PNG) CRC-32. Pass the previous result to continue a CRC.
+uint32_t crc32(const uint8_t* data, size_t n, uint32_t crc = 0);
 
 
 